@@ -5,7 +5,20 @@
 #include <driver/adc.h>
 #include <esp_adc_cal.h>
 
-void setupBattery();
-double getBatteryVoltage();
+// Battery service. An esp_timer samples the ADC in the background, filters
+// the readings (median of a burst, then EMA), maps voltage through a LiPo
+// discharge curve and estimates the time left from the discharge slope.
+// Readers never touch the ADC and never block.
+
+struct BatteryReading {
+  float volts;     // Filtered cell voltage
+  int percent;     // 0 - 100 from the discharge curve
+  int minutesLeft; // -1 while charging or not enough history yet
+  bool valid;      // false until the first sample
+};
+
+void setupBattery(); // Configure the ADC and start background sampling
+BatteryReading getBatteryReading();
+double getBatteryVoltage(); // Filtered voltage (no ADC access)
 
 #endif
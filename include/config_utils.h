@@ -5,6 +5,18 @@
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 
+// Settings live in the globals below and are stored as a versioned binary
+// record with a CRC in two alternating slots on LittleFS; a torn write only
+// ever loses the newest copy. saveConfig() just snapshots the globals and
+// the loop task writes them a moment later, so bursts of changes (e.g.
+// brightness steps) become one write, and unchanged settings none.
+// A /config.json from older firmware is imported once on first boot.
+//
+// The globals are only changed on the loop task, under the settings lock.
+// The loop reads them freely; any other task (the transmission task, web
+// handlers, workers) copies what it needs under the lock, e.g. with
+// getDaemonConfig(), since a String can be reallocated by a change.
+
 // Global Configuration Variables
 extern String ssid;
 extern String password;
@@ -17,13 +29,63 @@ extern int transPort;
 extern String transPath;
 extern String transUser;
 extern String transPass;
+extern bool rpcProxy; // Serve /transmission/rpc to other clients
+
+// Static IP profile for the station (dotted quads; DNS defaults to the
+// gateway). Skips DHCP on every connect.
+extern bool staticIp;
+extern String staticAddr;
+extern String staticGateway;
+extern String staticMask;
+extern String staticDns;
 
 extern int brightness;
 
+// Power (seconds of idle time, 0 = never)
+extern int dimTimeout;
+extern int blankTimeout;
+extern bool powerSave; // Modem sleep, light sleep and slower polling
+
+// Longest values the record can hold (bytes). Longer ones are refused,
+// never cut, so what runs is what comes back after a restart.
+#define CONFIG_SSID_MAX 32 // The 802.11 limit
+#define CONFIG_PASSWORD_MAX 64
+#define CONFIG_HOST_MAX 63
+#define CONFIG_PATH_MAX 63
+#define CONFIG_USER_MAX 32
+#define CONFIG_IP_MAX 15 // Dotted quad
+
+// Daemon address and login, as one consistent copy
+struct DaemonConfig {
+  String host;
+  int port;
+  String path;
+  String user;
+  String pass;
+  String url() const; // http://host:port/path
+};
+
 // Functions
-void loadConfig();
-void saveConfig();
+void setupConfigLock(); // In setup(), before any task is started
+void lockConfig();
+void unlockConfig();
+DaemonConfig getDaemonConfig(); // Safe from any task
+void loadConfig();  // Call from setup() after setupScheduler()
+void saveConfig();  // Deferred; safe from any task
+void flushConfig(); // Write a pending save now (loop task, before restart)
 void deleteConfig();
 void factoryReset();
 
+// JSON form of the settings (same keys as the old /config.json), for
+// export and import from the web UI. Import only sets the keys present
+// (loop task); export is safe from any task.
+void exportConfigJson(JsonObject obj);
+void importConfigJson(JsonObject obj);
+
+// First key in obj whose string value does not fit the record, or nullptr
+const char *configJsonTooLong(JsonObject obj);
+
+// Store stats for /perf
+void fillConfigJson(JsonObject obj);
+
 #endif
@@ -0,0 +1,78 @@
+#ifndef CUSTOM_FILTERS_H
+#define CUSTOM_FILTERS_H
+
+#include "transmission_client.h"
+#include <Arduino.h>
+
+// User-defined torrent filters, e.g. "seeding AND ratio < 1 AND upload = 0".
+// Expressions are compiled once into a postfix program over TorrentInfo
+// fields and evaluated with a bit stack, so they cost about the same as the
+// built-in filter switch.
+
+#define MAX_CUSTOM_FILTERS 4
+#define MAX_FILTER_NAME 8   // Fits the filter bar and picker cells
+#define MAX_FILTER_EXPR 96  // Source length limit
+#define MAX_FILTER_INSTRS 24
+#define MAX_FILTER_STACK 32 // Bits in the evaluation stack
+
+enum FilterOp : uint8_t {
+  FOP_FLAGS, // Push (t.flags & mask) != 0
+  FOP_CMP,   // Push (field <cmp> value)
+  FOP_AND,
+  FOP_OR,
+  FOP_NOT
+};
+
+enum FilterField : uint8_t {
+  FFIELD_RATIO,
+  FFIELD_UPLOAD,   // bytes/sec
+  FFIELD_DOWNLOAD, // bytes/sec
+  FFIELD_PERCENT,  // 0 - 100
+  FFIELD_PRIORITY, // -1=Low, 0=Normal, 1=High
+  FFIELD_STATUS
+};
+
+enum FilterCmp : uint8_t { FCMP_LT, FCMP_LE, FCMP_GT, FCMP_GE, FCMP_EQ, FCMP_NE };
+
+struct FilterInstr {
+  FilterOp op;
+  uint8_t arg;   // FilterField for FOP_CMP
+  uint8_t cmp;   // FilterCmp for FOP_CMP
+  uint16_t mask; // TorrentFlag bits for FOP_FLAGS
+  float value;
+};
+
+struct FilterProgram {
+  FilterInstr code[MAX_FILTER_INSTRS];
+  uint8_t length;
+};
+
+struct CustomFilter {
+  char name[MAX_FILTER_NAME + 1];
+  String expr;
+  FilterProgram program;
+};
+
+// Compile an expression. On failure returns false and sets error.
+bool compileFilterExpr(const char *expr, FilterProgram &out, String &error);
+
+// Evaluate a compiled program against one torrent
+bool evalFilterProgram(const FilterProgram &prog, const TorrentInfo &t);
+
+// Storage (LittleFS /filters.json)
+void loadCustomFilters();
+void saveCustomFilters();
+
+// Replace all filters at once. Rows with an empty name or expression are
+// skipped. Nothing changes if any expression fails to compile.
+bool setCustomFilters(const String *names, const String *exprs, int count,
+                      String &error);
+
+// Compile only, without changing anything (validation from another task)
+bool checkCustomFilters(const String *names, const String *exprs, int count,
+                        String &error);
+
+int getCustomFilterCount();
+const CustomFilter *getCustomFilter(int i);
+
+#endif
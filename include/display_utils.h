@@ -1,6 +1,7 @@
 #ifndef DISPLAY_UTILS_H
 #define DISPLAY_UTILS_H
 
+#include "profiler.h"
 #include <Arduino.h>
 #include <TFT_eSPI.h>
 #include <WiFi.h>
@@ -27,15 +28,14 @@ enum State {
 };
 
 // --- External Globals ---
-extern TFT_eSPI tft;
+extern ProfiledTFT tft;
 extern State currentState;
-extern int otaProgress;
 
 // --- Display Functions ---
 void drawStatusBar();
 void drawWifiIcon(int x, int y, long rssi);
 void drawAPIcon(int x, int y);
-void drawBatteryIcon(int x, int y, float voltage);
+void drawBatteryIcon(int x, int y, int percent);
 void drawTransmissionStats(int x, int y, long dl, long ul);
 void drawTransmissionIcon(int x, int y, bool connected);
 void drawSmallTransmissionIcon(int x, int y, bool connected);
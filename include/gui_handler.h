@@ -21,7 +21,7 @@ void menuDown();
 void menuSelect();
 void menuBack();
 
-extern TFT_eSPI tft; // Reuse the tft object
+extern ProfiledTFT tft; // Reuse the tft object
 extern int menuIndex;
 extern const char *const BUILD_DATE;
 
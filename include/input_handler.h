@@ -13,9 +13,58 @@
 #define BTN_JOY_Y 35
 #define BTN_JOY_X 34
 
+// Input events. Buttons raise GPIO interrupts, the joystick axes and held
+// buttons are sampled by a 10 ms timer. Everything lands in one timestamped
+// queue, so presses are kept while the UI thread is busy.
+enum InputButton : uint8_t {
+  INPUT_MENU,
+  INPUT_VOLUME,
+  INPUT_SELECT,
+  INPUT_START,
+  INPUT_A,
+  INPUT_B,
+  INPUT_UP,
+  INPUT_DOWN,
+  INPUT_LEFT,
+  INPUT_RIGHT,
+  INPUT_BUTTON_COUNT
+};
+
+enum InputEventType : uint8_t {
+  INPUT_PRESS,   // Button went down (VOLUME: short press, sent on release)
+  INPUT_REPEAT,  // Held direction, accelerating auto-repeat
+  INPUT_LONG,    // Held past the long-press time (VOLUME only)
+  INPUT_RELEASE
+};
+
+struct InputEvent {
+  uint8_t button; // InputButton
+  uint8_t type;   // InputEventType
+  uint32_t timeMs;
+};
+
 void setupInputs();
+
+// Take the next batch of queued events and turn it into the one-shot flags
+// below. A batch stops before a second event for the same flag, which stays
+// queued for the next call, so no press is merged away.
 void readInputs();
 
+// Drop this pass's flags (e.g. a press that only woke the screen)
+void clearInputFlags();
+bool anyInputPressed();
+
+// Events left for the next readInputs() call. Each queued event also
+// posts EVENT_INPUT to the scheduler.
+bool isInputQueued();
+
+// Joystick/held-button sampling period (default 10 ms). The power manager
+// slows it down while the screen is blank.
+void setInputSamplePeriod(uint32_t ms);
+
+// Events dropped because the queue was full
+uint32_t getDroppedInputEvents();
+
 extern bool btnMenuPressed;
 extern bool btnVolumePressed;
 extern bool btnSelectPressed;
@@ -26,5 +75,6 @@ extern bool btnLeftPressed;
 extern bool btnRightPressed;
 extern bool btnAPressed;
 extern bool btnBPressed;
+extern bool btnVolumeLongPressed;
 
 #endif
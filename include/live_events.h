@@ -0,0 +1,21 @@
+#ifndef LIVE_EVENTS_H
+#define LIVE_EVENTS_H
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+// Server-Sent Events push for the web dashboard.
+//   /events           "stats": speeds, alt speed, free space, RSSI, battery
+//   /events/torrents  "stats" plus "torrents" deltas (see renderTorrentDelta)
+// Each update is serialized once on the loop task into a short shared log;
+// every stream is a chunked response that the AsyncTCP task feeds from it.
+// While a stream falls behind, updates are held back; the next one carries
+// the combined change. Torrents are only refetched from the daemon
+// while someone listens on /events/torrents.
+
+void setupLiveEvents(AsyncWebServer &server);
+
+// Counters for /perf
+void fillLiveJson(JsonObject obj);
+
+#endif
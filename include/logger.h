@@ -0,0 +1,68 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+// Levelled log. Lines go into a RAM ring (the newest LOG_RING_SIZE are
+// kept) without locks or UART waits, so any task can log from a hot path.
+// A low-priority task drains the ring to Serial; GET /logs serves it.
+//
+//   LOG_I("wifi", "up in %lu ms", ms);
+//
+// Calls above LOG_MAX_LEVEL are compiled out, arguments included. Release
+// builds keep info and up; the debug environment sets LOG_MAX_LEVEL=4.
+
+#define LOG_LVL_ERROR 1
+#define LOG_LVL_WARN 2
+#define LOG_LVL_INFO 3
+#define LOG_LVL_DEBUG 4
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_LVL_INFO
+#endif
+
+#define LOG_RING_SIZE 64 // Lines kept
+#define LOG_TAG_MAX 8    // Tag bytes kept, NUL included
+#define LOG_TEXT_MAX 112 // Message bytes kept, NUL included
+
+void logWrite(uint8_t level, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#if LOG_MAX_LEVEL >= LOG_LVL_ERROR
+#define LOG_E(tag, ...) logWrite(LOG_LVL_ERROR, tag, __VA_ARGS__)
+#else
+#define LOG_E(tag, ...) ((void)0)
+#endif
+#if LOG_MAX_LEVEL >= LOG_LVL_WARN
+#define LOG_W(tag, ...) logWrite(LOG_LVL_WARN, tag, __VA_ARGS__)
+#else
+#define LOG_W(tag, ...) ((void)0)
+#endif
+#if LOG_MAX_LEVEL >= LOG_LVL_INFO
+#define LOG_I(tag, ...) logWrite(LOG_LVL_INFO, tag, __VA_ARGS__)
+#else
+#define LOG_I(tag, ...) ((void)0)
+#endif
+#if LOG_MAX_LEVEL >= LOG_LVL_DEBUG
+#define LOG_D(tag, ...) logWrite(LOG_LVL_DEBUG, tag, __VA_ARGS__)
+#else
+#define LOG_D(tag, ...) ((void)0)
+#endif
+
+// Start the Serial drain task. Call right after Serial.begin(); lines
+// logged before are kept and drained then.
+void setupLogger();
+
+// Wait up to timeoutMs for the drain task to catch up (before a restart)
+void logFlush(uint32_t timeoutMs);
+
+// GET /logs: the ring as text, oldest first. ?since=<n> returns only lines
+// from sequence number n on; X-Log-Next holds the number to ask for next.
+void setupLogRoutes(AsyncWebServer &server);
+
+// Line counts for /perf
+void fillLogJson(JsonObject obj);
+
+#endif
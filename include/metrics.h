@@ -0,0 +1,25 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// Prometheus text exposition on /metrics: daemon session and torrent
+// counts, RPC latency histograms, Wi-Fi, battery, heap and loop timings.
+// Rendered on the AsyncTCP task into a static buffer from values the
+// other modules already keep, so a scrape costs no heap and no loop time.
+
+enum RpcKind {
+  RPC_KIND_STATS,    // session-stats / session-get polls
+  RPC_KIND_TORRENTS, // torrent-get for the snapshot
+  RPC_KIND_ACTION,   // Pause, resume, alt speed
+  RPC_KIND_PROXY,    // Upstream requests of the RPC proxy
+  RPC_KIND_COUNT
+};
+
+// Record one RPC round trip. Safe to call from any task.
+void metricsObserveRpc(RpcKind kind, uint32_t ms, bool ok);
+
+void setupMetrics(AsyncWebServer &server);
+
+#endif
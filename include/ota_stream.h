@@ -0,0 +1,29 @@
+#ifndef OTA_STREAM_H
+#define OTA_STREAM_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Streaming firmware writer for web uploads. Takes a plain .bin or a
+// gzip-compressed one (told apart by the first bytes), inflates the latter
+// chunk by chunk through the ROM inflater into Update, and hashes the image
+// as it goes. When a manifest hash is given the new partition is only made
+// bootable if the SHA-256 matches.
+// Not reentrant: one upload at a time, all calls from the same task.
+
+// imageSize / sha256Hex come from the manifest (0 / nullptr if unknown);
+// uploadSize is the request body size, used for progress without a manifest
+bool otaStreamBegin(size_t imageSize, const char *sha256Hex,
+                    size_t uploadSize);
+bool otaStreamWrite(const uint8_t *data, size_t len);
+bool otaStreamEnd(); // Verify and switch the boot partition
+void otaStreamAbort();
+
+bool otaStreamActive();
+int otaStreamProgress(); // 0 - 100
+const char *otaStreamError(); // Empty when nothing failed
+
+// Last update for /perf
+void fillOtaJson(JsonObject obj);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Power manager: dims and then blanks the backlight after idle time, puts
+// the Wi-Fi modem to deeper sleep and slows the RPC poll while the screen is
+// off, and enables automatic light sleep when the SDK supports it (CPU
+// frequency scaling otherwise). Keeps a per-mode estimate of current draw.
+
+enum PowerMode { POWER_ACTIVE, POWER_DIM, POWER_BLANK, POWER_MODE_COUNT };
+
+void setupPower(); // After loadConfig()
+
+// Call once per loop pass
+void powerUpdate();
+
+// Call on user input. Returns true if the input only woke a blank screen
+// and should not be acted on.
+bool powerNoteActivity();
+
+// Re-apply brightness and timeouts after a settings change
+void applyPowerSettings();
+
+PowerMode getPowerMode();
+
+// Cap on the idle wait between loop passes (OTA polling)
+uint32_t powerIdleWaitMs();
+
+// Current estimate and per-mode history (/power)
+float getEstimatedCurrentMa();
+void fillPowerJson(JsonObject obj);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <TFT_eSPI.h>
+
+// Lightweight frame profiler. Named sections are timed with micros() and
+// summarised over 1 second windows (count, min/avg/max). Display traffic is
+// counted by ProfiledTFT below. A frame is one loop() iteration.
+
+enum ProfSection {
+  PROF_LOOP,
+  PROF_INPUT,
+  PROF_WEB, // Loop-side work queued by web handlers
+  PROF_FETCH, // Torrent fetch on the loop (list screen or web API)
+  PROF_STATUS_BAR,
+  PROF_DASHBOARD,
+  PROF_SETTINGS,
+  PROF_STATUS_TAB,
+  PROF_MENU,
+  PROF_ABOUT,
+  PROF_WIFI_SCAN,
+  PROF_SECTION_COUNT
+};
+
+void profBegin(ProfSection s);
+void profEnd(ProfSection s);
+
+// Times the enclosing block
+class ProfScope {
+public:
+  explicit ProfScope(ProfSection s) : _s(s) { profBegin(s); }
+  ~ProfScope() { profEnd(_s); }
+
+private:
+  ProfSection _s;
+};
+#define PROFILE_SCOPE(s) ProfScope _profScope(s)
+
+// Display traffic of the current frame
+void profAddDrawCall();
+void profAddSpiBytes(uint32_t bytes);
+
+// Call once at the end of loop(). Rolls the window and refreshes the HUD.
+void profFrameEnd();
+
+// HUD: two-line overlay over the hint bar area (y 220-240)
+bool isPerfHudEnabled();
+void setPerfHudEnabled(bool on);
+
+// Reports for serial and HTTP (/perf)
+void printPerfReport(Print &out);
+void fillPerfJson(JsonObject obj);
+
+// Last completed window, for /metrics
+struct PerfSectionStats {
+  uint32_t count;
+  float avgMs;
+  float maxMs;
+};
+float getPerfFps();
+float getPerfLoopsPerSec();
+const char *getPerfSectionName(ProfSection s);
+PerfSectionStats getPerfSection(ProfSection s);
+
+// Boot timeline: millis() at which each milestone was first reached.
+// Time to the first useful frame is BOOT_FIRST_LIST (cached or live).
+enum BootStage {
+  BOOT_SETUP,      // setup() entered
+  BOOT_CONFIG,     // Settings loaded
+  BOOT_CACHE,      // Cached torrent snapshot loaded (if there was one)
+  BOOT_FIRST_LIST, // First torrent list frame on screen
+  BOOT_WIFI,       // Station associated
+  BOOT_IP,         // DHCP lease
+  BOOT_RPC,        // First successful session-stats poll
+  BOOT_LIVE_LIST,  // First frame drawn from a live fetch
+  BOOT_STAGE_COUNT
+};
+void bootMark(BootStage stage); // Only the first call per stage counts
+void fillBootJson(JsonObject obj);
+
+// Serial commands: 'h' toggles the HUD, 'p' prints a report (with the
+// scheduler's job stats)
+void handlePerfSerial();
+
+// TFT_eSPI with draw call and pixel byte counters. Every primitive the
+// library routes through its virtual draw functions is counted once at the
+// outermost call, with its bounding box as the byte estimate. DMA pushes
+// are not virtual and are reported by the caller with profAddSpiBytes().
+class ProfiledTFT : public TFT_eSPI {
+public:
+  void drawPixel(int32_t x, int32_t y, uint32_t color) override;
+  void drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color,
+                uint32_t bg, uint8_t size) override;
+  int16_t drawChar(uint16_t uniCode, int32_t x, int32_t y,
+                   uint8_t font) override;
+  int16_t drawChar(uint16_t uniCode, int32_t x, int32_t y) override;
+  void drawLine(int32_t xs, int32_t ys, int32_t xe, int32_t ye,
+                uint32_t color) override;
+  void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) override;
+  void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) override;
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h,
+                uint32_t color) override;
+
+private:
+  uint8_t _depth = 0; // Nesting level of counted calls
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef RPC_PROXY_H
+#define RPC_PROXY_H
+
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+// Transmission-compatible /transmission/rpc for other clients on the LAN,
+// enabled by the rpc_proxy setting. Clients log in with the daemon's
+// credentials and do the usual 409 session handshake with the device.
+//  - torrent-get for fields the device already tracks is answered from
+//    the torrent snapshot
+//  - other reads (torrent-get, session-get, session-stats, ...) share one
+//    upstream request per identical query: concurrent ones wait for the
+//    same reply, later ones reuse it for a short time
+//  - everything else passes through and drops the cached replies
+// Upstream requests run on a worker task, never on the AsyncTCP task;
+// replies are only ever sent from the AsyncTCP task. Upstream failures
+// come back as 200 with the error in "result", like daemon errors.
+
+void setupRpcProxy(AsyncWebServer &server);
+
+// Counters for /perf
+void fillRpcProxyJson(JsonObject obj);
+
+#endif
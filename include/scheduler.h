@@ -0,0 +1,47 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Cooperative scheduler for the UI loop. Periodic and one-shot jobs sit on
+// a hashed timer wheel (10 ms ticks). Events posted from other tasks or
+// ISRs are coalesced into a pending mask and handled before due timers.
+// Between passes the loop task sleeps until the next deadline or event.
+
+enum SchedEvent : uint8_t {
+  EVENT_INPUT,  // Input queue has events (input_handler)
+  EVENT_WIFI,   // Station connected, got IP or dropped
+  EVENT_NET,    // Transmission session stats updated
+  EVENT_WEB,    // Web handlers queued work for the loop task
+  EVENT_CONFIG, // Settings changed, a save is pending (config_utils)
+  EVENT_COUNT
+};
+
+typedef void (*SchedFn)();
+
+// Call from setup() (the loop task) before adding jobs
+void setupScheduler();
+
+// Add a job. periodMs 0 makes a one-shot job that only runs when armed with
+// schedRunIn(). Returns the job id, or -1 when the table is full.
+int schedAddJob(const char *name, uint32_t periodMs, SchedFn fn);
+
+// (Re)arm a job to run delayMs from now
+void schedRunIn(int job, uint32_t delayMs);
+
+void schedOnEvent(SchedEvent ev, SchedFn fn);
+void schedPost(SchedEvent ev);
+void schedPostFromIsr(SchedEvent ev, BaseType_t *woken);
+
+// Handle pending events, then run every job whose deadline has passed
+void schedRun();
+
+// Sleep until the next job is due or an event is posted, at most maxWaitMs
+void schedIdle(uint32_t maxWaitMs);
+
+// Per-job runs, run time and lateness (/perf, serial 'p')
+void printSchedReport(Print &out);
+void fillSchedJson(JsonArray arr);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SNAPSHOT_CACHE_H
+#define SNAPSHOT_CACHE_H
+
+#include <ArduinoJson.h>
+
+// Warm start. The torrent snapshot and session values are saved to flash
+// in a compact binary form every few minutes (only after a live fetch
+// changed them) and restored at boot, so the list can be drawn, marked as
+// cached, before Wi-Fi and the daemon are up.
+
+// At boot, after LittleFS is mounted. Returns true if a snapshot was restored.
+bool loadSnapshotCache();
+
+// Adds the periodic save job; call from setup after setupScheduler()
+void setupSnapshotCache();
+
+// Counters for /perf
+void fillSnapshotCacheJson(JsonObject obj);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef STATUS_MODEL_H
+#define STATUS_MODEL_H
+
+#include <Arduino.h>
+
+// Status bar model. Producers (battery sampler, Wi-Fi, transmission task,
+// OTA) push values in; each setter compares at display precision and marks
+// the slots that need a repaint. drawStatusBar() takes the mask and repaints
+// only those slots, so a steady state costs no SPI traffic.
+
+enum StatusSlot : uint8_t {
+  SB_BATTERY = 1 << 0, // Battery icon and percentage
+  SB_WIFI = 1 << 1,    // Signal bars / AP badge
+  SB_SPEEDS = 1 << 2,  // Download and upload rate slots
+  SB_EXTRAS = 1 << 3,  // Free space and alt-speed turtle
+  SB_OTA = 1 << 4,     // OTA label and progress bar
+  SB_ALL = 0x1F
+};
+
+struct StatusModel {
+  float battVolts; // < 0 until the first sample
+  int battPct; // From the battery service discharge curve
+  long rssi;
+  int wifiBars; // 0 - 4, what the icon shows
+  bool transConnected;
+  long dlSpeed; // bytes/sec
+  long ulSpeed;
+  int freeGB; // 0 = unknown
+  bool altSpeed;
+  int otaProgress; // 0 - 100
+};
+
+// Producers. Safe to call from either core.
+void statusSetBattery(float volts, int percent);
+void statusSetRssi(long rssi);
+void statusSetTransfer(bool connected, long dl, long ul, long long freeBytes,
+                       bool altSpeed);
+bool statusSetOta(int percent); // Returns true if the value changed
+
+// Mark slots dirty without a value change (e.g. after a screen clear)
+void statusInvalidate(uint8_t mask);
+
+// Copy the model and take (clear) the pending change mask
+uint8_t statusTakeChanges(StatusModel &out);
+
+// Copy the model, leaving the change mask to the status bar
+void statusRead(StatusModel &out);
+
+int rssiToBars(long rssi);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef TORRENT_API_H
+#define TORRENT_API_H
+
+#include <ESPAsyncWebServer.h>
+
+// JSON views of the torrent snapshot for /api/torrents. Responses are
+// streamed from the snapshot a few rows at a time (chunked), without
+// building a document, and hold the snapshot lock only while a row is
+// rendered. Safe to call from the AsyncTCP task.
+
+// List, with query parameters:
+//   filter=all|downloading|queued_down|seeding|queued_seed|paused|complete|
+//          incomplete|active|checking
+//   q=<text>        case-insensitive name substring
+//   sort=id|name|status|progress|dl|ul|ratio|priority, order=asc|desc
+//   since=<rev>     only torrents changed after rev, plus removed ids
+// Replies {"rev","full","age_ms","total","removed":[ids],"torrents":[...]}.
+// A client applies "removed" before "torrents" and asks again with
+// since=rev. When the delta cannot be served, "full" is true and the list
+// replaces everything the client holds.
+void sendTorrentList(AsyncWebServerRequest *request);
+
+// One torrent by id, or 404
+void sendTorrent(AsyncWebServerRequest *request, int id);
+
+// Unfiltered delta from revision 'since' to the current one, as
+// {"from","rev","removed":[ids],"torrents":[...]} for the live push.
+// Loop task only. Returns false when more than maxRows changed or the
+// removal log does not reach back to since.
+bool renderTorrentDelta(uint32_t since, String &out, int maxRows);
+
+#endif
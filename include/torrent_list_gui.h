@@ -15,11 +15,15 @@ enum TorrentFilter {
   FILTER_INCOMPLETE,
   FILTER_ACTIVE,
   FILTER_CHECKING,
-  FILTER_COUNT // Number of filters
+  FILTER_COUNT // Number of built-in filters; custom filters follow
 };
 
 // State enum for torrent list UI
-enum TorrentListState { TORRENT_LIST_BROWSING, TORRENT_LIST_SEARCHING };
+enum TorrentListState {
+  TORRENT_LIST_BROWSING,
+  TORRENT_LIST_SEARCHING,
+  TORRENT_LIST_PICKING_FILTER // Filter picker overlay with bucket counts
+};
 
 // Initialize the torrent list GUI
 void initTorrentListGui();
@@ -41,4 +45,23 @@ bool isInTorrentSearchMode();
 // Get filter name as string
 const char *getFilterName(TorrentFilter filter);
 
+// Call after custom filters were changed (web UI)
+void onCustomFiltersChanged();
+
+// Force a full repaint on the next draw (another screen used the content area)
+void invalidateTorrentList();
+
+// Bytes pushed to the panel by the last list refresh
+uint32_t getTorrentListRefreshBytes();
+
+// Duration of the last full list repaint, in microseconds
+uint32_t getTorrentListRedrawMicros();
+
+// True when rows are composed in sprites and sent with DMA
+bool isTorrentListUsingDma();
+
+// Milliseconds until pending cursor moves may be drawn (0 = now), or -1
+// when nothing is pending. The main loop redraws the dashboard when due.
+int getTorrentListFrameWait();
+
 #endif
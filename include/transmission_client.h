@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <HTTPClient.h>
+#include <freertos/semphr.h>
 
 // Torrent status enum (matches Transmission API)
 enum TorrentStatus {
@@ -19,23 +20,44 @@ enum TorrentStatus {
 // Max torrents we can store
 #define MAX_TORRENTS 200
 
+// Filter bucket flags, computed once per torrent when a snapshot is ingested
+enum TorrentFlag {
+  TORRENT_FLAG_DOWNLOADING = 1 << 0,
+  TORRENT_FLAG_QUEUED_DOWN = 1 << 1,
+  TORRENT_FLAG_SEEDING = 1 << 2,
+  TORRENT_FLAG_QUEUED_SEED = 1 << 3,
+  TORRENT_FLAG_PAUSED = 1 << 4,
+  TORRENT_FLAG_COMPLETE = 1 << 5,
+  TORRENT_FLAG_INCOMPLETE = 1 << 6,
+  TORRENT_FLAG_ACTIVE = 1 << 7,
+  TORRENT_FLAG_CHECKING = 1 << 8
+};
+#define TORRENT_FLAG_BITS 9
+
 // Torrent data structure
 struct TorrentInfo {
   int id;
   String name;
+  String nameLower; // Case-folded name, refreshed only when name changes
   int status;
   float percentDone; // 0.0 - 1.0
   long rateDownload; // bytes/sec
   long rateUpload;   // bytes/sec
   float uploadRatio;
   int bandwidthPriority; // -1=Low, 0=Normal, 1=High
+  uint16_t flags;        // TorrentFlag bits
+  uint32_t rev;          // Snapshot revision of the last change
 };
 
+// Torrent ids removed from the snapshot, kept for delta queries
+#define REMOVED_LOG_SIZE 16
+
 class TransmissionClient {
 public:
   TransmissionClient();
   void begin();
   void update(); // Call in loop
+  void setUpdateInterval(unsigned long ms); // Session stats poll period
 
   bool isConnected();
   long getDownloadSpeed(); // Bytes/sec
@@ -47,9 +69,35 @@ public:
   // Torrent list methods
   int getTorrentCount();
   TorrentInfo *getTorrents();
+  int getFlagCount(TorrentFlag flag); // Torrents in bucket, last snapshot
   void fetchTorrents();
+  void fetchTorrentsIfStale(unsigned long maxAgeMs);
   void toggleTorrentPause(int torrentId);
 
+  // Snapshot revision. Bumped by every fetch that adds, removes or changes
+  // a torrent; each torrent carries the revision it last changed in. It
+  // starts at a random value so revisions from before a reboot are not
+  // mistaken for current ones.
+  uint32_t getRevision();
+  unsigned long getSnapshotTime(); // millis() of the last fetch, 0 = never
+
+  // Ids removed after revision 'since' (up to max). Returns -1 when since
+  // is outside the range the removal log covers; the caller then needs the
+  // full list.
+  int getRemovedSince(uint32_t since, int *ids, int max);
+
+  // Warm start (snapshot_cache): fill getTorrents() and call this with the
+  // session values saved alongside. The list counts as stale until the
+  // first fetch, which then only marks what changed since.
+  void restoreSnapshot(int count, long dlSpeed, long ulSpeed,
+                       long long freeSpace, bool altSpeed);
+  bool isSnapshotStale();
+
+  // Fetches run on the loop task, which reads the snapshot freely. Other
+  // tasks (web handlers) hold this lock while they read it.
+  void lockTorrents();
+  void unlockTorrents();
+
 private:
   unsigned long _lastUpdate;
   unsigned long _interval; // Interval in ms
@@ -63,8 +111,25 @@ private:
   // Torrent storage
   TorrentInfo _torrents[MAX_TORRENTS];
   int _torrentCount;
+  int _flagCounts[TORRENT_FLAG_BITS];
+  uint32_t _revision;
+  unsigned long _snapshotTime;
+  bool _stale; // Restored from flash, not fetched yet
+  SemaphoreHandle_t _torrentMutex;
+
+  struct RemovedTorrent {
+    int id;
+    uint32_t rev;
+  };
+  RemovedTorrent _removed[REMOVED_LOG_SIZE];
+  int _removedHead;       // Next slot to write
+  int _removedCount;
+  uint32_t _removedFloor; // Oldest revision deltas can start from
 
   void fetchStats();
+  void ingestTorrents(JsonArray torrents);
+  void logRemoved(int id, uint32_t rev);
+  void publishStatus();
 };
 
 extern TransmissionClient transmission;
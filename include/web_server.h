@@ -3,24 +3,41 @@
 
 #include "display_utils.h" // For State enum? Or forward declare?
 #include <ArduinoJson.h>
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 // Needs access to various globals or callbacks...
 // For now, let's keep it simple and declare external dependencies if needed.
 
-extern WebServer server;
+extern AsyncWebServer server;
 
 void setupServerRoutes();
-void handleRoot();
-void handleScanWifi(); // New JSON handler
-void handleScan();
-void handleSave();
-void handleReset();
-void handleRestart();
-void handleStatus();
-void handleGetParams();
-void handleSaveParams();
-void handleSaveParams();
-void handleTestTransmission();
+
+// Run UI-side work and settings changes queued by the handlers (posted as
+// EVENT_WEB)
+void processWebActions();
+
+// Wrap a handler so its time counts against the per-request budget; for
+// routes registered outside web_server.cpp
+ArRequestHandlerFunction webTimed(const char *path,
+                                  ArRequestHandlerFunction fn);
+
+void handleRoot(AsyncWebServerRequest *request);
+void handleScanWifi(AsyncWebServerRequest *request); // New JSON handler
+void handleScan(AsyncWebServerRequest *request);
+void handleSave(AsyncWebServerRequest *request);
+void handleReset(AsyncWebServerRequest *request);
+void handleRestart(AsyncWebServerRequest *request);
+void handleStatus(AsyncWebServerRequest *request);
+void handleGetParams(AsyncWebServerRequest *request);
+void handleSaveParams(AsyncWebServerRequest *request);
+void handleTestTransmission(AsyncWebServerRequest *request);
+void handleJob(AsyncWebServerRequest *request);
+void handleGetFilters(AsyncWebServerRequest *request);
+void handleSaveFilters(AsyncWebServerRequest *request);
+void handlePerf(AsyncWebServerRequest *request);
+void handlePower(AsyncWebServerRequest *request);
+void handleTorrents(AsyncWebServerRequest *request); // /api/torrents[/id]
+void handleConfigExport(AsyncWebServerRequest *request);
+void handleConfigImport(AsyncWebServerRequest *request);
 String testTransmission(const String &host, int port, const String &path,
                         const String &user, const String &pass);
 
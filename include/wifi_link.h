@@ -0,0 +1,34 @@
+#ifndef WIFI_LINK_H
+#define WIFI_LINK_H
+
+#include <ArduinoJson.h>
+
+// Station connects. The BSSID and channel of the last access point and the
+// lease it handed out are cached on flash: connects go straight to that AP
+// without a channel scan, and the static IP profile (config_utils) skips
+// DHCP as well. Connect times from boot and after a drop are measured.
+
+void loadWifiLink(); // At boot, after LittleFS is mounted
+
+// Start connecting to the configured network, on the cached AP when it
+// belongs to this SSID and fullScan is not set
+void wifiLinkBegin(bool fullScan);
+
+// The current attempt targets the cached AP (it may have moved)
+bool wifiLinkUsingCache();
+
+// Start the configuration AP (apSSID). It is open while apPassword is
+// shorter than the 8 characters WPA2 needs; softAP() would refuse it.
+void startSoftAp();
+
+// Call on every Wi-Fi event (loop task). Notes link up/down, and on the
+// first lease of a connect updates the cache on flash if it changed.
+void wifiLinkUpdate();
+
+// Last DHCP lease, as dotted strings (empty if none is cached)
+void fillWifiLeaseJson(JsonObject obj);
+
+// Cache and timing for /perf
+void fillWifiLinkJson(JsonObject obj);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef WIFI_SCAN_CACHE_H
+#define WIFI_SCAN_CACHE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+
+// One Wi-Fi scan service for the web page and the TFT scanner. Scans run
+// asynchronously; results are deduped to the strongest BSSID per SSID,
+// sorted by RSSI and kept until the next scan. In AP (setup) mode the
+// cache refreshes itself every 30 s, so listings are instant.
+
+#define SCAN_CACHE_MAX 20
+
+struct ScanEntry {
+  char ssid[33]; // Empty for hidden networks
+  uint8_t bssid[6];
+  int8_t rssi;
+  uint8_t channel;
+  wifi_auth_mode_t auth;
+};
+
+// Start a scan unless one is running
+void scanCacheRequest();
+
+// Poll from the scheduler and on Wi-Fi events: collects finished scans
+// and starts the periodic refresh in AP mode
+void scanCacheUpdate();
+
+bool isScanCacheBusy();
+
+// Bumped whenever new results are stored
+uint32_t getScanCacheRevision();
+
+// Milliseconds since the last completed scan (UINT32_MAX: never)
+uint32_t getScanCacheAgeMs();
+
+// Copy the current results, strongest first. Returns the count.
+int copyScanCache(ScanEntry *out, int max);
+
+void fillScanCacheJson(JsonArray arr);
+
+#endif
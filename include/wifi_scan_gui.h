@@ -7,11 +7,12 @@
 // WiFi Scan GUI States
 enum WifiScanState {
   WIFI_SCAN_IDLE,        // Not in WiFi scan mode
+  WIFI_SCAN_SCANNING,    // Async scan running
   WIFI_SCAN_LIST,        // Showing network list
   WIFI_SCAN_DETAILS,     // Showing selected network details
   WIFI_SCAN_PASSWORD,    // Password entry screen
   WIFI_SCAN_MANUAL_SSID, // Manual SSID entry for hidden networks
-  WIFI_SCAN_CONNECTING   // Connection in progress
+  WIFI_SCAN_CONNECTING   // Connection in progress (B/SELECT cancels)
 };
 
 // Max networks to cache
@@ -26,6 +27,13 @@ void enterWifiScanMode();
 void exitWifiScanMode();
 bool isInWifiScanMode();
 
+// Scan and connect run in the background. While busy, call
+// updateWifiScanGui() every ~100 ms and on Wi-Fi events: it polls progress
+// and animates the screen. Returns true once a connection succeeded and
+// scan mode was left.
+bool isWifiScanBusy();
+bool updateWifiScanGui();
+
 // Get current state for external reference
 WifiScanState getWifiScanState();
 
@@ -0,0 +1,58 @@
+# Gzips web/dashboard.html into include/web_dashboard_gz.h.
+#
+# Runs before every PlatformIO build (extra_scripts = pre:...) and can also
+# be run by hand: python3 scripts/gzip_web.py. The header is only rewritten
+# when the page changes, so it does not force a rebuild.
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    ROOT = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SOURCE = os.path.join(ROOT, "web", "dashboard.html")
+TARGET = os.path.join(ROOT, "include", "web_dashboard_gz.h")
+
+
+def render(data, etag):
+    lines = [
+        "// Generated by scripts/gzip_web.py from web/dashboard.html.",
+        "// Do not edit.",
+        "#ifndef WEB_DASHBOARD_GZ_H",
+        "#define WEB_DASHBOARD_GZ_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        'const char dashboard_etag[] = "\\"%s\\"";' % etag,
+        "const size_t dashboard_html_gz_len = %d;" % len(data),
+        "const uint8_t dashboard_html_gz[] PROGMEM = {",
+    ]
+    for i in range(0, len(data), 12):
+        chunk = data[i:i + 12]
+        lines.append("    " + ", ".join("0x%02x" % b for b in chunk) + ",")
+    lines += ["};", "", "#endif", ""]
+    return "\n".join(lines)
+
+
+def main():
+    with open(SOURCE, "rb") as f:
+        html = f.read()
+    # mtime=0 keeps the output (and the ETag) stable across builds
+    data = gzip.compress(html, compresslevel=9, mtime=0)
+    etag = hashlib.sha256(html).hexdigest()[:16]
+    out = render(data, etag)
+
+    if os.path.exists(TARGET):
+        with open(TARGET) as f:
+            if f.read() == out:
+                return
+    with open(TARGET, "w") as f:
+        f.write(out)
+    print("gzip_web: %d -> %d bytes, etag %s" % (len(html), len(data), etag))
+
+
+main()
@@ -0,0 +1,59 @@
+# Writes firmware.bin.gz and firmware.json next to firmware.bin for the
+# web updater (/update). The manifest carries the size and SHA-256 of the
+# uncompressed image; the device checks both before switching partitions.
+#
+# Runs after every PlatformIO build (extra_scripts = post:...) and can also
+# be run by hand: python3 scripts/ota_image.py .pio/build/<env>/firmware.bin
+
+import gzip
+import hashlib
+import json
+import os
+import re
+import sys
+
+
+def firmware_version(root):
+    path = os.path.join(root, "include", "web_pages.h")
+    with open(path) as f:
+        m = re.search(r'VERSION = "([^"]+)"', f.read())
+    return m.group(1) if m else "unknown"
+
+
+def write_image(bin_path, root):
+    with open(bin_path, "rb") as f:
+        image = f.read()
+    # mtime=0 keeps the output stable for the same image
+    data = gzip.compress(image, compresslevel=9, mtime=0)
+    gz_path = bin_path + ".gz"
+    with open(gz_path, "wb") as f:
+        f.write(data)
+
+    manifest = {
+        "version": firmware_version(root),
+        "file": os.path.basename(gz_path),
+        "size": len(image),
+        "sha256": hashlib.sha256(image).hexdigest(),
+        "gz_size": len(data),
+    }
+    json_path = os.path.splitext(bin_path)[0] + ".json"
+    with open(json_path, "w") as f:
+        json.dump(manifest, f, indent=2)
+        f.write("\n")
+    print("ota_image: %d -> %d bytes (%.0f%%), sha256 %s" %
+          (len(image), len(data), 100.0 * len(data) / len(image),
+           manifest["sha256"][:16]))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+
+    def after_build(source, target, env):
+        write_image(str(target[0]), env["PROJECT_DIR"])
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", after_build)  # noqa: F821
+except NameError:
+    if len(sys.argv) != 2:
+        sys.exit("usage: ota_image.py path/to/firmware.bin")
+    write_image(sys.argv[1],
+                os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
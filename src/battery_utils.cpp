@@ -1,25 +1,175 @@
 #include "battery_utils.h"
+#include "logger.h"
+#include <esp_timer.h>
 
 #define RESISTANCE_NUM 2
 #define DEFAULT_VREF 1100
-#define NO_OF_SAMPLES 64
+#define BURST_SAMPLES 5      // Median of this many raw reads per tick
+#define SAMPLE_PERIOD_MS 200 // Timer tick
+#define EMA_SHIFT 3          // EMA weight 1/8 per tick (~1.6 s time constant)
+#define SLOPE_PERIOD_MS 60000 // One history point per minute
+#define SLOPE_POINTS 16       // Minutes of history for the runtime estimate
+#define SLOPE_MIN_POINTS 5
 
 static esp_adc_cal_characteristics_t adc_chars;
+static esp_timer_handle_t sampleTimer = nullptr;
+
+// Filter state, only touched by the timer callback
+static uint32_t emaMv16 = 0; // Millivolts << 4
+static bool emaSeeded = false;
+static int16_t history[SLOPE_POINTS]; // Percent x10, one per minute
+static int historyCount = 0;
+static int historyHead = 0;
+static int64_t lastHistoryUs = 0;
+
+// Published values. Single writer (timer task); readers use the sequence
+// counter to get a consistent set without locking.
+static volatile uint32_t pubSeq = 0;
+static volatile uint16_t pubMv = 0;
+static volatile int16_t pubPctX10 = 0;
+static volatile int16_t pubMinutes = -1;
+
+// LiPo discharge curve at light load: millivolts -> percent x10
+struct CurvePoint {
+  uint16_t mv;
+  int16_t pctX10;
+};
+static const CurvePoint lipoCurve[] = {
+    {3400, 0},   {3610, 50},  {3690, 100}, {3710, 150}, {3730, 200},
+    {3750, 250}, {3770, 300}, {3790, 350}, {3800, 400}, {3820, 450},
+    {3840, 500}, {3850, 550}, {3870, 600}, {3910, 650}, {3950, 700},
+    {3980, 750}, {4020, 800}, {4080, 850}, {4110, 900}, {4150, 950},
+    {4200, 1000}};
+#define CURVE_LEN (sizeof(lipoCurve) / sizeof(lipoCurve[0]))
+
+static int16_t curvePercentX10(uint32_t mv) {
+  if (mv <= lipoCurve[0].mv)
+    return 0;
+  for (size_t i = 1; i < CURVE_LEN; i++) {
+    if (mv <= lipoCurve[i].mv) {
+      const CurvePoint &lo = lipoCurve[i - 1];
+      const CurvePoint &hi = lipoCurve[i];
+      return lo.pctX10 + (int32_t)(mv - lo.mv) * (hi.pctX10 - lo.pctX10) /
+                             (hi.mv - lo.mv);
+    }
+  }
+  return 1000;
+}
+
+static uint32_t readMedianRaw() {
+  uint16_t s[BURST_SAMPLES];
+  for (int i = 0; i < BURST_SAMPLES; i++) {
+    uint16_t v = adc1_get_raw(ADC1_CHANNEL_0);
+    // Insertion into the sorted prefix
+    int j = i;
+    while (j > 0 && s[j - 1] > v) {
+      s[j] = s[j - 1];
+      j--;
+    }
+    s[j] = v;
+  }
+  return s[BURST_SAMPLES / 2];
+}
+
+// Least-squares slope of the history in percent x10 per minute
+static float historySlope() {
+  int n = historyCount;
+  float sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (int i = 0; i < n; i++) {
+    int idx = (historyHead - n + i + SLOPE_POINTS) % SLOPE_POINTS;
+    float x = i;
+    float y = history[idx];
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+  float den = n * sxx - sx * sx;
+  return den != 0 ? (n * sxy - sx * sy) / den : 0;
+}
+
+static int16_t estimateMinutes(int16_t pctX10) {
+  int64_t now = esp_timer_get_time();
+  if (lastHistoryUs == 0 || now - lastHistoryUs >= SLOPE_PERIOD_MS * 1000LL) {
+    lastHistoryUs = now;
+    // A jump up means the charger was plugged in: old history is useless
+    if (historyCount > 0) {
+      int prev = (historyHead - 1 + SLOPE_POINTS) % SLOPE_POINTS;
+      if (pctX10 - history[prev] > 30)
+        historyCount = 0;
+    }
+    history[historyHead] = pctX10;
+    historyHead = (historyHead + 1) % SLOPE_POINTS;
+    if (historyCount < SLOPE_POINTS)
+      historyCount++;
+  }
+
+  if (historyCount < SLOPE_MIN_POINTS)
+    return -1;
+  float slope = historySlope();
+  if (slope > -0.5f) // Flat or charging (< 0.05 %/min drop)
+    return -1;
+  float minutes = pctX10 / -slope;
+  return minutes > 1440 ? 1440 : (int16_t)minutes;
+}
+
+static void sampleBattery(void *) {
+  uint32_t raw = readMedianRaw();
+  uint32_t mv = esp_adc_cal_raw_to_voltage(raw, &adc_chars) * RESISTANCE_NUM;
+
+  if (!emaSeeded) {
+    emaMv16 = mv << 4;
+    emaSeeded = true;
+  } else {
+    // ema += (x - ema) / 2^EMA_SHIFT, in Q4
+    int32_t diff = (int32_t)(mv << 4) - (int32_t)emaMv16;
+    emaMv16 += diff >> EMA_SHIFT;
+  }
+  uint16_t filteredMv = emaMv16 >> 4;
+  int16_t pctX10 = curvePercentX10(filteredMv);
+  int16_t minutes = estimateMinutes(pctX10);
+
+  pubSeq++; // Odd: update in progress
+  __sync_synchronize();
+  pubMv = filteredMv;
+  pubPctX10 = pctX10;
+  pubMinutes = minutes;
+  __sync_synchronize();
+  pubSeq++;
+}
 
 void setupBattery() {
   adc1_config_width(ADC_WIDTH_BIT_12);
   adc1_config_channel_atten(ADC1_CHANNEL_0, ADC_ATTEN_DB_12);
   esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_12, ADC_WIDTH_BIT_12,
                            DEFAULT_VREF, &adc_chars);
-}
 
-double getBatteryVoltage() {
-  uint32_t adc_reading = 0;
-  for (int i = 0; i < NO_OF_SAMPLES; i++) {
-    adc_reading += adc1_get_raw((adc1_channel_t)ADC1_CHANNEL_0);
+  // First sample right away so readers have a value at boot
+  sampleBattery(nullptr);
+
+  esp_timer_create_args_t args = {};
+  args.callback = sampleBattery;
+  args.name = "battery";
+  if (esp_timer_create(&args, &sampleTimer) == ESP_OK) {
+    esp_timer_start_periodic(sampleTimer, SAMPLE_PERIOD_MS * 1000ULL);
+  } else {
+    LOG_E("batt", "timer create failed");
   }
-  adc_reading /= NO_OF_SAMPLES;
+}
 
-  return (double)esp_adc_cal_raw_to_voltage(adc_reading, &adc_chars) *
-         RESISTANCE_NUM / 1000;
+BatteryReading getBatteryReading() {
+  BatteryReading r;
+  uint32_t seq;
+  do {
+    seq = pubSeq;
+    __sync_synchronize();
+    r.volts = pubMv / 1000.0f;
+    r.percent = (pubPctX10 + 5) / 10;
+    r.minutesLeft = pubMinutes;
+    __sync_synchronize();
+  } while ((seq & 1) || seq != pubSeq);
+  r.valid = (pubMv != 0);
+  return r;
 }
+
+double getBatteryVoltage() { return getBatteryReading().volts; }
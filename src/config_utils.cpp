@@ -1,4 +1,8 @@
 #include "config_utils.h"
+#include "logger.h"
+#include "scheduler.h"
+#include <esp32/rom/crc.h>
+#include <freertos/semphr.h>
 
 // Define globals
 String ssid = "";
@@ -11,59 +15,346 @@ int transPort = 9091;
 String transPath = "/transmission/rpc";
 String transUser = "";
 String transPass = "";
+bool rpcProxy = false;
+
+bool staticIp = false;
+String staticAddr = "";
+String staticGateway = "";
+String staticMask = "255.255.255.0";
+String staticDns = "";
 
 int brightness = 255; // Default max
 
-const char *CONFIG_FILE = "/config.json";
+int dimTimeout = 30;
+int blankTimeout = 120;
+bool powerSave = true;
+
+const char *LEGACY_CONFIG_FILE = "/config.json";
+static const char *const slotFiles[2] = {"/config.a", "/config.b"};
+
+#define CONFIG_MAGIC 0x46434f47 // "GOCF"
+#define CONFIG_SCHEMA 2
+#define CONFIG_SAVE_DELAY_MS 1500 // Quiet time before a save is written
+#define CONFIG_SAVE_MAX_MS 10000  // Longest a save waits under steady changes
+#define CONFIG_RETRY_MS 10000     // After a failed write
+
+// Stored record. Schema changes only append fields and bump CONFIG_SCHEMA;
+// older (shorter) records load with defaults for the new fields.
+struct ConfigBody {
+  char ssid[CONFIG_SSID_MAX + 1];
+  char password[CONFIG_PASSWORD_MAX + 1];
+  char apSSID[CONFIG_SSID_MAX + 1];
+  char apPassword[CONFIG_PASSWORD_MAX + 1];
+  char transHost[CONFIG_HOST_MAX + 1];
+  char transPath[CONFIG_PATH_MAX + 1];
+  char transUser[CONFIG_USER_MAX + 1];
+  char transPass[CONFIG_PASSWORD_MAX + 1];
+  int32_t transPort;
+  int32_t brightness;
+  int32_t dimTimeout;
+  int32_t blankTimeout;
+  uint8_t powerSave;
+  uint8_t rpcProxy;
+  // Schema 2
+  uint8_t staticIp;
+  char staticAddr[CONFIG_IP_MAX + 1];
+  char staticGateway[CONFIG_IP_MAX + 1];
+  char staticMask[CONFIG_IP_MAX + 1];
+  char staticDns[CONFIG_IP_MAX + 1];
+};
+
+struct ConfigHeader {
+  uint32_t magic;
+  uint16_t schema;
+  uint16_t size; // Body bytes that follow
+  uint32_t seq;  // Higher is newer; the slots alternate
+  uint32_t crc;  // Over the header (crc = 0) and the body
+};
+
+static SemaphoreHandle_t settingsMutex = nullptr;
+
+static ConfigBody pending;  // Latest saveConfig() snapshot
+static ConfigBody stored;   // What the newest slot holds
+static bool dirty = false;
+static unsigned long dirtySince = 0;
+static portMUX_TYPE configMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int saveJob = -1;
+static uint32_t storedSeq = 0;
+static int storedSlot = -1; // -1 = nothing on flash yet
+static uint32_t loadUs = 0;
+static uint32_t saveRequests = 0;
+static uint32_t writes = 0;
+static uint32_t unchanged = 0;
+static uint32_t writeErrors = 0;
+
+// Values are checked where they come in; this is only a backstop
+void setupConfigLock() { settingsMutex = xSemaphoreCreateMutex(); }
+
+void lockConfig() { xSemaphoreTake(settingsMutex, portMAX_DELAY); }
+
+void unlockConfig() { xSemaphoreGive(settingsMutex); }
+
+String DaemonConfig::url() const {
+  return "http://" + host + ":" + String(port) + path;
+}
+
+DaemonConfig getDaemonConfig() {
+  lockConfig();
+  DaemonConfig c = {transHost, transPort, transPath, transUser, transPass};
+  unlockConfig();
+  return c;
+}
+
+static void copyField(char *dst, size_t size, const String &src) {
+  if (strlcpy(dst, src.c_str(), size) >= size)
+    LOG_E("config", "value of %u bytes cut to %u", (unsigned)src.length(),
+          (unsigned)size - 1);
+}
+
+static void packConfig(ConfigBody &b) {
+  memset(&b, 0, sizeof(b));
+  copyField(b.ssid, sizeof(b.ssid), ssid);
+  copyField(b.password, sizeof(b.password), password);
+  copyField(b.apSSID, sizeof(b.apSSID), apSSID);
+  copyField(b.apPassword, sizeof(b.apPassword), apPassword);
+  copyField(b.transHost, sizeof(b.transHost), transHost);
+  copyField(b.transPath, sizeof(b.transPath), transPath);
+  copyField(b.transUser, sizeof(b.transUser), transUser);
+  copyField(b.transPass, sizeof(b.transPass), transPass);
+  b.transPort = transPort;
+  b.brightness = brightness;
+  b.dimTimeout = dimTimeout;
+  b.blankTimeout = blankTimeout;
+  b.powerSave = powerSave;
+  b.rpcProxy = rpcProxy;
+  b.staticIp = staticIp;
+  copyField(b.staticAddr, sizeof(b.staticAddr), staticAddr);
+  copyField(b.staticGateway, sizeof(b.staticGateway), staticGateway);
+  copyField(b.staticMask, sizeof(b.staticMask), staticMask);
+  copyField(b.staticDns, sizeof(b.staticDns), staticDns);
+}
+
+static void unpackConfig(const ConfigBody &b) {
+  lockConfig();
+  ssid = b.ssid;
+  password = b.password;
+  apSSID = b.apSSID;
+  apPassword = b.apPassword;
+  transHost = b.transHost;
+  transPath = b.transPath;
+  transUser = b.transUser;
+  transPass = b.transPass;
+  transPort = b.transPort;
+  brightness = b.brightness;
+  dimTimeout = b.dimTimeout;
+  blankTimeout = b.blankTimeout;
+  powerSave = b.powerSave != 0;
+  rpcProxy = b.rpcProxy != 0;
+  staticIp = b.staticIp != 0;
+  staticAddr = b.staticAddr;
+  staticGateway = b.staticGateway;
+  staticMask = b.staticMask;
+  staticDns = b.staticDns;
+  unlockConfig();
+}
+
+static uint32_t recordCrc(ConfigHeader hdr, const void *body) {
+  hdr.crc = 0;
+  uint32_t crc = crc32_le(0, (const uint8_t *)&hdr, sizeof(hdr));
+  return crc32_le(crc, (const uint8_t *)body, hdr.size);
+}
+
+// Read one slot. Returns false if it is missing, torn or not ours.
+// Fields the record predates keep the values already in body.
+static bool readSlot(int slot, ConfigBody &body, uint32_t &seq) {
+  File file = LittleFS.open(slotFiles[slot], "r");
+  if (!file)
+    return false;
+
+  ConfigHeader hdr;
+  uint8_t buf[sizeof(ConfigBody)];
+  bool ok = file.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == CONFIG_MAGIC && hdr.size <= sizeof(buf) &&
+            file.read(buf, hdr.size) == hdr.size &&
+            recordCrc(hdr, buf) == hdr.crc;
+  file.close();
+  if (!ok) {
+    LOG_W("config", "slot %s is invalid", slotFiles[slot]);
+    return false;
+  }
+  // Newer firmware may have written more fields; those are ignored
+  memcpy(&body, buf, min((size_t)hdr.size, sizeof(body)));
+  body.ssid[sizeof(body.ssid) - 1] = '\0';
+  body.password[sizeof(body.password) - 1] = '\0';
+  body.apSSID[sizeof(body.apSSID) - 1] = '\0';
+  body.apPassword[sizeof(body.apPassword) - 1] = '\0';
+  body.transHost[sizeof(body.transHost) - 1] = '\0';
+  body.transPath[sizeof(body.transPath) - 1] = '\0';
+  body.transUser[sizeof(body.transUser) - 1] = '\0';
+  body.transPass[sizeof(body.transPass) - 1] = '\0';
+  body.staticAddr[sizeof(body.staticAddr) - 1] = '\0';
+  body.staticGateway[sizeof(body.staticGateway) - 1] = '\0';
+  body.staticMask[sizeof(body.staticMask) - 1] = '\0';
+  body.staticDns[sizeof(body.staticDns) - 1] = '\0';
+  seq = hdr.seq;
+  return true;
+}
+
+static bool writeSlot(int slot, const ConfigBody &body, uint32_t seq) {
+  ConfigHeader hdr = {CONFIG_MAGIC, CONFIG_SCHEMA, sizeof(body), seq, 0};
+  hdr.crc = recordCrc(hdr, &body);
+
+  File file = LittleFS.open(slotFiles[slot], "w");
+  if (!file)
+    return false;
+  bool ok = file.write((const uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            file.write((const uint8_t *)&body, sizeof(body)) == sizeof(body);
+  file.close();
+  return ok;
+}
+
+static void onConfigEvent() {
+  bool pendingSave, due;
+  portENTER_CRITICAL(&configMux);
+  pendingSave = dirty;
+  due = millis() - dirtySince >= CONFIG_SAVE_MAX_MS;
+  portEXIT_CRITICAL(&configMux);
+  if (!pendingSave)
+    return;
+  if (due)
+    flushConfig();
+  else
+    schedRunIn(saveJob, CONFIG_SAVE_DELAY_MS); // Restarts the quiet period
+}
+
+// Settings written by firmware before the binary store
+static bool importLegacyConfig() {
+  File file = LittleFS.open(LEGACY_CONFIG_FILE, "r");
+  if (!file)
+    return false;
+  DynamicJsonDocument doc(768);
+  DeserializationError err = deserializeJson(doc, file);
+  file.close();
+  if (err) {
+    LOG_W("config", "legacy file unreadable (%s)", err.c_str());
+    return false;
+  }
+  // The file stays for older firmware rather than losing part of a value
+  const char *key = configJsonTooLong(doc.as<JsonObject>());
+  if (key) {
+    LOG_E("config", "legacy %s too long, not imported", key);
+    return false;
+  }
+  importConfigJson(doc.as<JsonObject>());
+  return true;
+}
 
 void loadConfig() {
-  if (LittleFS.exists(CONFIG_FILE)) {
-    File file = LittleFS.open(CONFIG_FILE, "r");
-    DynamicJsonDocument doc(512);
-    deserializeJson(doc, file);
-    ssid = doc["ssid"].as<String>();
-    password = doc["password"].as<String>();
-    if (doc.containsKey("t_host")) {
-      transHost = doc["t_host"].as<String>();
-      transPort = doc["t_port"] | 9091;
-      transPath = doc["t_path"].as<String>();
-      transUser = doc["t_user"].as<String>();
-      transPass = doc["t_pass"].as<String>();
-    }
-    if (doc.containsKey("ap_ssid")) {
-      apSSID = doc["ap_ssid"].as<String>();
-      apPassword = doc["ap_password"].as<String>();
-    }
-    if (doc.containsKey("brightness")) {
-      brightness = doc["brightness"] | 255;
+  saveJob = schedAddJob("cfg", 0, flushConfig);
+  schedOnEvent(EVENT_CONFIG, onConfigEvent);
+
+  unsigned long t0 = micros();
+  ConfigBody body;
+  packConfig(body); // Defaults for fields a record predates
+  stored = body;
+
+  for (int slot = 0; slot < 2; slot++) {
+    ConfigBody candidate = body;
+    uint32_t seq;
+    if (!readSlot(slot, candidate, seq))
+      continue;
+    if (storedSlot < 0 || (int32_t)(seq - storedSeq) > 0) {
+      stored = candidate;
+      storedSeq = seq;
+      storedSlot = slot;
     }
-    file.close();
-    Serial.println("Config loaded.");
+  }
+  loadUs = micros() - t0;
+
+  if (storedSlot >= 0) {
+    unpackConfig(stored);
+    LOG_I("config", "loaded (slot %d, seq %lu, %lu us)", storedSlot,
+          (unsigned long)storedSeq, (unsigned long)loadUs);
+    return;
+  }
+  if (importLegacyConfig()) {
+    saveConfig();
+    flushConfig();
+    if (storedSlot >= 0)
+      LittleFS.remove(LEGACY_CONFIG_FILE);
+    LOG_I("config", "imported from config.json");
   }
 }
 
 void saveConfig() {
-  DynamicJsonDocument doc(512);
-  doc["ssid"] = ssid;
-  doc["password"] = password;
-  doc["t_host"] = transHost;
-  doc["t_port"] = transPort;
-  doc["t_path"] = transPath;
-  doc["t_user"] = transUser;
-  doc["t_pass"] = transPass;
-  doc["ap_ssid"] = apSSID;
-  doc["ap_password"] = apPassword;
-  doc["brightness"] = brightness;
-
-  File file = LittleFS.open(CONFIG_FILE, "w");
-  serializeJson(doc, file);
-  file.close();
+  ConfigBody body;
+  lockConfig();
+  packConfig(body);
+  unlockConfig();
+  portENTER_CRITICAL(&configMux);
+  pending = body;
+  if (!dirty)
+    dirtySince = millis();
+  dirty = true;
+  saveRequests++;
+  portEXIT_CRITICAL(&configMux);
+  schedPost(EVENT_CONFIG);
+}
+
+// The save stays pending until it is on flash (or a newer one replaces it)
+static void saveDone(uint32_t request) {
+  portENTER_CRITICAL(&configMux);
+  if (saveRequests == request)
+    dirty = false;
+  portEXIT_CRITICAL(&configMux);
 }
 
-void deleteConfig() { LittleFS.remove(CONFIG_FILE); }
+void flushConfig() {
+  ConfigBody body;
+  portENTER_CRITICAL(&configMux);
+  bool wasDirty = dirty;
+  body = pending;
+  uint32_t request = saveRequests;
+  portEXIT_CRITICAL(&configMux);
+  if (!wasDirty)
+    return;
+
+  if (storedSlot >= 0 && memcmp(&body, &stored, sizeof(body)) == 0) {
+    unchanged++;
+    saveDone(request);
+    return;
+  }
+  // Never overwrite the newest good copy
+  int slot = storedSlot < 0 ? 0 : storedSlot ^ 1;
+  uint32_t seq = storedSeq + 1;
+  if (!writeSlot(slot, body, seq)) {
+    writeErrors++;
+    LOG_E("config", "writing %s failed, retrying", slotFiles[slot]);
+    schedRunIn(saveJob, CONFIG_RETRY_MS);
+    return;
+  }
+  stored = body;
+  storedSeq = seq;
+  storedSlot = slot;
+  writes++;
+  saveDone(request);
+}
+
+void deleteConfig() {
+  portENTER_CRITICAL(&configMux);
+  dirty = false; // A pending save must not bring the settings back
+  portEXIT_CRITICAL(&configMux);
+  LittleFS.remove(slotFiles[0]);
+  LittleFS.remove(slotFiles[1]);
+  LittleFS.remove(LEGACY_CONFIG_FILE);
+  storedSlot = -1;
+  storedSeq = 0;
+}
 
 void factoryReset() {
   // Set defaults
+  lockConfig();
   ssid = "";
   password = "";
   apSSID = "ODROID-GO";
@@ -73,13 +364,124 @@ void factoryReset() {
   transPath = "/transmission/rpc";
   transUser = "";
   transPass = "";
+  rpcProxy = false;
+  staticIp = false;
+  staticAddr = "";
+  staticGateway = "";
+  staticMask = "255.255.255.0";
+  staticDns = "";
   brightness = 255;
+  dimTimeout = 30;
+  blankTimeout = 120;
+  powerSave = true;
+  unlockConfig();
 
   // Delete config file
   deleteConfig();
 
   // Restart to AP mode
-  Serial.println("Factory reset! Restarting...");
-  delay(500);
+  LOG_W("config", "factory reset, restarting");
+  logFlush(500);
   ESP.restart();
 }
+
+void exportConfigJson(JsonObject obj) {
+  lockConfig();
+  obj["schema"] = CONFIG_SCHEMA;
+  obj["ssid"] = ssid;
+  obj["password"] = password;
+  obj["t_host"] = transHost;
+  obj["t_port"] = transPort;
+  obj["t_path"] = transPath;
+  obj["t_user"] = transUser;
+  obj["t_pass"] = transPass;
+  obj["ap_ssid"] = apSSID;
+  obj["ap_password"] = apPassword;
+  obj["brightness"] = brightness;
+  obj["dim_s"] = dimTimeout;
+  obj["blank_s"] = blankTimeout;
+  obj["pwr_save"] = powerSave;
+  obj["rpc_proxy"] = rpcProxy;
+  obj["ip_static"] = staticIp;
+  obj["ip_addr"] = staticAddr;
+  obj["ip_gw"] = staticGateway;
+  obj["ip_mask"] = staticMask;
+  obj["ip_dns"] = staticDns;
+  unlockConfig();
+}
+
+void importConfigJson(JsonObject obj) {
+  lockConfig();
+  if (obj.containsKey("ssid"))
+    ssid = obj["ssid"].as<String>();
+  if (obj.containsKey("password"))
+    password = obj["password"].as<String>();
+  if (obj.containsKey("t_host"))
+    transHost = obj["t_host"].as<String>();
+  if (obj.containsKey("t_port"))
+    transPort = obj["t_port"] | 9091;
+  if (obj.containsKey("t_path"))
+    transPath = obj["t_path"].as<String>();
+  if (obj.containsKey("t_user"))
+    transUser = obj["t_user"].as<String>();
+  if (obj.containsKey("t_pass"))
+    transPass = obj["t_pass"].as<String>();
+  if (obj.containsKey("ap_ssid"))
+    apSSID = obj["ap_ssid"].as<String>();
+  if (obj.containsKey("ap_password"))
+    apPassword = obj["ap_password"].as<String>();
+  if (obj.containsKey("brightness"))
+    brightness = obj["brightness"] | 255;
+  if (obj.containsKey("dim_s"))
+    dimTimeout = obj["dim_s"] | 30;
+  if (obj.containsKey("blank_s"))
+    blankTimeout = obj["blank_s"] | 120;
+  if (obj.containsKey("pwr_save"))
+    powerSave = obj["pwr_save"] | true;
+  if (obj.containsKey("rpc_proxy"))
+    rpcProxy = obj["rpc_proxy"] | false;
+  if (obj.containsKey("ip_static"))
+    staticIp = obj["ip_static"] | false;
+  if (obj.containsKey("ip_addr"))
+    staticAddr = obj["ip_addr"].as<String>();
+  if (obj.containsKey("ip_gw"))
+    staticGateway = obj["ip_gw"].as<String>();
+  if (obj.containsKey("ip_mask"))
+    staticMask = obj["ip_mask"].as<String>();
+  if (obj.containsKey("ip_dns"))
+    staticDns = obj["ip_dns"].as<String>();
+  unlockConfig();
+}
+
+struct ConfigLimit {
+  const char *key;
+  size_t max;
+};
+
+static const ConfigLimit configLimits[] = {
+    {"ssid", CONFIG_SSID_MAX},        {"password", CONFIG_PASSWORD_MAX},
+    {"t_host", CONFIG_HOST_MAX},      {"t_path", CONFIG_PATH_MAX},
+    {"t_user", CONFIG_USER_MAX},      {"t_pass", CONFIG_PASSWORD_MAX},
+    {"ap_ssid", CONFIG_SSID_MAX},     {"ap_password", CONFIG_PASSWORD_MAX},
+    {"ip_addr", CONFIG_IP_MAX},       {"ip_gw", CONFIG_IP_MAX},
+    {"ip_mask", CONFIG_IP_MAX},       {"ip_dns", CONFIG_IP_MAX}};
+
+const char *configJsonTooLong(JsonObject obj) {
+  for (const ConfigLimit &l : configLimits) {
+    const char *value = obj[l.key] | "";
+    if (strlen(value) > l.max)
+      return l.key;
+  }
+  return nullptr;
+}
+
+void fillConfigJson(JsonObject obj) {
+  obj["slot"] = storedSlot;
+  obj["seq"] = storedSeq;
+  obj["load_us"] = loadUs;
+  obj["saves"] = saveRequests;
+  obj["writes"] = writes;
+  obj["unchanged"] = unchanged;
+  obj["errors"] = writeErrors;
+  obj["pending"] = dirty;
+}
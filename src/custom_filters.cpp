@@ -0,0 +1,512 @@
+#include "custom_filters.h"
+#include "logger.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+const char *FILTERS_FILE = "/filters.json";
+
+static CustomFilter customFilters[MAX_CUSTOM_FILTERS];
+static int customFilterCount = 0;
+
+// --- Tokenizer ---
+
+enum TokenType {
+  TOK_END,
+  TOK_WORD,
+  TOK_NUMBER,
+  TOK_CMP,
+  TOK_LPAREN,
+  TOK_RPAREN,
+  TOK_AND,
+  TOK_OR,
+  TOK_NOT,
+  TOK_ERROR
+};
+
+struct FilterParser {
+  const char *src;
+  const char *pos;
+  const char *tokStart; // Start of the current token, for error messages
+  TokenType type;
+  char word[16];
+  float number;
+  FilterCmp cmp;
+  FilterProgram *out;
+  int depth; // Current evaluation stack depth of emitted code
+  String *error;
+};
+
+static void nextToken(FilterParser &ps) {
+  while (*ps.pos == ' ' || *ps.pos == '\t')
+    ps.pos++;
+
+  ps.tokStart = ps.pos;
+  const char *p = ps.pos;
+  char c = *p;
+
+  if (c == '\0') {
+    ps.type = TOK_END;
+    return;
+  }
+  if (c == '(' || c == ')') {
+    ps.type = (c == '(') ? TOK_LPAREN : TOK_RPAREN;
+    ps.pos++;
+    return;
+  }
+  if (c == '&' && p[1] == '&') {
+    ps.type = TOK_AND;
+    ps.pos += 2;
+    return;
+  }
+  if (c == '|' && p[1] == '|') {
+    ps.type = TOK_OR;
+    ps.pos += 2;
+    return;
+  }
+  if (c == '<' || c == '>' || c == '=' || c == '!') {
+    bool eq = (p[1] == '=');
+    ps.type = TOK_CMP;
+    if (c == '<')
+      ps.cmp = eq ? FCMP_LE : FCMP_LT;
+    else if (c == '>')
+      ps.cmp = eq ? FCMP_GE : FCMP_GT;
+    else if (c == '=')
+      ps.cmp = FCMP_EQ;
+    else if (eq)
+      ps.cmp = FCMP_NE;
+    else
+      ps.type = TOK_NOT; // Lone '!'
+    ps.pos += eq ? 2 : 1;
+    return;
+  }
+  if (isdigit((unsigned char)c) || c == '.' || c == '-') {
+    char *end;
+    ps.number = strtof(p, &end);
+    if (end == p) {
+      ps.type = TOK_ERROR;
+      return;
+    }
+    // Optional unit suffix for rates and percentages
+    if (*end == 'k' || *end == 'K') {
+      ps.number *= 1024;
+      end++;
+    } else if (*end == 'm' || *end == 'M') {
+      ps.number *= 1048576;
+      end++;
+    } else if (*end == '%') {
+      end++;
+    }
+    ps.type = TOK_NUMBER;
+    ps.pos = end;
+    return;
+  }
+  if (isalpha((unsigned char)c) || c == '_') {
+    int len = 0;
+    while ((isalnum((unsigned char)*p) || *p == '_') &&
+           len < (int)sizeof(ps.word) - 1) {
+      ps.word[len++] = tolower((unsigned char)*p);
+      p++;
+    }
+    ps.word[len] = '\0';
+    ps.pos = p;
+    if (strcmp(ps.word, "and") == 0)
+      ps.type = TOK_AND;
+    else if (strcmp(ps.word, "or") == 0)
+      ps.type = TOK_OR;
+    else if (strcmp(ps.word, "not") == 0)
+      ps.type = TOK_NOT;
+    else
+      ps.type = TOK_WORD;
+    return;
+  }
+  ps.type = TOK_ERROR;
+}
+
+// --- Name tables ---
+
+struct FilterKeyword {
+  const char *name;
+  uint16_t mask;
+};
+
+static const FilterKeyword filterKeywords[] = {
+    {"all", TORRENT_FLAG_COMPLETE | TORRENT_FLAG_INCOMPLETE},
+    {"downloading", TORRENT_FLAG_DOWNLOADING},
+    {"down", TORRENT_FLAG_DOWNLOADING},
+    {"qdown", TORRENT_FLAG_QUEUED_DOWN},
+    {"seeding", TORRENT_FLAG_SEEDING},
+    {"seed", TORRENT_FLAG_SEEDING},
+    {"qseed", TORRENT_FLAG_QUEUED_SEED},
+    {"queued", TORRENT_FLAG_QUEUED_DOWN | TORRENT_FLAG_QUEUED_SEED},
+    {"paused", TORRENT_FLAG_PAUSED},
+    {"stopped", TORRENT_FLAG_PAUSED},
+    {"complete", TORRENT_FLAG_COMPLETE},
+    {"done", TORRENT_FLAG_COMPLETE},
+    {"incomplete", TORRENT_FLAG_INCOMPLETE},
+    {"partial", TORRENT_FLAG_INCOMPLETE},
+    {"active", TORRENT_FLAG_ACTIVE},
+    {"checking", TORRENT_FLAG_CHECKING},
+    {"check", TORRENT_FLAG_CHECKING}};
+
+struct FilterFieldName {
+  const char *name;
+  FilterField field;
+};
+
+static const FilterFieldName filterFieldNames[] = {
+    {"ratio", FFIELD_RATIO},       {"upload", FFIELD_UPLOAD},
+    {"up", FFIELD_UPLOAD},         {"ul", FFIELD_UPLOAD},
+    {"download", FFIELD_DOWNLOAD}, {"dl", FFIELD_DOWNLOAD},
+    {"percent", FFIELD_PERCENT},   {"progress", FFIELD_PERCENT},
+    {"priority", FFIELD_PRIORITY}, {"pri", FFIELD_PRIORITY},
+    {"status", FFIELD_STATUS}};
+
+static bool lookupKeyword(const char *word, uint16_t &mask) {
+  for (const FilterKeyword &k : filterKeywords) {
+    if (strcmp(word, k.name) == 0) {
+      mask = k.mask;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool lookupField(const char *word, FilterField &field) {
+  for (const FilterFieldName &f : filterFieldNames) {
+    if (strcmp(word, f.name) == 0) {
+      field = f.field;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Priority may be written as a word: "priority high"
+static bool lookupPriority(const char *word, float &value) {
+  if (strcmp(word, "high") == 0 || strcmp(word, "hi") == 0)
+    value = 1;
+  else if (strcmp(word, "normal") == 0 || strcmp(word, "md") == 0)
+    value = 0;
+  else if (strcmp(word, "low") == 0 || strcmp(word, "lo") == 0)
+    value = -1;
+  else
+    return false;
+  return true;
+}
+
+// --- Recursive descent compiler (emits postfix code) ---
+
+static bool parseError(FilterParser &ps, const char *msg) {
+  *ps.error = String(msg) + " at " + String((int)(ps.tokStart - ps.src) + 1);
+  return false;
+}
+
+static bool emit(FilterParser &ps, const FilterInstr &instr) {
+  if (ps.out->length >= MAX_FILTER_INSTRS)
+    return parseError(ps, "Expression too long");
+
+  if (instr.op == FOP_FLAGS || instr.op == FOP_CMP)
+    ps.depth++;
+  else if (instr.op == FOP_AND || instr.op == FOP_OR)
+    ps.depth--;
+  if (ps.depth > MAX_FILTER_STACK)
+    return parseError(ps, "Expression nested too deep");
+
+  ps.out->code[ps.out->length++] = instr;
+  return true;
+}
+
+static bool parseOr(FilterParser &ps);
+
+static bool parseTerm(FilterParser &ps) {
+  FilterInstr instr = {};
+
+  if (ps.type == TOK_NOT) {
+    nextToken(ps);
+    if (!parseTerm(ps))
+      return false;
+    instr.op = FOP_NOT;
+    return emit(ps, instr);
+  }
+
+  if (ps.type == TOK_LPAREN) {
+    nextToken(ps);
+    if (!parseOr(ps))
+      return false;
+    if (ps.type != TOK_RPAREN)
+      return parseError(ps, "Missing ')'");
+    nextToken(ps);
+    return true;
+  }
+
+  if (ps.type != TOK_WORD)
+    return parseError(ps, "Expected a filter term");
+
+  // Status keyword
+  uint16_t mask;
+  if (lookupKeyword(ps.word, mask)) {
+    nextToken(ps);
+    instr.op = FOP_FLAGS;
+    instr.mask = mask;
+    return emit(ps, instr);
+  }
+
+  // Field comparison: "<field> <cmp> <value>" or "<field> <value>"
+  FilterField field;
+  if (!lookupField(ps.word, field))
+    return parseError(ps, "Unknown word");
+  nextToken(ps);
+
+  FilterCmp cmp = FCMP_EQ;
+  if (ps.type == TOK_CMP) {
+    cmp = ps.cmp;
+    nextToken(ps);
+  }
+
+  float value;
+  if (ps.type == TOK_NUMBER) {
+    value = ps.number;
+  } else if (ps.type == TOK_WORD && field == FFIELD_PRIORITY &&
+             lookupPriority(ps.word, value)) {
+    // value set by lookupPriority
+  } else {
+    return parseError(ps, "Expected a value");
+  }
+  nextToken(ps);
+
+  instr.op = FOP_CMP;
+  instr.arg = field;
+  instr.cmp = cmp;
+  instr.value = value;
+  return emit(ps, instr);
+}
+
+static bool parseAnd(FilterParser &ps) {
+  if (!parseTerm(ps))
+    return false;
+  while (ps.type == TOK_AND) {
+    nextToken(ps);
+    if (!parseTerm(ps))
+      return false;
+    FilterInstr instr = {};
+    instr.op = FOP_AND;
+    if (!emit(ps, instr))
+      return false;
+  }
+  return true;
+}
+
+static bool parseOr(FilterParser &ps) {
+  if (!parseAnd(ps))
+    return false;
+  while (ps.type == TOK_OR) {
+    nextToken(ps);
+    if (!parseAnd(ps))
+      return false;
+    FilterInstr instr = {};
+    instr.op = FOP_OR;
+    if (!emit(ps, instr))
+      return false;
+  }
+  return true;
+}
+
+bool compileFilterExpr(const char *expr, FilterProgram &out, String &error) {
+  FilterParser ps;
+  ps.src = expr;
+  ps.pos = expr;
+  ps.out = &out;
+  ps.depth = 0;
+  ps.error = &error;
+  out.length = 0;
+
+  if (strlen(expr) > MAX_FILTER_EXPR) {
+    error = "Expression too long";
+    return false;
+  }
+
+  nextToken(ps);
+  if (ps.type == TOK_END) {
+    error = "Empty expression";
+    return false;
+  }
+  if (!parseOr(ps))
+    return false;
+  if (ps.type != TOK_END)
+    return parseError(ps, "Unexpected input");
+  return true;
+}
+
+// --- Evaluation ---
+
+static float fieldValue(const TorrentInfo &t, uint8_t field) {
+  switch (field) {
+  case FFIELD_RATIO:
+    return t.uploadRatio;
+  case FFIELD_UPLOAD:
+    return t.rateUpload;
+  case FFIELD_DOWNLOAD:
+    return t.rateDownload;
+  case FFIELD_PERCENT:
+    return t.percentDone * 100.0f;
+  case FFIELD_PRIORITY:
+    return t.bandwidthPriority;
+  case FFIELD_STATUS:
+    return t.status;
+  default:
+    return 0;
+  }
+}
+
+bool evalFilterProgram(const FilterProgram &prog, const TorrentInfo &t) {
+  // Results are kept as a stack of bits: bit 0 is the top
+  uint32_t stack = 0;
+
+  for (int i = 0; i < prog.length; i++) {
+    const FilterInstr &in = prog.code[i];
+    uint32_t v;
+    switch (in.op) {
+    case FOP_FLAGS:
+      stack = (stack << 1) | ((t.flags & in.mask) ? 1 : 0);
+      break;
+    case FOP_CMP: {
+      float f = fieldValue(t, in.arg);
+      switch (in.cmp) {
+      case FCMP_LT:
+        v = f < in.value;
+        break;
+      case FCMP_LE:
+        v = f <= in.value;
+        break;
+      case FCMP_GT:
+        v = f > in.value;
+        break;
+      case FCMP_GE:
+        v = f >= in.value;
+        break;
+      case FCMP_EQ:
+        v = f == in.value;
+        break;
+      default:
+        v = f != in.value;
+        break;
+      }
+      stack = (stack << 1) | v;
+      break;
+    }
+    case FOP_AND:
+      v = stack & (stack >> 1) & 1;
+      stack = (stack >> 2 << 1) | v;
+      break;
+    case FOP_OR:
+      v = (stack | (stack >> 1)) & 1;
+      stack = (stack >> 2 << 1) | v;
+      break;
+    case FOP_NOT:
+      stack ^= 1;
+      break;
+    }
+  }
+  return stack & 1;
+}
+
+// --- Storage ---
+
+int getCustomFilterCount() { return customFilterCount; }
+
+const CustomFilter *getCustomFilter(int i) {
+  if (i < 0 || i >= customFilterCount)
+    return nullptr;
+  return &customFilters[i];
+}
+
+// Compile every non-empty row into out. Returns the count, or -1 with
+// error set at the first bad expression.
+static int compileFilters(const String *names, const String *exprs, int count,
+                          CustomFilter *out, String &error) {
+  int n = 0;
+  for (int i = 0; i < count && n < MAX_CUSTOM_FILTERS; i++) {
+    String name = names[i];
+    String expr = exprs[i];
+    name.trim();
+    expr.trim();
+    if (name.length() == 0 || expr.length() == 0)
+      continue;
+
+    String err;
+    if (!compileFilterExpr(expr.c_str(), out[n].program, err)) {
+      error = "Filter '" + name + "': " + err;
+      return -1;
+    }
+    strlcpy(out[n].name, name.c_str(), sizeof(out[n].name));
+    out[n].expr = expr;
+    n++;
+  }
+  return n;
+}
+
+bool checkCustomFilters(const String *names, const String *exprs, int count,
+                        String &error) {
+  CustomFilter scratch[MAX_CUSTOM_FILTERS];
+  return compileFilters(names, exprs, count, scratch, error) >= 0;
+}
+
+bool setCustomFilters(const String *names, const String *exprs, int count,
+                      String &error) {
+  // Compile into a scratch list first so a bad row changes nothing
+  static CustomFilter compiled[MAX_CUSTOM_FILTERS];
+  int n = compileFilters(names, exprs, count, compiled, error);
+  if (n < 0)
+    return false;
+
+  for (int i = 0; i < n; i++) {
+    customFilters[i] = compiled[i];
+  }
+  customFilterCount = n;
+  return true;
+}
+
+void loadCustomFilters() {
+  customFilterCount = 0;
+  if (!LittleFS.exists(FILTERS_FILE))
+    return;
+
+  File file = LittleFS.open(FILTERS_FILE, "r");
+  DynamicJsonDocument doc(1024);
+  DeserializationError err = deserializeJson(doc, file);
+  file.close();
+  if (err)
+    return;
+
+  String names[MAX_CUSTOM_FILTERS];
+  String exprs[MAX_CUSTOM_FILTERS];
+  int n = 0;
+  for (JsonObject f : doc.as<JsonArray>()) {
+    if (n >= MAX_CUSTOM_FILTERS)
+      break;
+    names[n] = f["name"].as<String>();
+    exprs[n] = f["expr"].as<String>();
+    n++;
+  }
+
+  String error;
+  if (!setCustomFilters(names, exprs, n, error)) {
+    LOG_W("filter", "not loaded: %s", error.c_str());
+    return;
+  }
+  LOG_I("filter", "loaded %d custom filters", customFilterCount);
+}
+
+void saveCustomFilters() {
+  DynamicJsonDocument doc(1024);
+  JsonArray array = doc.to<JsonArray>();
+  for (int i = 0; i < customFilterCount; i++) {
+    JsonObject f = array.createNestedObject();
+    f["name"] = customFilters[i].name;
+    f["expr"] = customFilters[i].expr;
+  }
+
+  File file = LittleFS.open(FILTERS_FILE, "w");
+  serializeJson(doc, file);
+  file.close();
+}
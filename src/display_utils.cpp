@@ -1,14 +1,5 @@
 #include "display_utils.h"
-#include "battery_utils.h"
-#include "transmission_client.h" // For stats
-
-// Tracking variables for differential updates
-static State lastState = (State)-1;
-static long lastRssi = -1000;
-static IPAddress lastIp;
-static bool lastBlinkState = false;
-static float lastBattery = -1.0;
-static bool lastAltSpeedEnabled = false;
+#include "status_model.h"
 
 #define STATUSBAR_BG 0x2104
 
@@ -44,305 +35,206 @@ String formatSpeedShort(long bytes) {
   return String(bytes / 1048576.0, 1) + "M";
 }
 
-void drawStatusBar() {
-  bool currentBlink = (millis() / 500) % 2 == 0;
-  long currentRssi =
-      (currentState == STATE_CONNECTED || currentState == STATE_DHCP ||
-       currentState == STATE_MENU || currentState == STATE_ABOUT ||
-       currentState == STATE_SETTINGS || currentState == STATE_OTA)
-          ? WiFi.RSSI()
-          : 0;
-  IPAddress currentIp;
-  if (currentState == STATE_CONNECTED || currentState == STATE_MENU ||
-      currentState == STATE_ABOUT || currentState == STATE_SETTINGS)
-    currentIp = WiFi.localIP();
-  else if (currentState == STATE_AP_MODE)
-    currentIp = WiFi.softAPIP();
-
-  bool stateChanged = (currentState != lastState);
-  bool rssiChanged = (currentRssi != lastRssi);
-  bool blinkChanged = (currentBlink != lastBlinkState);
-  static int lastOtaProgress = -1;
-  bool otaChanged =
-      (currentState == STATE_OTA && otaProgress != lastOtaProgress);
-  static bool lastTransConnected = false;
-  bool transConnected = transmission.isConnected();
-  bool transChanged = (transConnected != lastTransConnected);
-  static long lastDl = -1;
-  static long lastUl = -1;
-  long currentDl = transmission.getDownloadSpeed();
-  long currentUl = transmission.getUploadSpeed();
-  bool currentAltSpeed = transmission.isAltSpeedEnabled();
-  bool statsChanged = (currentDl != lastDl || currentUl != lastUl ||
-                       currentAltSpeed != lastAltSpeedEnabled);
-
-  // Redraw if anything significant changed to ensure layout consistency
-  // Ideally we use a full redraw technique for the status bar because positions
-  // are dynamic now. To avoid flicker, we can fillRect only if needed, but
-  // since positions shift, we might need to clear chunks. For simplicity: If
-  // any layout-affecting validation changes, redraw the whole bar.
-
-  // Battery has its own 2-second update timer - allow redraw for it
-  static unsigned long lastBatteryCheck = 0;
-  bool batteryTimerExpired = (millis() - lastBatteryCheck > 2000);
-  if (batteryTimerExpired)
-    lastBatteryCheck = millis();
-
-  bool needsRedraw = stateChanged || rssiChanged ||
-                     (currentState == STATE_CONNECTING && blinkChanged) ||
-                     otaChanged || transChanged || statsChanged ||
-                     batteryTimerExpired;
-
-  if (!needsRedraw)
-    return;
-
-  // Fixed positions for each status bar element (right to left)
-  // This prevents smearing (positions are fixed) and flickering (only clear
-  // what changes)
-  int const Y = 4;
-  int const BATT_ICON_X = 295; // Battery icon (20px wide)
-  int const BATT_PCT_X = 265;  // Battery % (moved 5px right, closer to icon)
-  int const WIFI_ICON_X = 240; // WiFi icon (16px wide)
-  // Transmission area: 0 to WIFI_ICON_X - 5
-
-  // Only clear entire bar on major state changes
-  if (stateChanged) {
-    tft.fillRect(0, 0, 320, 24, STATUSBAR_BG);
-  }
-
-  // Battery averaging: sample every call, update display every 2 seconds
-  static float batterySum = 0;
-  static int batterySamples = 0;
-  static unsigned long lastBatteryUpdate = 0;
-  static int lastDisplayedPct = -1;
-
-  // 1. Battery Icon & Percentage
-  float currentBattery = -1.0;
-  if (currentState != STATE_CONNECTING && currentState != STATE_DHCP) {
-    currentBattery = getBatteryVoltage();
-    batterySum += currentBattery;
-    batterySamples++;
-  }
+// Status bar layout: fixed slots, right to left
+#define SB_Y 4
+#define BATT_ICON_X 295 // Battery icon (20px wide)
+#define BATT_PCT_X 265  // Battery %
+#define WIFI_ICON_X 240 // WiFi icon (16px wide, AP badge 24px)
+#define SPEED_SLOT_W 50 // Fixed width per rate block to prevent jitter
+#define SPEEDS_X (WIFI_ICON_X - 3 - 2 * SPEED_SLOT_W)
+#define OTA_BAR_X 60 // To the right of "OTA..."
+#define OTA_BAR_W 100
+
+// Transfer stats are only shown on these screens
+static bool showsTransfer(State s) {
+  return s == STATE_CONNECTED || s == STATE_MENU || s == STATE_ABOUT ||
+         s == STATE_SETTINGS;
+}
 
-  // Update battery display every 2 seconds
-  bool batteryNeedsUpdate =
-      (millis() - lastBatteryUpdate > 2000) && batterySamples > 0;
-  if (batteryNeedsUpdate || stateChanged) {
-    float avgBattery =
-        (batterySamples > 0) ? (batterySum / batterySamples) : currentBattery;
-    batterySum = 0;
-    batterySamples = 0;
-    lastBatteryUpdate = millis();
-
-    drawBatteryIcon(BATT_ICON_X, Y, avgBattery);
-
-    // 2. Battery Percentage (fixed slot)
-    float pct = (avgBattery - 3.4) / (4.2 - 3.4);
-    if (pct < 0)
-      pct = 0;
-    if (pct > 1)
-      pct = 1;
-    int pctInt = (int)(pct * 100);
-
-    // Only redraw if percentage changed
-    if (pctInt != lastDisplayedPct || stateChanged) {
-      lastDisplayedPct = pctInt;
-      String batStr = String(pctInt) + "%";
-      // Clear the battery percentage slot first
-      tft.fillRect(BATT_PCT_X, 0, 30, 24, STATUSBAR_BG);
-      tft.setTextSize(1);
-      tft.setTextColor(TFT_WHITE, STATUSBAR_BG);
-      tft.setCursor(BATT_PCT_X, Y + 4);
-      tft.print(batStr);
-    }
-  }
+static void drawBatterySlot(const StatusModel &m) {
+  tft.fillRect(BATT_PCT_X, 0, 320 - BATT_PCT_X, 24, STATUSBAR_BG);
+  if (m.battPct < 0)
+    return; // No sample yet
+  drawBatteryIcon(BATT_ICON_X, SB_Y, m.battPct);
+  tft.setTextSize(1);
+  tft.setTextColor(TFT_WHITE, STATUSBAR_BG);
+  tft.setCursor(BATT_PCT_X, SB_Y + 4);
+  tft.print(String(m.battPct) + "%");
+}
 
-  // 3. WiFi Signal (fixed position)
-  int cursorX = WIFI_ICON_X;
+static void drawWifiSlot(const StatusModel &m, bool blink) {
+  tft.fillRect(WIFI_ICON_X, 0, BATT_PCT_X - WIFI_ICON_X, 24, STATUSBAR_BG);
+  int x = WIFI_ICON_X;
 
-  // Logic from old drawWifiIcon
   bool isAP = (WiFi.getMode() == WIFI_AP) || ((WiFi.getMode() == WIFI_AP_STA) &&
                                               (WiFi.status() != WL_CONNECTED));
   if (isAP) {
-    drawAPIcon(cursorX, Y);
+    drawAPIcon(x, SB_Y);
   } else if (currentState == STATE_CONNECTING) {
-    drawWifiIcon(cursorX, Y, -100);
-  } else if (currentState == STATE_DHCP || currentState == STATE_CONNECTED ||
-             currentState == STATE_MENU || currentState == STATE_ABOUT ||
-             currentState == STATE_SETTINGS) {
-    drawWifiIcon(cursorX, Y, currentRssi);
+    drawWifiIcon(x, SB_Y, -100);
+  } else if (currentState == STATE_DHCP || showsTransfer(currentState)) {
+    drawWifiIcon(x, SB_Y, m.rssi);
   } else if (currentState == STATE_OTA) {
-    if (currentBlink)
-      drawWifiIcon(cursorX, Y, currentRssi);
+    if (blink)
+      drawWifiIcon(x, SB_Y, m.rssi);
   } else {
     // X
-    tft.drawLine(cursorX, Y, cursorX + 15, Y + 15, TFT_RED);
-    tft.drawLine(cursorX + 15, Y, cursorX, Y + 15, TFT_RED);
+    tft.drawLine(x, SB_Y, x + 15, SB_Y + 15, TFT_RED);
+    tft.drawLine(x + 15, SB_Y, x, SB_Y + 15, TFT_RED);
   }
+}
+
+// Layout: [DL Text][DL Arrow] [UL Text][UL Arrow] [WiFi]
+static void drawSpeedsSlot(const StatusModel &m) {
+  tft.fillRect(SPEEDS_X, 0, WIFI_ICON_X - SPEEDS_X, 24, STATUSBAR_BG);
+  if (!m.transConnected || !showsTransfer(currentState))
+    return;
 
-  // 4. Transmission Icon & Stats - ONLY when CONNECTED to server
-  if (transConnected &&
-      (currentState == STATE_CONNECTED || currentState == STATE_MENU ||
-       currentState == STATE_ABOUT || currentState == STATE_SETTINGS)) {
-
-    // Clear the transmission area if stats changed (to prevent ghosting)
-    if (statsChanged || transChanged) {
-      tft.fillRect(0, 0, cursorX, 24, STATUSBAR_BG);
-    }
-
-    // cursorX -= (16 + 5); // Icon is 16x16
-    // drawSmallTransmissionIcon(cursorX, Y, transConnected);
-
-    // 5. Speed Stats
-    // Layout: [DL Text][DL Arrow] [UL Text][UL Arrow] [WiFi]
-
-    // Add 3px padding from WiFi icon as requested
-    cursorX -= 3;
-
-    int slotWidth = 50; // Fixed width for each stat block to prevent jitter
-
-    // Upload Block
-    String ulStr = formatSpeedShort(currentUl);
-    int ulTextW = tft.textWidth(ulStr);
-
-    // Align right within slot
-    cursorX -= slotWidth;
-    int ulIconX = cursorX + slotWidth - 10; // Icon at far right of slot
-    int ulTextX = ulIconX - 2 - ulTextW;    // Text to left of icon
-
-    // Draw Upload Arrow (Red Up)
-    tft.fillTriangle(ulIconX, Y + 8, ulIconX + 8, Y + 8, ulIconX + 4, Y + 2,
-                     TFT_RED);
-    tft.fillRect(ulIconX + 3, Y + 8, 2, 4, TFT_RED);
-
-    tft.setCursor(ulTextX, Y + 4);
-    tft.print(ulStr);
-
-    // Download Block
-    String dlStr = formatSpeedShort(currentDl);
-    int dlTextW = tft.textWidth(dlStr);
-
-    // Align right within slot
-    cursorX -= slotWidth;
-    int dlIconX = cursorX + slotWidth - 10;
-    int dlTextX = dlIconX - 2 - dlTextW;
-
-    // Draw Download Arrow (Green Down)
-    tft.fillTriangle(dlIconX, Y + 6, dlIconX + 8, Y + 6, dlIconX + 4, Y + 12,
-                     TFT_GREEN);
-    tft.fillRect(dlIconX + 3, Y + 2, 2, 4, TFT_GREEN);
-
-    tft.setCursor(dlTextX, Y + 4);
-    tft.print(dlStr);
-
-    // 5.1 Free Space Display (to the left of download stats)
-    long long freeBytes = transmission.getFreeSpace();
-    if (freeBytes > 0) {
-      // Format as GB
-      int freeGB = freeBytes / 1073741824LL; // 1024^3
-      String freeStr = String(freeGB) + "G";
-      int freeTextW = tft.textWidth(freeStr);
-
-      cursorX -= (freeTextW + 16); // Text + icon + spacing
-      int fx = cursorX;
-      int fy = Y + 2;
-
-      // HDD Icon: Gray rectangle with disk inside
-      tft.fillRoundRect(fx, fy + 2, 12, 10, 1, TFT_DARKGREY);  // HDD body
-      tft.drawRoundRect(fx, fy + 2, 12, 10, 1, TFT_LIGHTGREY); // Border
-      tft.fillCircle(fx + 6, fy + 6, 3, TFT_LIGHTGREY);        // Disk platter
-      tft.fillCircle(fx + 6, fy + 6, 1, TFT_DARKGREY);         // Center hole
-      tft.fillRect(fx + 9, fy + 9, 2, 2, TFT_GREEN);           // Activity LED
-
-      // Free space text
-      tft.setTextColor(TFT_WHITE, STATUSBAR_BG);
-      tft.setCursor(fx + 14, Y + 4);
-      tft.print(freeStr);
-    }
-
-    // 5.2 Turtle Icon for Alt-Speed Mode (to the left of free space)
-    if (transmission.isAltSpeedEnabled()) {
-      cursorX -= 18; // Space for turtle icon
-      int tx = cursorX;
-      int ty = Y + 2;
+  tft.setTextSize(1);
+  tft.setTextColor(TFT_WHITE, STATUSBAR_BG);
+
+  // Upload Block: icon at far right of slot, text to its left
+  String ulStr = formatSpeedShort(m.ulSpeed);
+  int ulIconX = SPEEDS_X + 2 * SPEED_SLOT_W - 10;
+  int ulTextX = ulIconX - 2 - tft.textWidth(ulStr);
+  tft.fillTriangle(ulIconX, SB_Y + 8, ulIconX + 8, SB_Y + 8, ulIconX + 4,
+                   SB_Y + 2, TFT_RED);
+  tft.fillRect(ulIconX + 3, SB_Y + 8, 2, 4, TFT_RED);
+  tft.setCursor(ulTextX, SB_Y + 4);
+  tft.print(ulStr);
+
+  // Download Block
+  String dlStr = formatSpeedShort(m.dlSpeed);
+  int dlIconX = SPEEDS_X + SPEED_SLOT_W - 10;
+  int dlTextX = dlIconX - 2 - tft.textWidth(dlStr);
+  tft.fillTriangle(dlIconX, SB_Y + 6, dlIconX + 8, SB_Y + 6, dlIconX + 4,
+                   SB_Y + 12, TFT_GREEN);
+  tft.fillRect(dlIconX + 3, SB_Y + 2, 2, 4, TFT_GREEN);
+  tft.setCursor(dlTextX, SB_Y + 4);
+  tft.print(dlStr);
+}
 
 // Detailed Turtle (v2)
-// Color constants
 #define TURTLE_BROWN 0xCC68 // Light brown-ish
-      // Shell: Green
-      // Head/Legs: Brown
-
-      // Bigger Shell (12x9)
-      tft.fillRoundRect(tx + 2, ty + 3, 12, 9, 4, TFT_GREEN);
-
-      // Shell Pattern
-      tft.drawPixel(tx + 5, ty + 5, STATUSBAR_BG);
-      tft.drawPixel(tx + 9, ty + 5, STATUSBAR_BG);
-      tft.drawPixel(tx + 7, ty + 8, STATUSBAR_BG);
-
-      // Head (Brown)
-      tft.fillCircle(tx + 15, ty + 5, 2, TURTLE_BROWN);
-      // Eye (Black)
-      tft.drawPixel(tx + 15, ty + 4, TFT_BLACK);
-
-      // Back Legs Only (Brown)
-      tft.fillRect(tx + 3, ty + 11, 2, 3, TURTLE_BROWN);  // Back Left
-      tft.fillRect(tx + 11, ty + 11, 2, 3, TURTLE_BROWN); // Back Right
-    }
-
-  } else if (transChanged && !transConnected) {
-    // Clear transmission area when disconnected
-    // Fix: Clear up to cursorX to ensure no artifacts (like the 1px from UL
-    // icon) are left. Previously cursorX - 5 missed the rightmost edge of the
-    // icon.
-    tft.fillRect(0, 0, cursorX, 24, STATUSBAR_BG);
-  }
+static void drawTurtleIcon(int tx, int ty) {
+  // Bigger Shell (12x9)
+  tft.fillRoundRect(tx + 2, ty + 3, 12, 9, 4, TFT_GREEN);
+
+  // Shell Pattern
+  tft.drawPixel(tx + 5, ty + 5, STATUSBAR_BG);
+  tft.drawPixel(tx + 9, ty + 5, STATUSBAR_BG);
+  tft.drawPixel(tx + 7, ty + 8, STATUSBAR_BG);
+
+  // Head (Brown)
+  tft.fillCircle(tx + 15, ty + 5, 2, TURTLE_BROWN);
+  // Eye (Black)
+  tft.drawPixel(tx + 15, ty + 4, TFT_BLACK);
+
+  // Back Legs Only (Brown)
+  tft.fillRect(tx + 3, ty + 11, 2, 3, TURTLE_BROWN);  // Back Left
+  tft.fillRect(tx + 11, ty + 11, 2, 3, TURTLE_BROWN); // Back Right
+}
+
+static void drawOtaBar(int progress) {
+  tft.fillRect(OTA_BAR_X, 10, OTA_BAR_W, 4, UI_GREY);
+  tft.fillRect(OTA_BAR_X, 10, (progress * OTA_BAR_W) / 100, 4, TFT_GREEN);
+}
+
+// Everything left of the speed slots: free space and turtle when connected,
+// otherwise the OTA / connecting status text
+static void drawLeftSlot(const StatusModel &m) {
+  tft.fillRect(0, 0, SPEEDS_X, 24, STATUSBAR_BG);
+  tft.setTextSize(1);
+  tft.setTextColor(TFT_WHITE, STATUSBAR_BG);
 
-  // 6. Left side status text (Connecting etc/ OTA)
   if (currentState == STATE_OTA) {
     tft.setCursor(5, 4);
     tft.print("OTA...");
+    drawOtaBar(m.otaProgress);
+    return;
+  }
+  if (currentState == STATE_CONNECTING) {
+    tft.setCursor(5, 4);
+    tft.print("Connecting...");
+    return;
+  }
+  if (!m.transConnected || !showsTransfer(currentState))
+    return;
 
-    // Restore OTA Progress Bar
-    // Draw a frame or just a bar
-    int barWidth = 100;
-    int barHeight = 4;
-    int x = 60; // To the right of "OTA..." text
-    int y = 10;
+  int cursorX = SPEEDS_X;
 
-    // Background
-    tft.fillRect(x, y, barWidth, barHeight, UI_GREY);
-    // Progress
-    int fillW = (otaProgress * barWidth) / 100;
-    tft.fillRect(x, y, fillW, barHeight, TFT_GREEN);
+  // Free Space (to the left of download stats)
+  if (m.freeGB > 0) {
+    String freeStr = String(m.freeGB) + "G";
+    cursorX -= (tft.textWidth(freeStr) + 16); // Text + icon + spacing
+    int fx = cursorX;
+    int fy = SB_Y + 2;
 
-  } else if (currentState == STATE_CONNECTING) {
-    tft.setCursor(5, 4);
-    tft.print("Connecting...");
+    // HDD Icon: Gray rectangle with disk inside
+    tft.fillRoundRect(fx, fy + 2, 12, 10, 1, TFT_DARKGREY);  // HDD body
+    tft.drawRoundRect(fx, fy + 2, 12, 10, 1, TFT_LIGHTGREY); // Border
+    tft.fillCircle(fx + 6, fy + 6, 3, TFT_LIGHTGREY);        // Disk platter
+    tft.fillCircle(fx + 6, fy + 6, 1, TFT_DARKGREY);         // Center hole
+    tft.fillRect(fx + 9, fy + 9, 2, 2, TFT_GREEN);           // Activity LED
+
+    tft.setCursor(fx + 14, SB_Y + 4);
+    tft.print(freeStr);
   }
 
-  lastState = currentState;
-  lastRssi = currentRssi;
-  lastBlinkState = currentBlink;
-  lastOtaProgress = otaProgress;
-  lastTransConnected = transConnected;
-  lastDl = currentDl;
-  lastUl = currentUl;
-  lastAltSpeedEnabled = currentAltSpeed;
-  lastBattery = currentBattery;
+  // Turtle Icon for Alt-Speed Mode (to the left of free space)
+  if (m.altSpeed) {
+    cursorX -= 18;
+    drawTurtleIcon(cursorX, SB_Y + 2);
+  }
+}
+
+// Repaints only the slots whose model values changed since the last call.
+// Cheap enough to call from anywhere; producers live in status_model.h.
+void drawStatusBar() {
+  PROFILE_SCOPE(PROF_STATUS_BAR);
+  static State lastState = (State)-1;
+  static bool lastBlink = false;
+
+  StatusModel m;
+  uint8_t mask = statusTakeChanges(m);
+
+  // A state change can move or hide any element: repaint everything
+  if (currentState != lastState) {
+    tft.fillRect(0, 0, 320, 24, STATUSBAR_BG);
+    mask = SB_ALL;
+    lastState = currentState;
+  }
+
+  // The Wi-Fi icon blinks during OTA
+  bool blink = (millis() / 500) % 2 == 0;
+  if (currentState == STATE_OTA && blink != lastBlink)
+    mask |= SB_WIFI;
+  lastBlink = blink;
+
+  if (mask == 0)
+    return;
+
+  if (mask & SB_BATTERY)
+    drawBatterySlot(m);
+  if (mask & SB_WIFI)
+    drawWifiSlot(m, blink);
+  if (mask & SB_SPEEDS)
+    drawSpeedsSlot(m);
+
+  if (mask & SB_EXTRAS) {
+    drawLeftSlot(m);
+  } else if ((mask & SB_OTA) && currentState == STATE_OTA) {
+    drawOtaBar(m.otaProgress); // Progress only, label is unchanged
+  }
 }
 
-void drawBatteryIcon(int x, int y, float voltage) {
+void drawBatteryIcon(int x, int y, int percent) {
   // Outline
   tft.drawRect(x, y + 2, 18, 12, TFT_WHITE);
   tft.fillRect(x + 18, y + 5, 2, 6, TFT_WHITE);
 
-  // Fill based on voltage (approx 3.3V - 4.2V range)
-  float percentage = (voltage - 3.4) / (4.2 - 3.4);
-  if (percentage < 0)
-    percentage = 0;
-  if (percentage > 1.0)
-    percentage = 1.0;
+  // Fill based on the discharge-curve percentage
+  float percentage = constrain(percent, 0, 100) / 100.0f;
 
   int w = percentage * 14;
   uint16_t color = TFT_GREEN;
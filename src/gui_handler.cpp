@@ -2,6 +2,7 @@
 #include "battery_utils.h"
 #include "config_utils.h"
 #include "input_handler.h"
+#include "status_model.h"
 #include "torrent_list_gui.h"
 #include "transmission_client.h"
 #include "web_pages.h" // For VERSION constant
@@ -62,6 +63,8 @@ void drawSignalIcon(int x, int y, int rssi) {
 }
 
 void drawMenu() {
+  PROFILE_SCOPE(PROF_MENU);
+  invalidateTorrentList();
   tft.fillRect(0, 24, 320, 216, TFT_BLACK); // Clear main area (keep status bar)
 
   tft.setTextSize(2);
@@ -88,6 +91,8 @@ void drawMenu() {
 }
 
 void drawAbout() {
+  PROFILE_SCOPE(PROF_ABOUT);
+  invalidateTorrentList();
   // Fill content area with dark background
   tft.fillRect(0, 24, 320, 216, UI_BG);
 
@@ -239,6 +244,8 @@ void drawPortEditArea() {
 }
 
 void drawSettings() {
+  PROFILE_SCOPE(PROF_SETTINGS);
+  invalidateTorrentList();
   // Fill content area with dark background
   tft.fillRect(0, 24, 320, 216, UI_BG);
 
@@ -637,8 +644,10 @@ bool handleSettingsInput(bool up, bool down, bool left, bool right, bool a,
         char tempIPStr[16];
         sprintf(tempIPStr, "%d.%d.%d.%d", tempIP[0], tempIP[1], tempIP[2],
                 tempIP[3]);
+        lockConfig();
         transHost = String(tempIPStr);
         transPort = atoi(tempPort);
+        unlockConfig();
         saveConfig();
 
         tft.fillRect(20, 200, 280, 20, UI_BG);
@@ -804,7 +813,7 @@ void updateStatusValues() {
   }
 
   // 4. Battery
-  float currentBatt = getBatteryVoltage();
+  float currentBatt = getBatteryVoltage(); // Filtered, no ADC access
   if (abs(currentBatt - lastBatt) > 0.05 || firstRunStatus) {
     tft.fillRect(valueX, startTextY + lineH * 4, 100, 10, UI_CARD_BG);
     tft.setCursor(valueX, startTextY + lineH * 4);
@@ -816,6 +825,8 @@ void updateStatusValues() {
 }
 
 void drawStatus() {
+  PROFILE_SCOPE(PROF_STATUS_TAB);
+  invalidateTorrentList();
   firstRunStatus = true; // Force full update
   lastSSID = "";         // Reset caches
   drawStatusLayout();
@@ -842,13 +853,18 @@ void menuSelect() {
 }
 
 void drawDashboard() {
-  // If connected to Transmission server, show torrent list
-  if (WiFi.status() == WL_CONNECTED && transmission.isConnected()) {
+  PROFILE_SCOPE(PROF_DASHBOARD);
+  // If connected to Transmission server, show torrent list. Until the
+  // first fetch, last session's list stands in (marked as cached).
+  bool cached = transmission.isSnapshotStale() && currentState != STATE_AP_MODE;
+  if ((WiFi.status() == WL_CONNECTED && transmission.isConnected()) ||
+      cached) {
     drawTorrentList();
     return;
   }
 
   // Otherwise show waiting/connection screen
+  invalidateTorrentList();
   tft.fillRect(0, 24, 320, 216, UI_BG);
 
   // Transmission icon centered
@@ -1,4 +1,8 @@
 #include "input_handler.h"
+#include "logger.h"
+#include "scheduler.h"
+#include <esp_timer.h>
+#include <freertos/queue.h>
 
 bool btnMenuPressed = false;
 bool btnVolumePressed = false;
@@ -10,21 +14,159 @@ bool btnLeftPressed = false;
 bool btnRightPressed = false;
 bool btnAPressed = false;
 bool btnBPressed = false;
+bool btnVolumeLongPressed = false;
 
-// State tracking for edge detection
-static bool prevBtnMenu = true;
-static bool prevBtnVolume = true;
-static bool prevBtnSelect = true;
-static bool prevBtnStart = true;
-static bool prevBtnA = true;
-static bool prevBtnB = true;
-static bool prevUp = false;
-static bool prevDown = false;
-static bool prevLeft = false;
-static bool prevRight = false;
-
-// Debounce handling
-unsigned long lastDebounceTime = 0;
+#define INPUT_QUEUE_LEN 32
+#define SAMPLE_PERIOD_MS 10
+#define DEBOUNCE_MS 15
+#define LONG_PRESS_MS 700
+#define REPEAT_DELAY_MS 400 // First repeat
+#define REPEAT_START_MS 150 // Then every ...
+#define REPEAT_MIN_MS 30    // ... shrinking to this
+#define REPEAT_ACCEL 85     // Percent of the previous interval
+
+// Digital buttons (active LOW). START sits on GPIO39, which gets spurious
+// interrupts while the ADC is powered (ESP32 errata 3.11), so it is only
+// sampled by the timer.
+static const uint8_t buttonPins[] = {BTN_MENU, BTN_VOLUME, BTN_SELECT,
+                                     BTN_START, BTN_A, BTN_B};
+#define DIGITAL_COUNT 6
+#define BIT(b) (1u << (b))
+static const uint16_t noIrqMask = BIT(INPUT_START);
+static const uint16_t repeatMask =
+    BIT(INPUT_UP) | BIT(INPUT_DOWN) | BIT(INPUT_LEFT) | BIT(INPUT_RIGHT);
+static const uint16_t longPressMask = BIT(INPUT_VOLUME);
+
+static QueueHandle_t eventQueue = nullptr;
+static esp_timer_handle_t sampleTimer = nullptr;
+static volatile uint32_t droppedEvents = 0;
+
+// Button state, shared by the ISRs and the timer task
+static portMUX_TYPE inputMux = portMUX_INITIALIZER_UNLOCKED;
+static bool held[INPUT_BUTTON_COUNT];
+static uint32_t lastEdgeMs[INPUT_BUTTON_COUNT];
+static uint32_t pressStartMs[INPUT_BUTTON_COUNT];
+static uint32_t nextRepeatMs[INPUT_BUTTON_COUNT];
+static uint16_t repeatIntervalMs[INPUT_BUTTON_COUNT];
+static bool longFired[INPUT_BUTTON_COUNT];
+
+// Joystick hysteresis: enter and leave thresholds differ so a stick resting
+// near a boundary does not chatter.
+// ODROID-GO joystick actual values (measured):
+// - Center (rest): ~0
+// - UP / LEFT: 4095 (high extreme)
+// - DOWN / RIGHT: ~2000 (middle range)
+static bool axisHigh(int v, bool wasOn) { return v > (wasOn ? 2800 : 3000); }
+
+static bool axisMid(int v, bool wasOn) {
+  return wasOn ? (v > 1300 && v < 2700) : (v > 1500 && v < 2500);
+}
+
+static void IRAM_ATTR pushEvent(uint8_t button, uint8_t type, uint32_t now,
+                                bool fromIsr, BaseType_t *woken) {
+  InputEvent ev = {button, type, now};
+  BaseType_t ok = fromIsr ? xQueueSendFromISR(eventQueue, &ev, woken)
+                          : xQueueSend(eventQueue, &ev, 0);
+  if (ok != pdTRUE) {
+    droppedEvents++;
+    return;
+  }
+  // Wake the UI loop
+  if (fromIsr)
+    schedPostFromIsr(EVENT_INPUT, woken);
+  else
+    schedPost(EVENT_INPUT);
+}
+
+// Apply a debounced state change. Returns the events to send (up to 2), so
+// they can be queued outside the critical section.
+static int IRAM_ATTR applyState(uint8_t b, bool pressed, uint32_t now,
+                                uint8_t *types) {
+  int n = 0;
+  if (pressed == held[b] || now - lastEdgeMs[b] < DEBOUNCE_MS)
+    return 0;
+  lastEdgeMs[b] = now;
+  held[b] = pressed;
+
+  if (pressed) {
+    pressStartMs[b] = now;
+    longFired[b] = false;
+    nextRepeatMs[b] = now + REPEAT_DELAY_MS;
+    repeatIntervalMs[b] = REPEAT_START_MS;
+    if (!(longPressMask & BIT(b)))
+      types[n++] = INPUT_PRESS;
+  } else {
+    // Long-press buttons report a short press on release
+    if ((longPressMask & BIT(b)) && !longFired[b])
+      types[n++] = INPUT_PRESS;
+    types[n++] = INPUT_RELEASE;
+  }
+  return n;
+}
+
+static void IRAM_ATTR buttonIsr(void *arg) {
+  uint8_t b = (uint8_t)(uintptr_t)arg;
+  uint32_t now = millis();
+  bool pressed = digitalRead(buttonPins[b]) == LOW;
+  uint8_t types[2];
+
+  portENTER_CRITICAL_ISR(&inputMux);
+  int n = applyState(b, pressed, now, types);
+  portEXIT_CRITICAL_ISR(&inputMux);
+
+  BaseType_t woken = pdFALSE;
+  for (int i = 0; i < n; i++)
+    pushEvent(b, types[i], now, true, &woken);
+  if (woken)
+    portYIELD_FROM_ISR();
+}
+
+static void setStateFromTask(uint8_t b, bool pressed, uint32_t now) {
+  uint8_t types[2];
+  portENTER_CRITICAL(&inputMux);
+  int n = applyState(b, pressed, now, types);
+  portEXIT_CRITICAL(&inputMux);
+  for (int i = 0; i < n; i++)
+    pushEvent(b, types[i], now, false, nullptr);
+}
+
+// 10 ms tick: joystick axes, the non-IRQ button, a resync of the IRQ
+// buttons (catches an edge dropped by the debounce), repeat and long-press
+static void sampleInputs(void *) {
+  uint32_t now = millis();
+
+  for (int b = 0; b < DIGITAL_COUNT; b++) {
+    bool pressed = digitalRead(buttonPins[b]) == LOW;
+    setStateFromTask(b, pressed, now);
+  }
+
+  int joyY = analogRead(BTN_JOY_Y);
+  int joyX = analogRead(BTN_JOY_X);
+  setStateFromTask(INPUT_UP, axisHigh(joyY, held[INPUT_UP]), now);
+  setStateFromTask(INPUT_DOWN, axisMid(joyY, held[INPUT_DOWN]), now);
+  setStateFromTask(INPUT_LEFT, axisHigh(joyX, held[INPUT_LEFT]), now);
+  setStateFromTask(INPUT_RIGHT, axisMid(joyX, held[INPUT_RIGHT]), now);
+
+  for (int b = 0; b < INPUT_BUTTON_COUNT; b++) {
+    uint8_t type = 0xFF;
+    portENTER_CRITICAL(&inputMux);
+    if (held[b]) {
+      if ((repeatMask & BIT(b)) && (int32_t)(now - nextRepeatMs[b]) >= 0) {
+        type = INPUT_REPEAT;
+        uint16_t next = repeatIntervalMs[b] * REPEAT_ACCEL / 100;
+        repeatIntervalMs[b] = max((uint16_t)REPEAT_MIN_MS, next);
+        nextRepeatMs[b] = now + repeatIntervalMs[b];
+      } else if ((longPressMask & BIT(b)) && !longFired[b] &&
+                 now - pressStartMs[b] >= LONG_PRESS_MS) {
+        type = INPUT_LONG;
+        longFired[b] = true;
+      }
+    }
+    portEXIT_CRITICAL(&inputMux);
+    if (type != 0xFF)
+      pushEvent(b, type, now, false, nullptr);
+  }
+}
 
 void setupInputs() {
   pinMode(BTN_MENU, INPUT_PULLUP);
@@ -33,10 +175,57 @@ void setupInputs() {
   pinMode(BTN_START, INPUT_PULLUP);
   pinMode(BTN_A, INPUT_PULLUP);
   pinMode(BTN_B, INPUT_PULLUP);
+
+  eventQueue = xQueueCreate(INPUT_QUEUE_LEN, sizeof(InputEvent));
+
+  for (int b = 0; b < DIGITAL_COUNT; b++) {
+    if (noIrqMask & BIT(b))
+      continue;
+    attachInterruptArg(digitalPinToInterrupt(buttonPins[b]), buttonIsr,
+                       (void *)(uintptr_t)b, CHANGE);
+  }
+
+  esp_timer_create_args_t args = {};
+  args.callback = sampleInputs;
+  args.name = "input";
+  if (esp_timer_create(&args, &sampleTimer) == ESP_OK) {
+    esp_timer_start_periodic(sampleTimer, SAMPLE_PERIOD_MS * 1000ULL);
+  } else {
+    LOG_E("input", "timer create failed");
+  }
 }
 
-void readInputs() {
-  // Reset one-shot flags
+static bool *flagFor(const InputEvent &ev) {
+  if (ev.type == INPUT_LONG)
+    return ev.button == INPUT_VOLUME ? &btnVolumeLongPressed : nullptr;
+  if (ev.type != INPUT_PRESS && ev.type != INPUT_REPEAT)
+    return nullptr;
+  switch (ev.button) {
+  case INPUT_MENU:
+    return &btnMenuPressed;
+  case INPUT_VOLUME:
+    return &btnVolumePressed;
+  case INPUT_SELECT:
+    return &btnSelectPressed;
+  case INPUT_START:
+    return &btnStartPressed;
+  case INPUT_A:
+    return &btnAPressed;
+  case INPUT_B:
+    return &btnBPressed;
+  case INPUT_UP:
+    return &btnUpPressed;
+  case INPUT_DOWN:
+    return &btnDownPressed;
+  case INPUT_LEFT:
+    return &btnLeftPressed;
+  case INPUT_RIGHT:
+    return &btnRightPressed;
+  }
+  return nullptr;
+}
+
+void clearInputFlags() {
   btnMenuPressed = false;
   btnVolumePressed = false;
   btnSelectPressed = false;
@@ -47,75 +236,43 @@ void readInputs() {
   btnRightPressed = false;
   btnAPressed = false;
   btnBPressed = false;
+  btnVolumeLongPressed = false;
+}
 
-  // No global rate limiting - poll every loop
-  // Debouncing is handled by state logic or external timing if needed
-  // lastDebounceTime = millis();
-
-  // --- Digital Buttons (Active LOW) ---
-  bool curMenu = digitalRead(BTN_MENU);
-  if (curMenu == LOW && prevBtnMenu == HIGH)
-    btnMenuPressed = true;
-  prevBtnMenu = curMenu;
-
-  bool curVolume = digitalRead(BTN_VOLUME);
-  if (curVolume == LOW && prevBtnVolume == HIGH)
-    btnVolumePressed = true;
-  prevBtnVolume = curVolume;
-
-  bool curSelect = digitalRead(BTN_SELECT);
-  if (curSelect == LOW && prevBtnSelect == HIGH)
-    btnSelectPressed = true;
-  prevBtnSelect = curSelect;
-
-  bool curStart = digitalRead(BTN_START);
-  if (curStart == LOW && prevBtnStart == HIGH)
-    btnStartPressed = true;
-  prevBtnStart = curStart;
-
-  bool curA = digitalRead(BTN_A);
-  if (curA == LOW && prevBtnA == HIGH)
-    btnAPressed = true;
-  prevBtnA = curA;
-
-  bool curB = digitalRead(BTN_B);
-  if (curB == LOW && prevBtnB == HIGH)
-    btnBPressed = true;
-  prevBtnB = curB;
-
-  // --- Joystick handling (Analog) ---
-  // ODROID-GO joystick actual values (measured):
-  // - Center (rest): X≈0, Y≈0
-  // - UP: Y=4095, DOWN: Y≈2000
-  // - LEFT: X=4095, RIGHT: X≈2000
-  int joyY = analogRead(BTN_JOY_Y);
-  int joyX = analogRead(BTN_JOY_X);
+bool anyInputPressed() {
+  return btnMenuPressed || btnVolumePressed || btnSelectPressed ||
+         btnStartPressed || btnUpPressed || btnDownPressed || btnLeftPressed ||
+         btnRightPressed || btnAPressed || btnBPressed || btnVolumeLongPressed;
+}
+
+void readInputs() {
+  clearInputFlags(); // One-shot flags
+
+  if (!eventQueue)
+    return;
 
-  // UP: Y > 3000 (high extreme)
-  // DOWN: Y between 1500 and 2500 (middle range)
-  // CENTER: Y < 1000 (rest position)
-  bool curUp = (joyY > 3000);
-  bool curDown = (joyY > 1500 && joyY < 2500);
-
-  if (curUp && !prevUp)
-    btnUpPressed = true;
-  if (curDown && !prevDown)
-    btnDownPressed = true;
-
-  prevUp = curUp;
-  prevDown = curDown;
-
-  // LEFT: X > 3000 (high extreme)
-  // RIGHT: X between 1500 and 2500 (middle range)
-  // CENTER: X < 1000 (rest position)
-  bool curLeft = (joyX > 3000);
-  bool curRight = (joyX > 1500 && joyX < 2500);
-
-  if (curLeft && !prevLeft)
-    btnLeftPressed = true;
-  if (curRight && !prevRight)
-    btnRightPressed = true;
-
-  prevLeft = curLeft;
-  prevRight = curRight;
+  InputEvent ev;
+  while (xQueuePeek(eventQueue, &ev, 0) == pdTRUE) {
+    bool *flag = flagFor(ev);
+    if (flag && *flag)
+      break; // Same flag twice: leave it for the next loop pass
+    xQueueReceive(eventQueue, &ev, 0);
+    if (flag)
+      *flag = true;
+  }
 }
+
+bool isInputQueued() {
+  return eventQueue && uxQueueMessagesWaiting(eventQueue) > 0;
+}
+
+void setInputSamplePeriod(uint32_t ms) {
+  static uint32_t current = SAMPLE_PERIOD_MS;
+  if (!sampleTimer || ms == current)
+    return;
+  current = ms;
+  esp_timer_stop(sampleTimer);
+  esp_timer_start_periodic(sampleTimer, ms * 1000ULL);
+}
+
+uint32_t getDroppedInputEvents() { return droppedEvents; }
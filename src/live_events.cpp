@@ -0,0 +1,255 @@
+#include "live_events.h"
+#include "battery_utils.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "status_model.h"
+#include "torrent_api.h"
+#include "transmission_client.h"
+#include "web_server.h"
+#include <freertos/semphr.h>
+#include <memory>
+
+#define LIVE_TICK_MS 1000
+#define LIVE_FETCH_MS 3000 // Torrent refetch period while subscribed
+#define LIVE_MAX_ROWS 40   // Larger deltas become a resync hint
+#define LIVE_MAX_BACKLOG 4 // Unsent events per stream before holding back
+#define LIVE_LOG_LEN 8     // Events kept for streams catching up
+#define LIVE_MAX_STREAMS 4
+
+// The loop task appends events to liveLog; each stream's response copies
+// the ones it has not sent when the AsyncTCP task polls it, so sockets are
+// only written on the AsyncTCP task. Everything below is under liveMutex.
+struct LiveEvent {
+  std::shared_ptr<String> text; // "event: ...\ndata: ...\n\n"
+  bool torrents;                // Only for /events/torrents
+};
+
+struct LiveStream {
+  bool torrents;
+  uint32_t next; // Sequence of the next event to take from liveLog
+  std::shared_ptr<String> pending;
+  size_t sent; // Bytes of pending already sent
+  ~LiveStream();
+};
+
+static SemaphoreHandle_t liveMutex = nullptr;
+static LiveEvent liveLog[LIVE_LOG_LEN];
+static uint32_t liveSeq = 0; // Sequence of the next event
+static LiveStream *streams[LIVE_MAX_STREAMS];
+static std::shared_ptr<String> currentStats; // For streams that open later
+
+// Loop task only
+static char lastStats[160] = "";
+static uint32_t pushedRev = 0;
+static bool pushedRevValid = false;
+
+static uint32_t liveSent = 0;
+static uint32_t liveHeld = 0;
+
+LiveStream::~LiveStream() {
+  xSemaphoreTake(liveMutex, portMAX_DELAY);
+  for (LiveStream *&s : streams) {
+    if (s == this)
+      s = nullptr;
+  }
+  xSemaphoreGive(liveMutex);
+}
+
+static void countStreams(size_t &all, size_t &torrents) {
+  all = 0;
+  torrents = 0;
+  xSemaphoreTake(liveMutex, portMAX_DELAY);
+  for (LiveStream *s : streams) {
+    if (!s)
+      continue;
+    all++;
+    if (s->torrents)
+      torrents++;
+  }
+  xSemaphoreGive(liveMutex);
+}
+
+static bool isBackedUp() {
+  bool backedUp = false;
+  xSemaphoreTake(liveMutex, portMAX_DELAY);
+  for (LiveStream *s : streams) {
+    if (s && liveSeq - s->next > LIVE_MAX_BACKLOG)
+      backedUp = true;
+  }
+  xSemaphoreGive(liveMutex);
+  return backedUp;
+}
+
+static std::shared_ptr<String> eventText(const char *event,
+                                         const char *data) {
+  std::shared_ptr<String> text(new String());
+  text->reserve(strlen(event) + strlen(data) + 16);
+  *text += "event: ";
+  *text += event;
+  *text += "\ndata: ";
+  *text += data;
+  *text += "\n\n";
+  return text;
+}
+
+static void publish(const std::shared_ptr<String> &text, bool torrents) {
+  xSemaphoreTake(liveMutex, portMAX_DELAY);
+  LiveEvent &e = liveLog[liveSeq % LIVE_LOG_LEN];
+  e.text = text;
+  e.torrents = torrents;
+  liveSeq++;
+  xSemaphoreGive(liveMutex);
+  liveSent++;
+}
+
+static void pushStats() {
+  StatusModel m;
+  statusRead(m);
+  BatteryReading batt = getBatteryReading();
+
+  char msg[sizeof(lastStats)];
+  snprintf(msg, sizeof(msg),
+           "{\"conn\":%s,\"dl\":%ld,\"ul\":%ld,\"alt\":%s,\"free_gb\":%d,"
+           "\"rssi\":%ld,\"batt\":%.2f,\"batt_pct\":%d,\"batt_min\":%d}",
+           m.transConnected ? "true" : "false", m.dlSpeed, m.ulSpeed,
+           m.altSpeed ? "true" : "false", m.freeGB, m.rssi, batt.volts,
+           batt.percent, batt.minutesLeft);
+  if (strcmp(msg, lastStats) == 0)
+    return;
+  strcpy(lastStats, msg);
+  std::shared_ptr<String> text = eventText("stats", msg);
+  xSemaphoreTake(liveMutex, portMAX_DELAY);
+  currentStats = text;
+  xSemaphoreGive(liveMutex);
+  publish(text, false);
+}
+
+static void pushTorrents() {
+  uint32_t rev = transmission.getRevision();
+  if (!pushedRevValid) {
+    // Subscribers load the list over /api/torrents and catch up from here
+    pushedRev = rev;
+    pushedRevValid = true;
+    return;
+  }
+  if (rev == pushedRev)
+    return;
+
+  String msg;
+  if (!renderTorrentDelta(pushedRev, msg, LIVE_MAX_ROWS)) {
+    char hint[64];
+    snprintf(hint, sizeof(hint), "{\"from\":%lu,\"rev\":%lu,\"resync\":true}",
+             (unsigned long)pushedRev, (unsigned long)rev);
+    msg = hint;
+  }
+  publish(eventText("torrents", msg.c_str()), true);
+  pushedRev = rev;
+}
+
+static void liveTick() {
+  size_t clients, torrentClients;
+  countStreams(clients, torrentClients);
+  if (clients == 0) {
+    lastStats[0] = '\0'; // Stale by the time someone subscribes
+    xSemaphoreTake(liveMutex, portMAX_DELAY);
+    currentStats.reset();
+    xSemaphoreGive(liveMutex);
+    pushedRevValid = false;
+    return;
+  }
+  if (isBackedUp()) {
+    liveHeld++;
+    return;
+  }
+
+  pushStats();
+  if (torrentClients == 0) {
+    pushedRevValid = false;
+    return;
+  }
+  {
+    PROFILE_SCOPE(PROF_FETCH);
+    transmission.fetchTorrentsIfStale(LIVE_FETCH_MS);
+  }
+  pushTorrents();
+}
+
+// The rest of the event being sent, else the next one for this stream.
+// Runs on the AsyncTCP task on every ack or poll (about twice a second).
+static size_t fillStream(LiveStream &s, uint8_t *buf, size_t maxLen) {
+  xSemaphoreTake(liveMutex, portMAX_DELAY);
+  while ((!s.pending || s.sent == s.pending->length()) && s.next != liveSeq) {
+    // A stream that fell behind skips ahead; the page resyncs the torrent
+    // list when a delta does not start from its revision
+    if (liveSeq - s.next > LIVE_LOG_LEN)
+      s.next = liveSeq - LIVE_LOG_LEN;
+    const LiveEvent &e = liveLog[s.next % LIVE_LOG_LEN];
+    s.next++;
+    if (e.torrents && !s.torrents)
+      continue;
+    s.pending = e.text;
+    s.sent = 0;
+  }
+  xSemaphoreGive(liveMutex);
+
+  size_t n = s.pending ? min(maxLen, s.pending->length() - s.sent) : 0;
+  if (n == 0)
+    return RESPONSE_TRY_AGAIN;
+  memcpy(buf, s.pending->c_str() + s.sent, n);
+  s.sent += n;
+  return n;
+}
+
+// Stats only go out when they change, so a new stream starts with the
+// current ones
+static void openStream(AsyncWebServerRequest *request, bool torrents) {
+  std::shared_ptr<LiveStream> stream(new LiveStream());
+  stream->torrents = torrents;
+  stream->sent = 0;
+  bool added = false;
+  xSemaphoreTake(liveMutex, portMAX_DELAY);
+  stream->next = liveSeq;
+  stream->pending = currentStats;
+  for (LiveStream *&s : streams) {
+    if (!s && !added) {
+      s = stream.get();
+      added = true;
+    }
+  }
+  xSemaphoreGive(liveMutex);
+  if (!added) {
+    request->send(503, "text/plain", "Too many event streams");
+    return;
+  }
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "text/event-stream",
+      [stream](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        return fillStream(*stream, buf, maxLen);
+      });
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+void setupLiveEvents(AsyncWebServer &server) {
+  liveMutex = xSemaphoreCreateMutex();
+  // Before /events, which would also match /events/torrents
+  server.on("/events/torrents", HTTP_GET,
+            webTimed("/events/torrents", [](AsyncWebServerRequest *request) {
+              openStream(request, true);
+            }));
+  server.on("/events", HTTP_GET,
+            webTimed("/events", [](AsyncWebServerRequest *request) {
+              openStream(request, false);
+            }));
+  schedAddJob("live", LIVE_TICK_MS, liveTick);
+}
+
+void fillLiveJson(JsonObject obj) {
+  size_t clients, torrentClients;
+  countStreams(clients, torrentClients);
+  obj["clients"] = clients - torrentClients;
+  obj["torrent_clients"] = torrentClients;
+  obj["sent"] = liveSent;
+  obj["held"] = liveHeld;
+}
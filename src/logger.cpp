@@ -0,0 +1,143 @@
+#include "logger.h"
+#include "web_server.h"
+#include <freertos/task.h>
+#include <stdarg.h>
+
+// One line. seq is the line's sequence number + 1 once it is complete and
+// 0 while a writer fills it; readers copy the slot and check seq again.
+struct LogEntry {
+  uint32_t seq;
+  uint32_t ms;
+  uint8_t level;
+  char tag[LOG_TAG_MAX];
+  char text[LOG_TEXT_MAX];
+};
+
+static LogEntry ring[LOG_RING_SIZE];
+static uint32_t logHead = 0; // Sequence number of the next line
+static uint32_t drainSeq = 0; // Next line for Serial
+static uint32_t drainDropped = 0;
+static TaskHandle_t drainTask = nullptr;
+
+static const char levelChars[] = "?EWID";
+
+void logWrite(uint8_t level, const char *tag, const char *fmt, ...) {
+  // Claiming a slot is the only shared write. Two writers only meet in a
+  // slot when LOG_RING_SIZE lines are logged while one is being written.
+  uint32_t seq = __atomic_fetch_add(&logHead, 1, __ATOMIC_RELAXED);
+  LogEntry &e = ring[seq % LOG_RING_SIZE];
+  __atomic_store_n(&e.seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  e.ms = millis();
+  e.level = level;
+  strlcpy(e.tag, tag, sizeof(e.tag));
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(e.text, sizeof(e.text), fmt, args);
+  va_end(args);
+
+  __atomic_store_n(&e.seq, seq + 1, __ATOMIC_RELEASE);
+  if (drainTask)
+    xTaskNotifyGive(drainTask);
+}
+
+// Copy line seq. Returns 1 if copied, 0 if it is still being written and
+// -1 if it was overwritten.
+static int readEntry(uint32_t seq, LogEntry &out) {
+  const LogEntry &e = ring[seq % LOG_RING_SIZE];
+  uint32_t before = __atomic_load_n(&e.seq, __ATOMIC_ACQUIRE);
+  if (before != seq + 1)
+    return (int32_t)(before - (seq + 1)) > 0 ? -1 : 0;
+  memcpy(&out, &e, sizeof(out));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  uint32_t after = __atomic_load_n(&e.seq, __ATOMIC_RELAXED);
+  if (after != before)
+    return -1; // Reused while we copied
+  out.tag[sizeof(out.tag) - 1] = '\0';
+  out.text[sizeof(out.text) - 1] = '\0';
+  return 1;
+}
+
+static void printEntry(Print &out, const LogEntry &e) {
+  out.printf("[%6lu.%03lu] %c %s: %s\n", (unsigned long)(e.ms / 1000),
+             (unsigned long)(e.ms % 1000), levelChars[e.level & 7],
+             e.tag, e.text);
+}
+
+// Serial is the only place that waits on the UART
+static void drainLoop(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint32_t head = __atomic_load_n(&logHead, __ATOMIC_ACQUIRE);
+    while (drainSeq != head) {
+      if (head - drainSeq > LOG_RING_SIZE) {
+        uint32_t lost = head - drainSeq - LOG_RING_SIZE;
+        drainDropped += lost;
+        drainSeq += lost;
+        Serial.printf("(%lu log lines dropped)\n", (unsigned long)lost);
+      }
+      LogEntry e;
+      int r = readEntry(drainSeq, e);
+      if (r == 0) {
+        vTaskDelay(1); // A writer is mid-line
+        continue;
+      }
+      if (r > 0)
+        printEntry(Serial, e);
+      else
+        drainDropped++;
+      drainSeq++;
+      head = __atomic_load_n(&logHead, __ATOMIC_ACQUIRE);
+    }
+  }
+}
+
+void setupLogger() {
+  xTaskCreatePinnedToCore(drainLoop, "LogDrain", 4096, NULL, 1, &drainTask,
+                          0);
+  xTaskNotifyGive(drainTask); // Lines from before the task
+}
+
+void logFlush(uint32_t timeoutMs) {
+  unsigned long start = millis();
+  while (drainSeq != __atomic_load_n(&logHead, __ATOMIC_ACQUIRE) &&
+         millis() - start < timeoutMs)
+    delay(5);
+}
+
+static void handleLogs(AsyncWebServerRequest *request) {
+  uint32_t head = __atomic_load_n(&logHead, __ATOMIC_ACQUIRE);
+  uint32_t first = head > LOG_RING_SIZE ? head - LOG_RING_SIZE : 0;
+  if (request->hasParam("since")) {
+    uint32_t since = request->getParam("since")->value().toInt();
+    if ((int32_t)(since - first) > 0)
+      first = min(since, head);
+  }
+
+  AsyncResponseStream *response =
+      request->beginResponseStream("text/plain");
+  uint32_t seq = first;
+  for (; seq != head; seq++) {
+    LogEntry e;
+    int r = readEntry(seq, e);
+    if (r == 0)
+      break; // Still being written: next request starts here
+    if (r > 0)
+      printEntry(*response, e);
+  }
+  response->addHeader("Cache-Control", "no-store");
+  response->addHeader("X-Log-Next", String(seq));
+  request->send(response);
+}
+
+void setupLogRoutes(AsyncWebServer &server) {
+  server.on("/logs", HTTP_GET, webTimed("/logs", handleLogs));
+}
+
+void fillLogJson(JsonObject obj) {
+  obj["level"] = LOG_MAX_LEVEL;
+  obj["lines"] = __atomic_load_n(&logHead, __ATOMIC_RELAXED);
+  obj["drained"] = drainSeq;
+  obj["dropped"] = drainDropped;
+}
@@ -6,18 +6,27 @@
 #include <TFT_eSPI.h>
 #include <Update.h>
 
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 #include <WiFi.h>
 
 #include "battery_utils.h"
 #include "config_utils.h"
+#include "custom_filters.h"
 #include "display_utils.h"
 #include "gui_handler.h"
 #include "input_handler.h"
+#include "logger.h"
+#include "power_manager.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "snapshot_cache.h"
+#include "status_model.h"
 #include "torrent_list_gui.h"
 #include "transmission_client.h"
 #include "web_pages.h"
 #include "web_server.h"
+#include "wifi_link.h"
+#include "wifi_scan_cache.h"
 #include "wifi_scan_gui.h"
 
 // --- Configuration ---
@@ -27,12 +36,11 @@ const char *AP_SSID = "ODROID-GO_Config";
 // CONFIG_FILE is in config_utils.cpp
 
 // --- Globals ---
-// server is defined in web_server.cpp
-TFT_eSPI tft = TFT_eSPI();
+// server is defined in web_server.cpp (async, runs on the AsyncTCP task)
+ProfiledTFT tft; // TFT_eSPI with draw counters (profiler.h)
 // Globals ssid, password, transHost... are in config_utils.cpp
 
 State currentState = STATE_AP_MODE;
-int otaProgress = 0;
 unsigned long connectionStartTime = 0;
 
 // --- Function Prototypes ---
@@ -45,6 +53,7 @@ void deleteConfig();
 void setupAP(); // This will be replaced by startAPMode
 void startAPMode();
 void connectToWiFi();
+void setupJobs(); // Scheduler jobs and event handlers
 
 TaskHandle_t transmissionTask;
 
@@ -57,9 +66,13 @@ void transmissionTaskLoop(void *pvParameters) {
 
 // --- Setup ---
 void setup() {
-  delay(1000);
+  bootMark(BOOT_SETUP);
   Serial.begin(115200);
-  Serial.println("BOOT: Starting Full Firmware...");
+  setupLogger();
+  LOG_I("boot", "starting full firmware");
+
+  setupConfigLock();    // Settings lock, before any task can read them
+  transmission.begin(); // Snapshot lock, before any task can read it
 
   // Launch Transmission Task on Core 0
   xTaskCreatePinnedToCore(
@@ -71,6 +84,7 @@ void setup() {
       &transmissionTask,    /* Task handle. */
       0);                   /* Core where the task should run */
 
+  setupScheduler(); // Input ISRs post events to it
   setupInputs();    // Initialize buttons
   setupBattery();   // Initialize ADC
   setupBacklight(); // Initialize PWM for backlight
@@ -87,119 +101,271 @@ void setup() {
   // --- OTA Setup ---
   ArduinoOTA.setHostname("ODROID-GO-Monitor");
   ArduinoOTA.onStart([]() {
-    Serial.println("Start OTA");
+    LOG_I("ota", "ArduinoOTA start");
+    powerNoteActivity(); // Show the progress bar
     currentState = STATE_OTA;
-    otaProgress = 0;
+    statusSetOta(0);
     drawStatusBar();
   });
   ArduinoOTA.onEnd([]() {
-    otaProgress = 100;
+    statusSetOta(100);
     drawStatusBar();
-    Serial.println("\nEnd");
+    LOG_I("ota", "ArduinoOTA done");
+    logFlush(200); // ArduinoOTA restarts right after
   });
   ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
     int p = (progress / (total / 100));
-    if (p != otaProgress) {
-      otaProgress = p;
+    if (statusSetOta(p)) {
       drawStatusBar();
     }
   });
   ArduinoOTA.onError(
-      [](ota_error_t error) { Serial.printf("Error[%u]: ", error); });
+      [](ota_error_t error) { LOG_E("ota", "ArduinoOTA error %u", error); });
 
   // LittleFS
   if (!LittleFS.begin(true)) {
-    Serial.println("LittleFS mount failed");
+    LOG_E("boot", "LittleFS mount failed");
   } else {
-    Serial.println("LittleFS mounted");
+    LOG_I("boot", "LittleFS mounted");
   }
 
   loadConfig();
+  bootMark(BOOT_CONFIG);
+  loadWifiLink();
+  loadSnapshotCache(); // Last session's torrents, shown until the first fetch
+  setupSnapshotCache();
+  loadCustomFilters();
+  setupPower(); // Backlight level and timeouts come from the config
   setupServerRoutes();
 
   if (ssid != "") {
-    Serial.println("Connecting to WiFi...");
     connectToWiFi();
+    if (transmission.isSnapshotStale())
+      drawDashboard(); // Cached list while Wi-Fi and the daemon come up
   } else {
-    Serial.println("Starting AP Mode...");
     startAPMode();
   }
 
-  Serial.println("Starting OTA...");
   ArduinoOTA.begin();
-  Serial.println("Starting Web Server...");
   server.begin();
 
-  Serial.println("Initial drawStatusBar...");
+  setupJobs();
+
   drawStatusBar();
-  Serial.println("Setup Complete.");
+  LOG_I("boot", "setup complete");
 }
 
-// --- Loop ---
-void loop() {
-  static unsigned long dhcpStartTime = 0;
-  static unsigned long lastStatusUpdate = 0;
+// --- Scheduled jobs ---
+
+static int listFrameJob = -1;
+static int wifiScanJob = -1;
+static int wifiCheckJob = -1;
+static unsigned long dhcpStartTime = 0;
+
+#define MAX_RECONNECT_ATTEMPTS 3
+#define CONNECT_TIMEOUT_MS 20000 // Per attempt
+#define DHCP_TIMEOUT_MS 30000
+#define CACHED_AP_TIMEOUT_MS 3000 // Then the cached AP counts as moved
+static int reconnectAttempts = 0; // Failed attempts of this connect
+static bool linkBusy = false;     // A connect or its backoff is under way
+// While retryPending is set, retryAt is the millis() deadline of the next
+// connect attempt
+static bool retryPending = false;
+static unsigned long retryAt = 0;
+// Wait before each attempt: the cached AP right away, then full scans
+// with time for a rebooting AP to come back
+static const uint32_t reconnectDelayMs[MAX_RECONNECT_ATTEMPTS] = {0, 2000,
+                                                                  5000};
+
+// Nothing is visible while the backlight is off: leave the panel alone
+static bool screenOn() { return getPowerMode() != POWER_BLANK; }
+
+// Live values on the current screen
+static void refreshTab() {
+  if (currentState == STATE_MENU) {
+    updateStatusValues(); // Partial update to prevent flickering
+  } else if (currentState == STATE_CONNECTED) {
+    drawDashboard(); // Torrent list
+  }
+}
 
-  // Periodic Status Bar Update
-  if (millis() - lastStatusUpdate > 2000) {
+// Draw pending cursor moves now, or arm the frame job for when it is due
+static void scheduleListFrame() {
+  int wait = getTorrentListFrameWait();
+  if (wait == 0)
+    drawDashboard();
+  else if (wait > 0)
+    schedRunIn(listFrameJob, wait);
+}
+
+static void listFrameTick() {
+  if (currentState == STATE_CONNECTED)
+    scheduleListFrame();
+}
+
+// Feed battery and signal to the status bar model. drawStatusBar() only
+// repaints when one of them moved at display precision.
+static void senseTick() {
+  BatteryReading batt = getBatteryReading(); // Sampled in the background
+  statusSetBattery(batt.volts, batt.percent);
+  statusSetRssi(WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : -127);
+  if (screenOn())
     drawStatusBar();
-    lastStatusUpdate = millis();
+}
+
+static void statusBarTick() {
+  if (screenOn())
+    drawStatusBar();
+}
+
+static void tabTick() {
+  if (screenOn())
+    refreshTab();
+}
+
+// An attempt timed out: back off and scan again (checkWiFiConnection
+// starts it), or give up and start AP mode after the last one
+static void linkFailed(const char *why) {
+  reconnectAttempts++;
+  if (reconnectAttempts >= MAX_RECONNECT_ATTEMPTS) {
+    LOG_W("wifi", "%s, switching to AP mode", why);
+    startAPMode();
+    return;
   }
+  uint32_t wait = reconnectDelayMs[reconnectAttempts];
+  LOG_W("wifi", "%s, retrying in %lu ms", why, (unsigned long)wait);
+  WiFi.disconnect();
+  retryPending = true;
+  retryAt = millis() + wait;
+  schedRunIn(wifiCheckJob, wait);
+  if (currentState != STATE_CONNECTING) {
+    currentState = STATE_CONNECTING;
+    drawStatusBar();
+  }
+}
 
-  if (currentState == STATE_CONNECTING) {
+// Connect and DHCP timeouts. Also runs on every Wi-Fi event.
+static void linkTick() {
+  if (currentState == STATE_CONNECTING && !retryPending) {
     if (WiFi.status() == WL_CONNECTED) {
-      Serial.println("WiFi Connected! Requesting IP...");
+      LOG_I("wifi", "associated, waiting for IP");
+      bootMark(BOOT_WIFI);
       currentState = STATE_DHCP;
       dhcpStartTime = millis();
       drawStatusBar();
-    } else {
-      if (millis() - connectionStartTime > 20000) { // 20s Timeout
-        Serial.println("Connection Timeout! Switching to AP Mode.");
-        startAPMode();
-      }
+    } else if (wifiLinkUsingCache() &&
+               (WiFi.status() == WL_NO_SSID_AVAIL ||
+                millis() - connectionStartTime > CACHED_AP_TIMEOUT_MS)) {
+      LOG_W("wifi", "cached AP not answering, scanning");
+      wifiLinkBegin(true);
+      connectionStartTime = millis();
+    } else if (millis() - connectionStartTime > CONNECT_TIMEOUT_MS) {
+      linkFailed("connect timeout");
     }
   }
 
   if (currentState == STATE_DHCP) {
     if (WiFi.localIP()[0] != 0) {
-      Serial.println("IP Obtained!");
+      LOG_I("wifi", "IP %s", WiFi.localIP().toString().c_str());
+      bootMark(BOOT_IP);
       currentState = STATE_CONNECTED;
+      reconnectAttempts = 0;
+      linkBusy = false;
       drawStatusBar();
       drawDashboard();
-    } else {
-      if (millis() - dhcpStartTime > 30000) {
-        Serial.println("DHCP Timeout! Switching to AP Mode.");
-        startAPMode();
-      }
+    } else if (millis() - dhcpStartTime > DHCP_TIMEOUT_MS) {
+      linkFailed("DHCP timeout");
     }
   }
+}
 
-  // Check connection status periodically (unless in AP mode or OTA)
+// Reconnect check (unless in AP mode, OTA or waiting for DHCP). Armed by
+// Wi-Fi events; the period is only a backstop.
+static void wifiCheckTick() {
   if (currentState != STATE_AP_MODE && currentState != STATE_OTA &&
       currentState != STATE_DHCP) {
     checkWiFiConnection();
   }
+}
 
-  if (currentState == STATE_AP_MODE || currentState == STATE_CONNECTED ||
-      currentState == STATE_MENU || currentState == STATE_ABOUT ||
-      currentState == STATE_SETTINGS) {
-    server.handleClient();
+// Background scan/connect of the Wi-Fi setup screen. Re-arms itself while
+// busy, so it costs nothing the rest of the time.
+static void wifiScanTick() {
+  if (!isInWifiScanMode())
+    return;
+  if (updateWifiScanGui()) {
+    // Connected: leave the settings screen for the torrent list
+    currentState = STATE_CONNECTED;
+    drawStatusBar();
+    drawDashboard();
+  } else if (isWifiScanBusy()) {
+    schedRunIn(wifiScanJob, 100);
   }
+}
 
-  if (currentState == STATE_AP_MODE || currentState == STATE_CONNECTED ||
-      currentState == STATE_OTA || currentState == STATE_MENU ||
-      currentState == STATE_ABOUT || currentState == STATE_SETTINGS) {
-    ArduinoOTA.handle();
-  }
+static void onWifiChange() {
+  wifiLinkUpdate();
+  linkTick();
+  // A drop is picked up right away. While connecting, linkTick and the
+  // backoff own the retries and events must not restart them.
+  if (ssid.length() > 0 && currentState != STATE_CONNECTING &&
+      currentState != STATE_DHCP)
+    schedRunIn(wifiCheckJob, 0);
+  scanCacheUpdate(); // Scan done
+  wifiScanTick();
+}
+
+// New session stats from the transmission task
+static void onNetEvent() {
+  if (!screenOn())
+    return;
+  drawStatusBar();
+  // Daemon reachable while the list is still the cached one: fetch and
+  // reconcile now instead of on the next tab refresh
+  if (currentState == STATE_CONNECTED && transmission.isSnapshotStale() &&
+      transmission.isConnected())
+    drawDashboard();
+}
 
-  // Web Server Handle
-  server.handleClient();
+// Display and state changes requested by web handlers
+static void onWebEvent() {
+  PROFILE_SCOPE(PROF_WEB);
+  processWebActions();
+}
 
-  // Real-time updates now handled in task
-  // transmission.update();
+static void onWifiEvent(WiFiEvent_t event) { schedPost(EVENT_WIFI); }
 
-  // --- Input & GUI Handling ---
+// Back from the menu: the torrent list, AP mode, or the reconnect that is
+// under way (or starts now) if the link is down
+static void leaveMenu() {
+  bool up = WiFi.status() == WL_CONNECTED;
+  if (up || (WiFi.getMode() & WIFI_AP) || ssid.length() == 0) {
+    currentState = up ? STATE_CONNECTED : STATE_AP_MODE;
+    drawStatusBar();
+    drawDashboard();
+    return;
+  }
+  checkWiFiConnection();
+}
+
+// Buttons and joystick
+static void handleInput() {
+  profBegin(PROF_INPUT);
   readInputs();
+  profEnd(PROF_INPUT);
+
+  // Input resets the idle timer. A press that wakes a blank screen is
+  // swallowed, and the screen is brought up to date.
+  if (anyInputPressed() && powerNoteActivity()) {
+    clearInputFlags();
+    drawStatusBar();
+    refreshTab();
+  }
+
+  // Long-press VOLUME toggles the performance HUD
+  if (btnVolumeLongPressed) {
+    setPerfHudEnabled(!isPerfHudEnabled());
+  }
 
   // Alt-Speed Toggle via Select (Speaker) Button
   if (btnSelectPressed && transmission.isConnected()) {
@@ -219,12 +385,7 @@ void loop() {
         drawStatus();
       } else {
         // Exit menu to dashboard
-        if (WiFi.status() == WL_CONNECTED)
-          currentState = STATE_CONNECTED;
-        else
-          currentState = STATE_AP_MODE;
-        drawStatusBar();
-        drawDashboard();
+        leaveMenu();
       }
     } else {
       // Enter tabbed interface from AP mode or other
@@ -246,6 +407,8 @@ void loop() {
         drawDashboard();
       }
     }
+    // Coalesced cursor/scroll repaint, at most one per frame
+    scheduleListFrame();
   }
 
   // Tab navigation
@@ -265,7 +428,7 @@ void loop() {
                               btnStartPressed, btnSelectPressed);
           processed = true;
 
-          // Check if we exited WiFi scan mode (successful connection)
+          // Left WiFi scan mode (B). Connections finish in wifiScanTick.
           if (!isInWifiScanMode()) {
             // If connected, switch to connected state
             if (WiFi.status() == WL_CONNECTED) {
@@ -329,122 +492,152 @@ void loop() {
     if (btnBPressed && !isInWifiScanMode() &&
         currentState != STATE_SETTINGS) { // Allow B in Settings for Test? No, A
                                           // for Test. B for Back?
-      if (WiFi.status() == WL_CONNECTED)
-        currentState = STATE_CONNECTED;
-      else
-        currentState = STATE_AP_MODE;
-      drawStatusBar();
-      drawDashboard();
+      leaveMenu();
     }
     // Handle B in settings explicitly - BUT NOT when in WiFi scan mode!
     if (btnBPressed && !isInWifiScanMode() && currentState == STATE_SETTINGS) {
       // Go back to Dashboard
-      if (WiFi.status() == WL_CONNECTED)
-        currentState = STATE_CONNECTED;
-      else
-        currentState = STATE_AP_MODE;
-      drawStatusBar();
-      drawDashboard();
+      leaveMenu();
     }
   }
 
-  // Update Status Bar throttled
-  static unsigned long lastDrawTime = 0;
-  static unsigned long lastTabUpdate = 0;
+  // Scan or connect started from the settings screen
+  if (isWifiScanBusy())
+    schedRunIn(wifiScanJob, 100);
 
-  if (millis() - lastDrawTime > 250) {
-    drawStatusBar();
-    lastDrawTime = millis();
-  }
+  // Anything left over (a second press of the same button) next pass
+  if (isInputQueued())
+    schedPost(EVENT_INPUT);
+}
 
-  // Periodic Tab Refresh (e.g. for live Status updates)
-  if (millis() - lastTabUpdate > 5000) {
-    if (currentState == STATE_MENU) {
-      updateStatusValues(); // Partial update to prevent flickering
-    }
-    // Refresh dashboard/torrent list when connected
-    if (currentState == STATE_CONNECTED) {
-      drawDashboard();
-    }
-    lastTabUpdate = millis();
+void setupJobs() {
+  schedAddJob("stbar", 250, statusBarTick);
+  schedAddJob("sense", 2000, senseTick);
+  schedAddJob("tabs", 5000, tabTick);
+  schedAddJob("link", 250, linkTick);
+  wifiCheckJob = schedAddJob("wifi", 30000, wifiCheckTick);
+  schedAddJob("power", 250, powerUpdate);
+  listFrameJob = schedAddJob("frame", 0, listFrameTick);
+  wifiScanJob = schedAddJob("wscan", 0, wifiScanTick);
+  schedAddJob("scan", 1000, scanCacheUpdate);
+
+  schedOnEvent(EVENT_INPUT, handleInput);
+  schedOnEvent(EVENT_WIFI, onWifiChange);
+  schedOnEvent(EVENT_NET, onNetEvent);
+  schedOnEvent(EVENT_WEB, onWebEvent);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_SCAN_DONE);
+}
+
+// --- Loop ---
+void loop() {
+  profBegin(PROF_LOOP);
+
+  // Polled services
+  if (currentState == STATE_AP_MODE || currentState == STATE_CONNECTED ||
+      currentState == STATE_OTA || currentState == STATE_MENU ||
+      currentState == STATE_ABOUT || currentState == STATE_SETTINGS) {
+    ArduinoOTA.handle();
   }
+  handlePerfSerial();
+
+  // Events (input, Wi-Fi, stats, web), then due jobs
+  schedRun();
+
+  // Loop time excludes the idle wait below
+  profEnd(PROF_LOOP);
+  profFrameEnd();
 
-  delay(10);
+  // Sleep until the next job or event. OTA still needs polling; the cap
+  // is longer while the screen is off so light sleep can kick in.
+  schedIdle(powerIdleWaitMs());
 }
 
 // --- Implementation ---
 
 void startAPMode() {
-  Serial.println("Starting AP Mode");
+  LOG_I("wifi", "starting AP mode");
   WiFi.mode(WIFI_AP_STA);
-  if (apPassword.length() >= 8) {
-    WiFi.softAP(apSSID.c_str(), apPassword.c_str());
-  } else {
-    WiFi.softAP(apSSID.c_str());
-  }
+  startSoftAp();
   currentState = STATE_AP_MODE;
+  reconnectAttempts = 0;
+  linkBusy = false;
+  retryPending = false;
   drawStatusBar();
   drawDashboard();
 
-  handleScan();
+  scanCacheRequest(); // Network list for the setup page
 }
 
 void connectToWiFi() {
-  Serial.printf("Connecting to %s\n", ssid.c_str());
+  LOG_I("wifi", "connecting to %s", ssid.c_str());
   WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid.c_str(), password.c_str());
+  WiFi.setAutoReconnect(false); // Drops are handled on Wi-Fi events
+  wifiLinkBegin(false);
   currentState = STATE_CONNECTING;
   connectionStartTime = millis();
+  reconnectAttempts = 0;
+  linkBusy = true;
+  retryPending = false;
   drawStatusBar();
 }
 
 void setupAP() {
   currentState = STATE_AP_MODE;
   WiFi.mode(WIFI_AP);
-  if (apPassword.length() >= 8) {
-    WiFi.softAP(apSSID.c_str(), apPassword.c_str());
-  } else {
-    WiFi.softAP(apSSID.c_str());
-  }
+  startSoftAp();
   drawStatusBar();
 }
 
+// Runs on Wi-Fi events, when a backoff ends and as a 30 s backstop
 void checkWiFiConnection() {
-  static unsigned long lastCheck = 0;
-  static int reconnectAttempts = 0;
-  const int MAX_RECONNECT_ATTEMPTS = 3;
+  // Skip reconnect if in AP mode, WiFi scan mode, or SSID is empty
+  if (currentState == STATE_AP_MODE || isInWifiScanMode() ||
+      ssid.length() == 0) {
+    reconnectAttempts = 0; // Reset counter when in AP mode
+    linkBusy = false;
+    retryPending = false;
+    return;
+  }
 
-  if (millis() - lastCheck > 5000) {
-    lastCheck = millis();
+  if (WiFi.status() == WL_CONNECTED) {
+    if (currentState != STATE_CONNECTING) {
+      reconnectAttempts = 0; // Reset on successful connection
+      linkBusy = false;
+    }
+    return;
+  }
 
-    // Skip reconnect if in AP mode, WiFi scan mode, or SSID is empty
-    if (currentState == STATE_AP_MODE || isInWifiScanMode() ||
-        ssid.length() == 0) {
-      reconnectAttempts = 0; // Reset counter when in AP mode
+  if (currentState != STATE_CONNECTING) {
+    // Down on any other screen: retries run on the connecting screen
+    bool onList = currentState == STATE_CONNECTED;
+    currentState = STATE_CONNECTING;
+    drawStatusBar();
+    if (!onList)
+      drawDashboard();
+    if (!linkBusy) {
+      LOG_W("wifi", "link lost, reconnecting");
+      reconnectAttempts = 0;
+      linkBusy = true;
+      retryPending = false;
+      wifiLinkBegin(false); // The cached AP right away
+      connectionStartTime = millis();
       return;
     }
+  }
 
-    if (WiFi.status() != WL_CONNECTED && currentState != STATE_CONNECTING) {
-      reconnectAttempts++;
-      Serial.printf("WiFi Check: Not Connected. Attempt %d/%d\n",
-                    reconnectAttempts, MAX_RECONNECT_ATTEMPTS);
-
-      if (reconnectAttempts >= MAX_RECONNECT_ATTEMPTS) {
-        Serial.println("Max reconnect attempts reached! Switching to AP Mode.");
-        reconnectAttempts = 0;
-        startAPMode();
-        return;
-      }
-
-      WiFi.disconnect();
-      WiFi.begin(ssid.c_str(), password.c_str());
-      connectionStartTime = millis(); // Reset timer for timeout check
-      if (currentState == STATE_CONNECTED) {
-        currentState = STATE_CONNECTING;
-        drawStatusBar();
-      }
-    } else if (WiFi.status() == WL_CONNECTED) {
-      reconnectAttempts = 0; // Reset on successful connection
-    }
+  if (!retryPending)
+    return; // linkTick times the attempt
+  long left = (long)(retryAt - millis());
+  if (left > 0) {
+    schedRunIn(wifiCheckJob, left); // An event came in early
+    return;
   }
+  retryPending = false;
+  LOG_I("wifi", "attempt %d/%d, scanning", reconnectAttempts + 1,
+        MAX_RECONNECT_ATTEMPTS);
+  wifiLinkBegin(true);
+  connectionStartTime = millis();
 }
@@ -0,0 +1,267 @@
+#include "metrics.h"
+#include "battery_utils.h"
+#include "logger.h"
+#include "profiler.h"
+#include "status_model.h"
+#include "transmission_client.h"
+#include "web_server.h"
+#include <stdarg.h>
+
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+// Histogram bucket bounds (ms); exposed as seconds
+static const uint16_t rpcBucketsMs[] = {25,  50,   100,  250,
+                                        500, 1000, 2500, 5000};
+#define RPC_BUCKETS (sizeof(rpcBucketsMs) / sizeof(rpcBucketsMs[0]))
+
+static const char *const rpcKindNames[RPC_KIND_COUNT] = {"stats", "torrents",
+                                                        "action", "proxy"};
+
+struct RpcHistogram {
+  uint32_t buckets[RPC_BUCKETS]; // Non-cumulative; summed when rendered
+  uint32_t count;
+  uint32_t failures;
+  uint64_t sumMs;
+};
+
+static RpcHistogram rpcHist[RPC_KIND_COUNT];
+static portMUX_TYPE rpcMux = portMUX_INITIALIZER_UNLOCKED;
+
+struct TorrentState {
+  const char *name;
+  uint16_t flag;
+};
+
+static const TorrentState torrentStates[] = {
+    {"downloading", TORRENT_FLAG_DOWNLOADING},
+    {"queued_down", TORRENT_FLAG_QUEUED_DOWN},
+    {"seeding", TORRENT_FLAG_SEEDING},
+    {"queued_seed", TORRENT_FLAG_QUEUED_SEED},
+    {"paused", TORRENT_FLAG_PAUSED},
+    {"complete", TORRENT_FLAG_COMPLETE},
+    {"incomplete", TORRENT_FLAG_INCOMPLETE},
+    {"active", TORRENT_FLAG_ACTIVE},
+    {"checking", TORRENT_FLAG_CHECKING}};
+#define TORRENT_STATES (sizeof(torrentStates) / sizeof(torrentStates[0]))
+
+// Sized for every series at its widest value (about 8.1 KB today), with
+// room to spare. The counts follow the render functions below; adding a
+// series means adding it here.
+#define METRICS_HEADERS 21 // HELP/TYPE pairs
+#define METRICS_SAMPLES                                                      \
+  (16 + TORRENT_STATES + RPC_KIND_COUNT * (RPC_BUCKETS + 4) +                \
+   3 * PROF_SECTION_COUNT)
+#define METRICS_HEADER_MAX 144 // Longest pair is 133 bytes
+#define METRICS_SAMPLE_MAX 96  // Longest sample line is 80 bytes
+#define METRICS_BUF_SIZE                                                     \
+  (METRICS_HEADERS * METRICS_HEADER_MAX + METRICS_SAMPLES * METRICS_SAMPLE_MAX)
+
+// One scrape at a time: the response streams straight out of this buffer
+// until the connection closes.
+static char metricsBuf[METRICS_BUF_SIZE];
+static volatile bool metricsBusy = false;
+
+struct MetricsWriter {
+  char *buf;
+  size_t len;
+  bool overflow;
+};
+
+static void appendf(MetricsWriter &w, const char *fmt, ...) {
+  if (w.overflow)
+    return;
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(w.buf + w.len, METRICS_BUF_SIZE - w.len, fmt, args);
+  va_end(args);
+  if (n < 0 || w.len + n >= METRICS_BUF_SIZE) {
+    w.overflow = true;
+    return;
+  }
+  w.len += n;
+}
+
+static void header(MetricsWriter &w, const char *name, const char *type,
+                   const char *help) {
+  appendf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void gauge(MetricsWriter &w, const char *name, const char *help,
+                  double value) {
+  header(w, name, "gauge", help);
+  appendf(w, "%s %.6g\n", name, value);
+}
+
+void metricsObserveRpc(RpcKind kind, uint32_t ms, bool ok) {
+  if (kind >= RPC_KIND_COUNT)
+    return;
+  size_t b = 0;
+  while (b < RPC_BUCKETS && ms > rpcBucketsMs[b])
+    b++;
+  portENTER_CRITICAL(&rpcMux);
+  RpcHistogram &h = rpcHist[kind];
+  if (b < RPC_BUCKETS)
+    h.buckets[b]++;
+  h.count++;
+  h.sumMs += ms;
+  if (!ok)
+    h.failures++;
+  portEXIT_CRITICAL(&rpcMux);
+}
+
+static void renderTransmission(MetricsWriter &w) {
+  StatusModel m;
+  statusRead(m);
+  gauge(w, "transmission_up", "1 if the last daemon poll succeeded",
+        m.transConnected ? 1 : 0);
+  gauge(w, "transmission_download_bytes_per_second",
+        "Session download speed", m.dlSpeed);
+  gauge(w, "transmission_upload_bytes_per_second", "Session upload speed",
+        m.ulSpeed);
+  gauge(w, "transmission_alt_speed_enabled", "1 while turtle mode is on",
+        m.altSpeed ? 1 : 0);
+  gauge(w, "transmission_free_space_bytes",
+        "Free space in the download directory",
+        (double)transmission.getFreeSpace());
+
+  uint32_t counts[TORRENT_STATES] = {0};
+  int total;
+  transmission.lockTorrents();
+  total = transmission.getTorrentCount();
+  TorrentInfo *list = transmission.getTorrents();
+  for (int i = 0; i < total; i++) {
+    for (size_t s = 0; s < TORRENT_STATES; s++) {
+      if (list[i].flags & torrentStates[s].flag)
+        counts[s]++;
+    }
+  }
+  transmission.unlockTorrents();
+
+  header(w, "transmission_torrents", "gauge",
+         "Torrents in the snapshot by filter bucket");
+  appendf(w, "transmission_torrents{state=\"all\"} %d\n", total);
+  for (size_t s = 0; s < TORRENT_STATES; s++) {
+    appendf(w, "transmission_torrents{state=\"%s\"} %lu\n",
+            torrentStates[s].name, (unsigned long)counts[s]);
+  }
+
+  unsigned long snap = transmission.getSnapshotTime();
+  if (snap != 0) {
+    gauge(w, "transmission_snapshot_age_seconds",
+          "Time since the torrent list was fetched",
+          (millis() - snap) / 1000.0);
+  }
+}
+
+static void renderRpc(MetricsWriter &w) {
+  RpcHistogram hist[RPC_KIND_COUNT];
+  portENTER_CRITICAL(&rpcMux);
+  memcpy(hist, rpcHist, sizeof(hist));
+  portEXIT_CRITICAL(&rpcMux);
+
+  header(w, "transmission_rpc_duration_seconds", "histogram",
+         "Round trip of RPC requests to the daemon");
+  for (int k = 0; k < RPC_KIND_COUNT; k++) {
+    const RpcHistogram &h = hist[k];
+    uint32_t cumulative = 0;
+    for (size_t b = 0; b < RPC_BUCKETS; b++) {
+      cumulative += h.buckets[b];
+      appendf(w,
+              "transmission_rpc_duration_seconds_bucket"
+              "{kind=\"%s\",le=\"%g\"} %lu\n",
+              rpcKindNames[k], rpcBucketsMs[b] / 1000.0,
+              (unsigned long)cumulative);
+    }
+    appendf(w,
+            "transmission_rpc_duration_seconds_bucket"
+            "{kind=\"%s\",le=\"+Inf\"} %lu\n",
+            rpcKindNames[k], (unsigned long)h.count);
+    appendf(w, "transmission_rpc_duration_seconds_sum{kind=\"%s\"} %.3f\n",
+            rpcKindNames[k], h.sumMs / 1000.0);
+    appendf(w, "transmission_rpc_duration_seconds_count{kind=\"%s\"} %lu\n",
+            rpcKindNames[k], (unsigned long)h.count);
+  }
+
+  header(w, "transmission_rpc_failures_total", "counter",
+         "RPC requests that failed or returned non-200");
+  for (int k = 0; k < RPC_KIND_COUNT; k++) {
+    appendf(w, "transmission_rpc_failures_total{kind=\"%s\"} %lu\n",
+            rpcKindNames[k], (unsigned long)hist[k].failures);
+  }
+}
+
+static void renderDevice(MetricsWriter &w) {
+  StatusModel m;
+  statusRead(m);
+  gauge(w, "odroid_wifi_rssi_dbm", "Wi-Fi signal strength", m.rssi);
+
+  BatteryReading batt = getBatteryReading();
+  if (batt.valid) {
+    gauge(w, "odroid_battery_volts", "Filtered battery voltage", batt.volts);
+    gauge(w, "odroid_battery_percent", "Battery charge estimate",
+          batt.percent);
+  }
+
+  gauge(w, "odroid_heap_free_bytes", "Free heap", ESP.getFreeHeap());
+  gauge(w, "odroid_heap_min_free_bytes", "Lowest free heap since boot",
+        ESP.getMinFreeHeap());
+  gauge(w, "odroid_heap_largest_block_bytes", "Largest allocatable block",
+        ESP.getMaxAllocHeap());
+  gauge(w, "odroid_uptime_seconds", "Time since boot", millis() / 1000.0);
+}
+
+static void renderLoop(MetricsWriter &w) {
+  gauge(w, "odroid_fps", "Frames drawn per second", getPerfFps());
+  gauge(w, "odroid_loops_per_second", "Main loop iterations per second",
+        getPerfLoopsPerSec());
+
+  header(w, "odroid_section_avg_seconds", "gauge",
+         "Average time per profiled section over the last window");
+  for (int s = 0; s < PROF_SECTION_COUNT; s++) {
+    ProfSection sec = (ProfSection)s;
+    appendf(w, "odroid_section_avg_seconds{section=\"%s\"} %.6f\n",
+            getPerfSectionName(sec), getPerfSection(sec).avgMs / 1000.0);
+  }
+  header(w, "odroid_section_max_seconds", "gauge",
+         "Longest run per profiled section over the last window");
+  for (int s = 0; s < PROF_SECTION_COUNT; s++) {
+    ProfSection sec = (ProfSection)s;
+    appendf(w, "odroid_section_max_seconds{section=\"%s\"} %.6f\n",
+            getPerfSectionName(sec), getPerfSection(sec).maxMs / 1000.0);
+  }
+  header(w, "odroid_section_runs", "gauge",
+         "Runs per profiled section over the last window");
+  for (int s = 0; s < PROF_SECTION_COUNT; s++) {
+    ProfSection sec = (ProfSection)s;
+    appendf(w, "odroid_section_runs{section=\"%s\"} %lu\n",
+            getPerfSectionName(sec),
+            (unsigned long)getPerfSection(sec).count);
+  }
+}
+
+static void handleMetrics(AsyncWebServerRequest *request) {
+  if (metricsBusy) {
+    request->send(503, "text/plain", "Scrape in progress");
+    return;
+  }
+  metricsBusy = true;
+  request->onDisconnect([]() { metricsBusy = false; });
+
+  MetricsWriter w = {metricsBuf, 0, false};
+  renderTransmission(w);
+  renderRpc(w);
+  renderDevice(w);
+  renderLoop(w);
+  if (w.overflow) {
+    LOG_E("metrics", "buffer too small");
+    request->send(500, "text/plain", "Metrics buffer too small");
+    return;
+  }
+  // The _P variant sends straight from the buffer instead of copying it
+  request->send(request->beginResponse_P(200, METRICS_CONTENT_TYPE,
+                                         (const uint8_t *)metricsBuf, w.len));
+}
+
+void setupMetrics(AsyncWebServer &server) {
+  server.on("/metrics", HTTP_GET, webTimed("/metrics", handleMetrics));
+}
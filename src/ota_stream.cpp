@@ -0,0 +1,351 @@
+#include "ota_stream.h"
+#include "logger.h"
+#include <Update.h>
+#include <esp32/rom/crc.h>
+#include <esp32/rom/miniz.h>
+#include <mbedtls/sha256.h>
+
+#define GZIP_ID1 0x1f
+#define GZIP_ID2 0x8b
+#define GZIP_DEFLATE 8
+#define GZIP_HEADER_LEN 10
+#define GZIP_TRAILER_LEN 8 // CRC-32 and size of the inflated data
+
+// Gzip header flags (RFC 1952)
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+enum OtaFormat : uint8_t { OTA_DETECT, OTA_RAW, OTA_GZIP };
+
+enum GzState : uint8_t {
+  GZ_HEADER,
+  GZ_EXTRA_LEN,
+  GZ_EXTRA,
+  GZ_NAME,
+  GZ_COMMENT,
+  GZ_HCRC,
+  GZ_BODY,
+  GZ_TRAILER,
+  GZ_DONE
+};
+
+static const char *const formatNames[] = {"none", "bin", "gzip"};
+
+static bool active = false;
+static OtaFormat format = OTA_DETECT;
+static char error[64] = "";
+
+static size_t expectedSize = 0; // Inflated image, 0 = unknown
+static size_t uploadTotal = 0;
+static bool hasHash = false;
+static uint8_t expectedHash[32];
+static mbedtls_sha256_context sha;
+
+static size_t received = 0; // Bytes as uploaded
+static size_t written = 0;  // Image bytes handed to Update
+static unsigned long startMs = 0;
+static unsigned long lastMs = 0; // Duration of the last update
+
+// Gzip stream state
+static GzState gzState = GZ_HEADER;
+static uint8_t gzBuf[GZIP_HEADER_LEN]; // Header, later the trailer
+static size_t gzFill = 0;
+static uint8_t gzFlags = 0;
+static size_t gzSkip = 0; // Bytes left of FEXTRA / FHCRC
+static uint32_t gzCrc = 0;
+static tinfl_decompressor *inflater = nullptr;
+static uint8_t *dict = nullptr; // Inflate window, also the output buffer
+static size_t dictOfs = 0;
+
+static bool fail(const char *msg) {
+  if (error[0] == '\0')
+    strlcpy(error, msg, sizeof(error));
+  LOG_E("ota", "%s", msg);
+  return false;
+}
+
+static int hexNibble(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+static bool parseHash(const char *hex) {
+  if (strlen(hex) != 2 * sizeof(expectedHash))
+    return false;
+  for (size_t i = 0; i < sizeof(expectedHash); i++) {
+    int hi = hexNibble(hex[2 * i]);
+    int lo = hexNibble(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0)
+      return false;
+    expectedHash[i] = (hi << 4) | lo;
+  }
+  return true;
+}
+
+static void freeInflater() {
+  free(inflater);
+  free(dict);
+  inflater = nullptr;
+  dict = nullptr;
+}
+
+static void finish() {
+  mbedtls_sha256_free(&sha);
+  freeInflater();
+  lastMs = millis() - startMs;
+  active = false;
+}
+
+// Hash and flash a piece of the image
+static bool emit(const uint8_t *data, size_t len) {
+  if (expectedSize > 0 && written + len > expectedSize)
+    return fail("Image larger than the manifest says");
+  mbedtls_sha256_update(&sha, data, len);
+  if (format == OTA_GZIP)
+    gzCrc = crc32_le(gzCrc, data, len);
+  // Update buffers a flash sector itself; it only reads from data
+  if (Update.write(const_cast<uint8_t *>(data), len) != len)
+    return fail(Update.errorString());
+  written += len;
+  return true;
+}
+
+// Consume header bytes; returns how many were used
+static size_t gzHeader(const uint8_t *data, size_t len) {
+  size_t used = 0;
+  while (used < len && gzState < GZ_BODY) {
+    uint8_t b = data[used++];
+    switch (gzState) {
+    case GZ_HEADER:
+      gzBuf[gzFill++] = b;
+      if (gzFill < GZIP_HEADER_LEN)
+        break;
+      if (gzBuf[2] != GZIP_DEFLATE) {
+        fail("Unsupported gzip method");
+        return used;
+      }
+      gzFlags = gzBuf[3];
+      gzFill = 0;
+      gzState = GZ_EXTRA_LEN;
+      if (!(gzFlags & GZIP_FEXTRA))
+        gzState = GZ_NAME;
+      break;
+    case GZ_EXTRA_LEN:
+      gzSkip |= (size_t)b << (8 * gzFill++);
+      if (gzFill == 2)
+        gzState = gzSkip > 0 ? GZ_EXTRA : GZ_NAME;
+      break;
+    case GZ_EXTRA:
+      if (--gzSkip == 0)
+        gzState = GZ_NAME;
+      break;
+    case GZ_NAME:
+      if (!(gzFlags & GZIP_FNAME) || b == 0)
+        gzState = GZ_COMMENT;
+      if (!(gzFlags & GZIP_FNAME))
+        used--; // Not ours, look at it again
+      break;
+    case GZ_COMMENT:
+      if (!(gzFlags & GZIP_FCOMMENT) || b == 0)
+        gzState = GZ_HCRC;
+      if (!(gzFlags & GZIP_FCOMMENT))
+        used--;
+      gzSkip = 2;
+      break;
+    case GZ_HCRC:
+      if (!(gzFlags & GZIP_FHCRC)) {
+        used--;
+        gzState = GZ_BODY;
+      } else if (--gzSkip == 0) {
+        gzState = GZ_BODY;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return used;
+}
+
+static bool gzTrailer(const uint8_t *data, size_t len) {
+  while (len > 0 && gzFill < GZIP_TRAILER_LEN) {
+    gzBuf[gzFill++] = *data++;
+    len--;
+  }
+  if (len > 0)
+    return fail("Data after the gzip stream");
+  if (gzFill < GZIP_TRAILER_LEN)
+    return true;
+
+  uint32_t crc = gzBuf[0] | gzBuf[1] << 8 | gzBuf[2] << 16 |
+                 (uint32_t)gzBuf[3] << 24;
+  uint32_t size = gzBuf[4] | gzBuf[5] << 8 | gzBuf[6] << 16 |
+                  (uint32_t)gzBuf[7] << 24;
+  if (crc != gzCrc || size != (uint32_t)written)
+    return fail("Gzip checksum mismatch");
+  gzState = GZ_DONE;
+  return true;
+}
+
+static bool gzWrite(const uint8_t *data, size_t len) {
+  size_t used = gzHeader(data, len);
+  if (error[0] != '\0')
+    return false;
+  data += used;
+  len -= used;
+
+  while (gzState == GZ_BODY) {
+    size_t inBytes = len;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - dictOfs;
+    tinfl_status status =
+        tinfl_decompress(inflater, data, &inBytes, dict, dict + dictOfs,
+                         &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+    data += inBytes;
+    len -= inBytes;
+    if (outBytes > 0 && !emit(dict + dictOfs, outBytes))
+      return false;
+    dictOfs = (dictOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+    if (status == TINFL_STATUS_DONE) {
+      gzState = GZ_TRAILER;
+      gzFill = 0;
+    } else if (status < 0) {
+      return fail("Corrupt gzip stream");
+    } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+      return true; // All input taken; the window waits for the next chunk
+    }
+  }
+  if (gzState == GZ_TRAILER)
+    return gzTrailer(data, len);
+  return len == 0 || fail("Data after the gzip stream");
+}
+
+bool otaStreamBegin(size_t imageSize, const char *sha256Hex,
+                    size_t uploadSize) {
+  if (active)
+    otaStreamAbort();
+
+  error[0] = '\0';
+  format = OTA_DETECT;
+  expectedSize = imageSize;
+  uploadTotal = uploadSize;
+  received = 0;
+  written = 0;
+  startMs = millis();
+  hasHash = sha256Hex != nullptr && sha256Hex[0] != '\0';
+  if (hasHash && !parseHash(sha256Hex))
+    return fail("Bad sha256 in manifest");
+
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  active = true;
+
+  if (!Update.begin(imageSize > 0 ? imageSize : UPDATE_SIZE_UNKNOWN)) {
+    fail(Update.errorString());
+    finish();
+    return false;
+  }
+  return true;
+}
+
+bool otaStreamWrite(const uint8_t *data, size_t len) {
+  if (!active || error[0] != '\0')
+    return false;
+  if (len == 0)
+    return true;
+
+  if (format == OTA_DETECT) {
+    // A gzip member starts with 1f 8b, a firmware image with 0xE9
+    if (data[0] == GZIP_ID1 && (len < 2 || data[1] == GZIP_ID2)) {
+      inflater = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+      dict = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+      if (inflater == nullptr || dict == nullptr)
+        return fail("Not enough memory to inflate");
+      tinfl_init(inflater);
+      dictOfs = 0;
+      gzState = GZ_HEADER;
+      gzFill = 0;
+      gzSkip = 0;
+      gzCrc = 0;
+      format = OTA_GZIP;
+    } else {
+      format = OTA_RAW;
+    }
+    LOG_I("ota", "%s image", formatNames[format]);
+  }
+
+  received += len;
+  if (format == OTA_GZIP)
+    return gzWrite(data, len);
+  return emit(data, len);
+}
+
+bool otaStreamEnd() {
+  if (!active)
+    return false;
+  bool ok = error[0] == '\0';
+
+  if (ok && format == OTA_GZIP && gzState != GZ_DONE)
+    ok = fail("Gzip stream cut short");
+  if (ok && expectedSize > 0 && written != expectedSize)
+    ok = fail("Image size does not match the manifest");
+  if (ok && hasHash) {
+    uint8_t hash[32];
+    mbedtls_sha256_finish(&sha, hash);
+    if (memcmp(hash, expectedHash, sizeof(hash)) != 0)
+      ok = fail("SHA-256 does not match the manifest");
+  }
+  // Until end() the old partition stays the boot one
+  if (ok && !Update.end(true))
+    ok = fail(Update.errorString());
+  if (!ok)
+    Update.abort();
+
+  finish();
+  if (ok) {
+    LOG_I("ota", "%u bytes (%u uploaded) in %lu ms", (unsigned)written,
+          (unsigned)received, (unsigned long)lastMs);
+  }
+  return ok;
+}
+
+void otaStreamAbort() {
+  if (!active)
+    return;
+  fail("Upload aborted");
+  Update.abort();
+  finish();
+}
+
+bool otaStreamActive() { return active; }
+
+int otaStreamProgress() {
+  size_t done = written;
+  size_t total = expectedSize;
+  if (total == 0) {
+    done = received;
+    total = uploadTotal;
+  }
+  if (total == 0)
+    return 0;
+  int p = (int)((uint64_t)done * 100 / total);
+  return p > 100 ? 100 : p;
+}
+
+const char *otaStreamError() { return error; }
+
+void fillOtaJson(JsonObject obj) {
+  obj["active"] = active;
+  obj["format"] = formatNames[format];
+  obj["received"] = received;
+  obj["written"] = written;
+  obj["verified"] = hasHash;
+  obj["ms"] = active ? millis() - startMs : lastMs;
+  obj["error"] = error;
+}
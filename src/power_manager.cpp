@@ -0,0 +1,200 @@
+#include "power_manager.h"
+#include "config_utils.h"
+#include "display_utils.h"
+#include "input_handler.h"
+#include "logger.h"
+#include "transmission_client.h"
+#include <WiFi.h>
+#include <esp_pm.h>
+#include <esp_wifi.h>
+
+#define DIM_DUTY_DIVISOR 4 // Dim level is a quarter of the set brightness
+#define DIM_DUTY_MIN 10
+#define POLL_ACTIVE_MS 2000  // Transmission session stats
+#define POLL_BLANK_MS 10000  // Nobody is looking: poll less often
+#define INPUT_ACTIVE_MS 10   // Joystick sampling period
+#define INPUT_BLANK_MS 50    // Still fast enough to wake on a flick
+#define BATTERY_MAH 1200     // ODROID-GO stock cell
+
+// Rough current figures (mA at the battery) for the estimate
+#define MA_CPU_240 45
+#define MA_CPU_160 32
+#define MA_CPU_80 22
+#define MA_LIGHT_SLEEP 6 // Average with auto light sleep between ticks
+#define MA_WIFI_AP 100   // SoftAP cannot sleep
+#define MA_WIFI_MIN_MODEM 25
+#define MA_WIFI_MAX_MODEM 10
+#define MA_BACKLIGHT_FULL 60
+#define MA_PANEL 6
+
+static const char *modeNames[POWER_MODE_COUNT] = {"active", "dim", "blank"};
+
+static PowerMode mode = POWER_ACTIVE;
+static unsigned long lastActivity = 0;
+static bool autoLightSleep = false;
+static int backlightDuty = 255;
+static wifi_ps_type_t wifiPs = WIFI_PS_MIN_MODEM;
+
+// Energy accounting per mode
+static unsigned long lastAccountMs = 0;
+static uint32_t modeMs[POWER_MODE_COUNT];
+static float modeMaMs[POWER_MODE_COUNT]; // mA x ms
+
+float getEstimatedCurrentMa() {
+  float ma = MA_PANEL + MA_BACKLIGHT_FULL * backlightDuty / 255.0f;
+
+  if (autoLightSleep) {
+    ma += (mode == POWER_ACTIVE) ? MA_CPU_240 : MA_LIGHT_SLEEP;
+  } else {
+    uint32_t mhz = getCpuFrequencyMhz();
+    ma += (mhz >= 240) ? MA_CPU_240 : (mhz >= 160) ? MA_CPU_160 : MA_CPU_80;
+  }
+
+  wifi_mode_t wm = WiFi.getMode();
+  if (wm == WIFI_AP || wm == WIFI_AP_STA) {
+    ma += MA_WIFI_AP;
+  } else if (wm == WIFI_STA) {
+    ma += (wifiPs == WIFI_PS_MAX_MODEM) ? MA_WIFI_MAX_MODEM
+                                        : MA_WIFI_MIN_MODEM;
+  }
+  return ma;
+}
+
+static void account() {
+  unsigned long now = millis();
+  uint32_t dt = now - lastAccountMs;
+  lastAccountMs = now;
+  modeMs[mode] += dt;
+  modeMaMs[mode] += getEstimatedCurrentMa() * dt;
+}
+
+static void setWifiPs(wifi_ps_type_t ps) {
+  if (ps == wifiPs)
+    return;
+  wifiPs = ps;
+  if (WiFi.getMode() == WIFI_STA)
+    esp_wifi_set_ps(ps);
+}
+
+static void enterMode(PowerMode next) {
+  if (next == mode)
+    return;
+  account(); // Close the interval at the old mode's draw
+  mode = next;
+
+  switch (mode) {
+  case POWER_ACTIVE:
+    backlightDuty = brightness;
+    setWifiPs(WIFI_PS_MIN_MODEM);
+    if (!autoLightSleep)
+      setCpuFrequencyMhz(240);
+    transmission.setUpdateInterval(POLL_ACTIVE_MS);
+    setInputSamplePeriod(INPUT_ACTIVE_MS);
+    break;
+  case POWER_DIM:
+    backlightDuty = max(DIM_DUTY_MIN, brightness / DIM_DUTY_DIVISOR);
+    if (powerSave) {
+      setWifiPs(WIFI_PS_MAX_MODEM);
+      if (!autoLightSleep)
+        setCpuFrequencyMhz(160);
+    }
+    break;
+  case POWER_BLANK:
+    backlightDuty = 0;
+    if (powerSave) {
+      setWifiPs(WIFI_PS_MAX_MODEM);
+      if (!autoLightSleep)
+        setCpuFrequencyMhz(80);
+      transmission.setUpdateInterval(POLL_BLANK_MS);
+      setInputSamplePeriod(INPUT_BLANK_MS);
+    }
+    break;
+  default:
+    break;
+  }
+  setBrightness(backlightDuty);
+  LOG_I("power", "%s (~%.0f mA)", modeNames[mode], getEstimatedCurrentMa());
+}
+
+// Automatic light sleep needs an SDK built with CONFIG_PM_ENABLE. Without
+// it the CPU clock is stepped down per mode instead.
+static void configureSleep() {
+  esp_pm_config_esp32_t cfg = {240, 80, powerSave};
+  bool ok = (esp_pm_configure(&cfg) == ESP_OK);
+  autoLightSleep = ok && powerSave;
+  // No GPIO wakeup: it would turn the buttons' edge interrupts into level
+  // ones. The input sampling timer wakes the chip often enough.
+}
+
+void setupPower() {
+  lastActivity = millis();
+  lastAccountMs = millis();
+  backlightDuty = brightness;
+  configureSleep();
+  LOG_I("power", "light sleep %s",
+        autoLightSleep ? "enabled" : "unavailable, scaling CPU");
+}
+
+void powerUpdate() {
+  unsigned long idle = millis() - lastActivity;
+  PowerMode want = POWER_ACTIVE;
+  if (blankTimeout > 0 && idle >= blankTimeout * 1000UL)
+    want = POWER_BLANK;
+  else if (dimTimeout > 0 && idle >= dimTimeout * 1000UL)
+    want = POWER_DIM;
+  enterMode(want);
+
+  // Modem sleep only applies once the station is up
+  static bool wasSta = false;
+  bool isSta = (WiFi.getMode() == WIFI_STA && WiFi.status() == WL_CONNECTED);
+  if (isSta && !wasSta)
+    esp_wifi_set_ps(wifiPs);
+  wasSta = isSta;
+
+  if (millis() - lastAccountMs > 1000)
+    account();
+}
+
+bool powerNoteActivity() {
+  lastActivity = millis();
+  bool wasBlank = (mode == POWER_BLANK);
+  enterMode(POWER_ACTIVE);
+  return wasBlank;
+}
+
+void applyPowerSettings() {
+  configureSleep();
+  lastActivity = millis();
+  if (mode == POWER_ACTIVE) {
+    backlightDuty = brightness;
+    setBrightness(brightness);
+  }
+  enterMode(POWER_ACTIVE);
+}
+
+PowerMode getPowerMode() { return mode; }
+
+uint32_t powerIdleWaitMs() { return mode == POWER_BLANK ? 50 : 10; }
+
+void fillPowerJson(JsonObject obj) {
+  account();
+  obj["mode"] = modeNames[mode];
+  obj["ma"] = getEstimatedCurrentMa();
+  obj["light_sleep"] = autoLightSleep;
+  obj["cpu_mhz"] = getCpuFrequencyMhz();
+
+  uint32_t totalMs = 0;
+  float totalMaMs = 0;
+  JsonArray arr = obj.createNestedArray("modes");
+  for (int i = 0; i < POWER_MODE_COUNT; i++) {
+    JsonObject o = arr.createNestedObject();
+    o["name"] = modeNames[i];
+    o["s"] = modeMs[i] / 1000;
+    o["avg_ma"] = modeMs[i] ? modeMaMs[i] / modeMs[i] : 0;
+    totalMs += modeMs[i];
+    totalMaMs += modeMaMs[i];
+  }
+  float avgMa = totalMs ? totalMaMs / totalMs : getEstimatedCurrentMa();
+  obj["avg_ma"] = avgMa;
+  obj["est_hours"] = BATTERY_MAH / avgMa;
+}
@@ -0,0 +1,360 @@
+#include "profiler.h"
+#include "display_utils.h"
+#include "logger.h"
+#include "scheduler.h"
+
+#define PROF_WINDOW_MS 1000
+#define HUD_REFRESH_MS 250 // Redraw after frames that may have covered it
+#define HUD_Y 220
+
+static const char *sectionNames[PROF_SECTION_COUNT] = {
+    "loop", "input", "web",  "fetch", "stbar", "dash",
+    "setng", "stat", "menu", "about", "wifi"};
+
+struct SectionStats {
+  uint32_t count;
+  uint32_t totalUs;
+  uint32_t minUs;
+  uint32_t maxUs;
+};
+
+// Current window and the last completed one (what reports show)
+static SectionStats window[PROF_SECTION_COUNT];
+static SectionStats published[PROF_SECTION_COUNT];
+static uint32_t startUs[PROF_SECTION_COUNT];
+
+// Display traffic: current frame, current window, last window
+static uint32_t frameSpiBytes = 0;
+static uint32_t frameDrawCalls = 0;
+static uint32_t winFrames = 0;
+static uint32_t winDrawnFrames = 0;
+static uint32_t winSpiSum = 0, winSpiMax = 0;
+static uint32_t winCallsSum = 0, winCallsMax = 0;
+static unsigned long windowStart = 0;
+
+static float pubFps = 0;
+static float pubLoops = 0;
+static uint32_t pubSpiAvg = 0, pubSpiMax = 0;
+static uint32_t pubCallsAvg = 0, pubCallsMax = 0;
+
+static const char *bootStageNames[BOOT_STAGE_COUNT] = {
+    "setup", "config", "cache", "first_list", "wifi", "ip", "rpc", "live_list"};
+static uint32_t bootMs[BOOT_STAGE_COUNT]; // 0 = not reached
+
+static bool hudEnabled = false;
+static bool counting = true; // Off while the HUD draws itself
+static unsigned long lastHudDraw = 0;
+
+static void resetWindow() {
+  for (int i = 0; i < PROF_SECTION_COUNT; i++) {
+    window[i].count = 0;
+    window[i].totalUs = 0;
+    window[i].minUs = UINT32_MAX;
+    window[i].maxUs = 0;
+  }
+  winFrames = 0;
+  winDrawnFrames = 0;
+  winSpiSum = winSpiMax = 0;
+  winCallsSum = winCallsMax = 0;
+}
+
+void profBegin(ProfSection s) { startUs[s] = micros(); }
+
+void profEnd(ProfSection s) {
+  uint32_t us = micros() - startUs[s];
+  SectionStats &st = window[s];
+  st.count++;
+  st.totalUs += us;
+  if (us < st.minUs)
+    st.minUs = us;
+  if (us > st.maxUs)
+    st.maxUs = us;
+}
+
+void profAddDrawCall() {
+  if (counting)
+    frameDrawCalls++;
+}
+
+void profAddSpiBytes(uint32_t bytes) {
+  if (counting)
+    frameSpiBytes += bytes;
+}
+
+static float avgMs(const SectionStats &st) {
+  return st.count ? st.totalUs / 1000.0f / st.count : 0;
+}
+
+static float minMs(const SectionStats &st) {
+  return st.count ? st.minUs / 1000.0f : 0;
+}
+
+static float maxMs(const SectionStats &st) { return st.maxUs / 1000.0f; }
+
+static void publishWindow(unsigned long elapsed) {
+  for (int i = 0; i < PROF_SECTION_COUNT; i++) {
+    published[i] = window[i];
+  }
+  float secs = elapsed / 1000.0f;
+  pubFps = winDrawnFrames / secs;
+  pubLoops = winFrames / secs;
+  pubSpiAvg = winDrawnFrames ? winSpiSum / winDrawnFrames : 0;
+  pubSpiMax = winSpiMax;
+  pubCallsAvg = winDrawnFrames ? winCallsSum / winDrawnFrames : 0;
+  pubCallsMax = winCallsMax;
+}
+
+// The two sections (other than loop) with the highest max this window
+static void worstSections(int &first, int &second) {
+  first = second = -1;
+  for (int i = PROF_LOOP + 1; i < PROF_SECTION_COUNT; i++) {
+    if (published[i].count == 0)
+      continue;
+    if (first < 0 || published[i].maxUs > published[first].maxUs) {
+      second = first;
+      first = i;
+    } else if (second < 0 || published[i].maxUs > published[second].maxUs) {
+      second = i;
+    }
+  }
+}
+
+static void drawPerfHud() {
+  counting = false;
+  char line[54];
+
+  tft.fillRect(0, HUD_Y, 320, 20, TFT_BLACK);
+  tft.setTextSize(1);
+  tft.setTextColor(TFT_YELLOW, TFT_BLACK);
+  const SectionStats &lp = published[PROF_LOOP];
+  snprintf(line, sizeof(line), "%2dfps loop %.1f/%.1f/%.1fms heap %uk",
+           (int)(pubFps + 0.5f), minMs(lp), avgMs(lp), maxMs(lp),
+           ESP.getFreeHeap() / 1024);
+  tft.setCursor(2, HUD_Y + 1);
+  tft.print(line);
+
+  int first, second;
+  worstSections(first, second);
+  int n = 0;
+  for (int s : {first, second}) {
+    if (s < 0)
+      continue;
+    n += snprintf(line + n, sizeof(line) - n, "%s %.1f/%.1f ",
+                  sectionNames[s], avgMs(published[s]),
+                  maxMs(published[s]));
+  }
+  snprintf(line + n, sizeof(line) - n, "spi %luk dc %lu",
+           (unsigned long)(pubSpiAvg / 1024), (unsigned long)pubCallsAvg);
+  tft.setTextColor(UI_CYAN, TFT_BLACK);
+  tft.setCursor(2, HUD_Y + 11);
+  tft.print(line);
+
+  lastHudDraw = millis();
+  counting = true;
+}
+
+void profFrameEnd() {
+  bool drew = frameDrawCalls > 0 || frameSpiBytes > 0;
+  winFrames++;
+  if (drew) {
+    winDrawnFrames++;
+    winSpiSum += frameSpiBytes;
+    winCallsSum += frameDrawCalls;
+    if (frameSpiBytes > winSpiMax)
+      winSpiMax = frameSpiBytes;
+    if (frameDrawCalls > winCallsMax)
+      winCallsMax = frameDrawCalls;
+  }
+  frameSpiBytes = 0;
+  frameDrawCalls = 0;
+
+  bool rolled = false;
+  unsigned long elapsed = millis() - windowStart;
+  if (windowStart == 0 || elapsed >= PROF_WINDOW_MS) {
+    if (windowStart != 0)
+      publishWindow(elapsed);
+    resetWindow();
+    windowStart = millis();
+    rolled = true;
+  }
+
+  if (hudEnabled &&
+      (rolled || (drew && millis() - lastHudDraw > HUD_REFRESH_MS))) {
+    drawPerfHud();
+  }
+}
+
+bool isPerfHudEnabled() { return hudEnabled; }
+
+void setPerfHudEnabled(bool on) {
+  if (on == hudEnabled)
+    return;
+  hudEnabled = on;
+  if (on) {
+    drawPerfHud();
+  } else {
+    // Give the area back to the screen's hint bar
+    tft.fillRect(0, HUD_Y, 320, 20, UI_TAB_BG);
+  }
+}
+
+void printPerfReport(Print &out) {
+  out.printf("perf: %.1f fps, %.0f loops/s, heap %u (min %u)\n", pubFps,
+             pubLoops, ESP.getFreeHeap(), ESP.getMinFreeHeap());
+  out.printf("perf: spi %lu avg / %lu max bytes, %lu avg / %lu max calls\n",
+             (unsigned long)pubSpiAvg, (unsigned long)pubSpiMax,
+             (unsigned long)pubCallsAvg, (unsigned long)pubCallsMax);
+  for (int i = 0; i < PROF_SECTION_COUNT; i++) {
+    const SectionStats &st = published[i];
+    if (st.count == 0)
+      continue;
+    out.printf("perf: %-6s n=%-4lu %.2f / %.2f / %.2f ms\n", sectionNames[i],
+               (unsigned long)st.count, minMs(st), avgMs(st), maxMs(st));
+  }
+}
+
+void fillPerfJson(JsonObject obj) {
+  obj["fps"] = pubFps;
+  obj["loops"] = pubLoops;
+  obj["heap"] = ESP.getFreeHeap();
+  obj["heap_min"] = ESP.getMinFreeHeap();
+  obj["spi_avg"] = pubSpiAvg;
+  obj["spi_max"] = pubSpiMax;
+  obj["calls_avg"] = pubCallsAvg;
+  obj["calls_max"] = pubCallsMax;
+  obj["hud"] = hudEnabled;
+  JsonArray arr = obj.createNestedArray("sections");
+  for (int i = 0; i < PROF_SECTION_COUNT; i++) {
+    const SectionStats &st = published[i];
+    JsonObject o = arr.createNestedObject();
+    o["name"] = sectionNames[i];
+    o["n"] = st.count;
+    o["min"] = minMs(st);
+    o["avg"] = avgMs(st);
+    o["max"] = maxMs(st);
+  }
+}
+
+void bootMark(BootStage stage) {
+  if (bootMs[stage] != 0)
+    return;
+  bootMs[stage] = max(1UL, millis());
+  LOG_I("boot", "%s at %lu ms", bootStageNames[stage],
+        (unsigned long)bootMs[stage]);
+}
+
+void fillBootJson(JsonObject obj) {
+  for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+    if (bootMs[i] != 0)
+      obj[bootStageNames[i]] = bootMs[i];
+  }
+}
+
+float getPerfFps() { return pubFps; }
+
+float getPerfLoopsPerSec() { return pubLoops; }
+
+const char *getPerfSectionName(ProfSection s) { return sectionNames[s]; }
+
+PerfSectionStats getPerfSection(ProfSection s) {
+  const SectionStats &st = published[s];
+  return {st.count, avgMs(st), maxMs(st)};
+}
+
+void handlePerfSerial() {
+  while (Serial.available()) {
+    int c = Serial.read();
+    if (c == 'h') {
+      setPerfHudEnabled(!hudEnabled);
+      LOG_I("perf", "HUD %s", hudEnabled ? "on" : "off");
+    } else if (c == 'p') {
+      printPerfReport(Serial);
+      printSchedReport(Serial);
+    }
+  }
+}
+
+// --- ProfiledTFT ---
+
+void ProfiledTFT::drawPixel(int32_t x, int32_t y, uint32_t color) {
+  if (_depth == 0) {
+    profAddDrawCall();
+    profAddSpiBytes(2);
+  }
+  _depth++;
+  TFT_eSPI::drawPixel(x, y, color);
+  _depth--;
+}
+
+void ProfiledTFT::drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color,
+                           uint32_t bg, uint8_t size) {
+  if (_depth == 0) {
+    profAddDrawCall();
+    profAddSpiBytes(6 * 8 * size * size * 2);
+  }
+  _depth++;
+  TFT_eSPI::drawChar(x, y, c, color, bg, size);
+  _depth--;
+}
+
+int16_t ProfiledTFT::drawChar(uint16_t uniCode, int32_t x, int32_t y,
+                              uint8_t font) {
+  bool outer = (_depth == 0);
+  _depth++;
+  int16_t w = TFT_eSPI::drawChar(uniCode, x, y, font);
+  _depth--;
+  if (outer) {
+    profAddDrawCall();
+    profAddSpiBytes((uint32_t)w * fontHeight(font) * 2);
+  }
+  return w;
+}
+
+int16_t ProfiledTFT::drawChar(uint16_t uniCode, int32_t x, int32_t y) {
+  // The library forwards to the 4-argument form, which does the counting
+  return TFT_eSPI::drawChar(uniCode, x, y);
+}
+
+void ProfiledTFT::drawLine(int32_t xs, int32_t ys, int32_t xe, int32_t ye,
+                           uint32_t color) {
+  if (_depth == 0) {
+    profAddDrawCall();
+    profAddSpiBytes((max(abs(xe - xs), abs(ye - ys)) + 1) * 2);
+  }
+  _depth++;
+  TFT_eSPI::drawLine(xs, ys, xe, ye, color);
+  _depth--;
+}
+
+void ProfiledTFT::drawFastVLine(int32_t x, int32_t y, int32_t h,
+                                uint32_t color) {
+  if (_depth == 0 && h > 0) {
+    profAddDrawCall();
+    profAddSpiBytes(h * 2);
+  }
+  _depth++;
+  TFT_eSPI::drawFastVLine(x, y, h, color);
+  _depth--;
+}
+
+void ProfiledTFT::drawFastHLine(int32_t x, int32_t y, int32_t w,
+                                uint32_t color) {
+  if (_depth == 0 && w > 0) {
+    profAddDrawCall();
+    profAddSpiBytes(w * 2);
+  }
+  _depth++;
+  TFT_eSPI::drawFastHLine(x, y, w, color);
+  _depth--;
+}
+
+void ProfiledTFT::fillRect(int32_t x, int32_t y, int32_t w, int32_t h,
+                           uint32_t color) {
+  if (_depth == 0 && w > 0 && h > 0) {
+    profAddDrawCall();
+    profAddSpiBytes((uint32_t)w * h * 2);
+  }
+  _depth++;
+  TFT_eSPI::fillRect(x, y, w, h, color);
+  _depth--;
+}
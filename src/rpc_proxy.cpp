@@ -0,0 +1,542 @@
+#include "rpc_proxy.h"
+#include "config_utils.h"
+#include "metrics.h"
+#include "transmission_client.h"
+#include "web_server.h"
+#include <HTTPClient.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <memory>
+
+#define RPC_PATH "/transmission/rpc"
+#define SESSION_HEADER "X-Transmission-Session-Id"
+
+#define RPC_CACHE_MS 1500      // Identical reads this close share a reply
+#define RPC_SNAPSHOT_MS 3000   // Oldest snapshot served for torrent-get
+#define RPC_SLOTS 4            // Requests in flight or cached
+#define RPC_MAX_WAITERS 6      // Clients sharing one upstream request
+#define RPC_MAX_BODY 2048      // Client request size
+#define RPC_MAX_REPLY 32768    // Larger upstream replies are refused
+#define RPC_CACHE_BYTES 49152  // Cached replies, all slots together
+#define RPC_TIMEOUT_MS 5000
+
+// A client waiting for an upstream reply. The worker only fills it (under
+// rpcMutex); the client's response polls it on the AsyncTCP task, which
+// owns the request. A client that goes away just drops its reference.
+struct RpcWaiter {
+  bool ready;
+  std::shared_ptr<String> reply;
+  bool hasTag;
+  long tag;
+};
+typedef std::shared_ptr<RpcWaiter> RpcWaiterRef;
+
+enum RpcSlotState : uint8_t { SLOT_FREE, SLOT_FETCHING, SLOT_READY };
+
+struct RpcSlot {
+  RpcSlotState state;
+  bool readOnly;  // Cacheable; pass-through slots are freed after replying
+  String payload; // Method and arguments without the tag; the cache key
+  std::shared_ptr<String> reply; // Only successful replies are cached
+  unsigned long startMs;
+  unsigned long fetchedMs;
+  RpcWaiterRef waiters[RPC_MAX_WAITERS];
+  int waiterCount;
+};
+
+static RpcSlot slots[RPC_SLOTS];
+static SemaphoreHandle_t rpcMutex = nullptr;
+static QueueHandle_t rpcQueue = nullptr;
+static char proxySessionId[17];
+static String upstreamSessionId; // Worker task only
+static unsigned long lastMutateMs = 0;
+
+static uint32_t statSnapshot = 0;
+static uint32_t statCached = 0;
+static uint32_t statCoalesced = 0;
+static uint32_t statUpstream = 0;
+static uint32_t statPassThrough = 0;
+static uint32_t statRefused = 0;
+
+static bool isReadOnly(const char *method) {
+  static const char *const reads[] = {"torrent-get", "session-get",
+                                      "session-stats", "free-space",
+                                      "group-get"};
+  for (const char *m : reads) {
+    if (strcmp(method, m) == 0)
+      return true;
+  }
+  return false;
+}
+
+// --- Replies ---
+
+// A reply shared by several clients goes out with each client's tag
+// spliced in front instead of copying the body per client
+struct TaggedReply {
+  std::shared_ptr<String> reply;
+  String head;
+  size_t skip; // The reply's own opening brace when a tag is spliced in
+};
+
+static TaggedReply tagReply(const std::shared_ptr<String> &reply,
+                            bool hasTag, long tag) {
+  TaggedReply t = {reply, "", 0};
+  if (hasTag && reply->length() > 2) {
+    char head[24];
+    snprintf(head, sizeof(head), "{\"tag\":%ld,", tag);
+    t.head = head;
+    t.skip = 1;
+  }
+  return t;
+}
+
+static size_t taggedLength(const TaggedReply &t) {
+  return t.head.length() + t.reply->length() - t.skip;
+}
+
+// Bytes from index on; 0 once everything was sent
+static size_t copyTagged(const TaggedReply &t, uint8_t *buf, size_t maxLen,
+                         size_t index) {
+  size_t hl = t.head.length();
+  size_t n = 0;
+  if (index < hl) {
+    n = min(maxLen, hl - index);
+    memcpy(buf, t.head.c_str() + index, n);
+    index += n;
+  }
+  size_t from = index - hl + t.skip;
+  size_t k = min(maxLen - n, t.reply->length() - from);
+  memcpy(buf + n, t.reply->c_str() + from, k);
+  return n + k;
+}
+
+// A cached reply, sent right away
+static void sendReply(AsyncWebServerRequest *request,
+                      const std::shared_ptr<String> &reply, bool hasTag,
+                      long tag) {
+  TaggedReply t = tagReply(reply, hasTag, tag);
+  AsyncWebServerResponse *response = request->beginResponse(
+      "application/json", taggedLength(t),
+      [t](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        return copyTagged(t, buf, maxLen, index);
+      });
+  request->send(response);
+}
+
+// A reply still being fetched. The headers go out now; the body is polled
+// until the worker marks the waiter ready.
+static void sendWhenReady(AsyncWebServerRequest *request,
+                          const RpcWaiterRef &waiter) {
+  std::shared_ptr<TaggedReply> body(new TaggedReply());
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/json",
+      [waiter, body](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        if (!body->reply) {
+          xSemaphoreTake(rpcMutex, portMAX_DELAY);
+          bool ready = waiter->ready;
+          xSemaphoreGive(rpcMutex);
+          if (!ready)
+            return RESPONSE_TRY_AGAIN;
+          *body = tagReply(waiter->reply, waiter->hasTag, waiter->tag);
+        }
+        return copyTagged(*body, buf, maxLen, index);
+      });
+  request->send(response);
+}
+
+// --- Snapshot path ---
+
+enum SnapField : uint8_t {
+  SF_ID,
+  SF_NAME,
+  SF_STATUS,
+  SF_PERCENT,
+  SF_DOWNLOAD,
+  SF_UPLOAD,
+  SF_RATIO,
+  SF_PRIORITY,
+  SF_COUNT
+};
+
+static const char *const snapFieldNames[SF_COUNT] = {
+    "id",         "name",       "status",      "percentDone",
+    "rateDownload", "rateUpload", "uploadRatio", "bandwidthPriority"};
+
+static void printField(Print &out, const TorrentInfo &t, SnapField f) {
+  switch (f) {
+  case SF_ID:
+    out.print(t.id);
+    break;
+  case SF_NAME: {
+    StaticJsonDocument<16> doc;
+    doc.set(t.name.c_str()); // Escaped by the serializer, not copied
+    serializeJson(doc, out);
+    break;
+  }
+  case SF_STATUS:
+    out.print(t.status);
+    break;
+  case SF_PERCENT:
+    out.print(t.percentDone, 4);
+    break;
+  case SF_DOWNLOAD:
+    out.print(t.rateDownload);
+    break;
+  case SF_UPLOAD:
+    out.print(t.rateUpload);
+    break;
+  case SF_RATIO:
+    out.print(t.uploadRatio, 4);
+    break;
+  case SF_PRIORITY:
+    out.print(t.bandwidthPriority);
+    break;
+  default:
+    break;
+  }
+}
+
+// torrent-get over all torrents for fields the snapshot has, while the
+// snapshot is recent and newer than the last change made through us
+static bool serveFromSnapshot(AsyncWebServerRequest *request,
+                              const char *method, JsonVariant args,
+                              bool hasTag, long tag) {
+  if (strcmp(method, "torrent-get") != 0 || args.containsKey("ids") ||
+      args.containsKey("format"))
+    return false;
+  JsonArray fieldList = args["fields"];
+  if (fieldList.isNull() || fieldList.size() > SF_COUNT)
+    return false;
+
+  SnapField fields[SF_COUNT];
+  int fieldCount = 0;
+  for (JsonVariant v : fieldList) {
+    const char *name = v | "";
+    int f = 0;
+    while (f < SF_COUNT && strcmp(name, snapFieldNames[f]) != 0)
+      f++;
+    if (f == SF_COUNT)
+      return false;
+    fields[fieldCount++] = (SnapField)f;
+  }
+
+  unsigned long taken = transmission.getSnapshotTime();
+  if (taken == 0 || millis() - taken > RPC_SNAPSHOT_MS ||
+      (long)(taken - lastMutateMs) <= 0)
+    return false;
+
+  AsyncResponseStream *response =
+      request->beginResponseStream("application/json");
+  if (hasTag)
+    response->printf("{\"tag\":%ld,", tag);
+  else
+    response->print('{');
+  response->print("\"arguments\":{\"torrents\":[");
+
+  transmission.lockTorrents();
+  const TorrentInfo *torrents = transmission.getTorrents();
+  int count = transmission.getTorrentCount();
+  for (int i = 0; i < count; i++) {
+    response->print(i ? ",{" : "{");
+    for (int f = 0; f < fieldCount; f++) {
+      response->printf("%s\"%s\":", f ? "," : "", snapFieldNames[fields[f]]);
+      printField(*response, torrents[i], fields[f]);
+    }
+    response->print('}');
+  }
+  transmission.unlockTorrents();
+
+  response->print("]},\"result\":\"success\"}");
+  request->send(response);
+  statSnapshot++;
+  return true;
+}
+
+// --- Upstream ---
+
+// POST to the daemon with its session handshake. Returns the HTTP status
+// (or a negative HTTPClient error); reply holds the body or an error text.
+static int upstreamPost(const String &payload, String &reply) {
+  DaemonConfig cfg = getDaemonConfig();
+  if (cfg.host.length() == 0) {
+    reply = "No Transmission host configured";
+    return -1;
+  }
+  String url = cfg.url();
+  const char *headerKeys[] = {SESSION_HEADER};
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    HTTPClient http;
+    http.begin(url);
+    if (cfg.user.length() > 0)
+      http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
+    http.addHeader("Content-Type", "application/json");
+    if (upstreamSessionId.length() > 0)
+      http.addHeader(SESSION_HEADER, upstreamSessionId);
+    http.setTimeout(RPC_TIMEOUT_MS);
+    http.collectHeaders(headerKeys, 1);
+
+    int code = http.POST(payload);
+    if (code == 409) {
+      upstreamSessionId = http.header(SESSION_HEADER);
+      http.end();
+      continue;
+    }
+    if (code == 200) {
+      if (http.getSize() > RPC_MAX_REPLY) {
+        reply = "Reply too large for the proxy";
+        code = 413;
+      } else {
+        reply = http.getString();
+        if (reply.length() > RPC_MAX_REPLY) {
+          reply = "Reply too large for the proxy";
+          code = 413;
+        }
+      }
+    } else {
+      reply = "Upstream error " + String(code);
+    }
+    http.end();
+    return code;
+  }
+  reply = "Upstream session handshake failed";
+  return 409;
+}
+
+static size_t cachedBytes() {
+  size_t total = 0;
+  for (const RpcSlot &s : slots) {
+    if (s.state == SLOT_READY && s.reply)
+      total += s.reply->length();
+  }
+  return total;
+}
+
+static void freeSlot(RpcSlot &slot) {
+  slot.state = SLOT_FREE;
+  slot.payload = "";
+  slot.reply.reset();
+  for (int i = 0; i < slot.waiterCount; i++)
+    slot.waiters[i].reset();
+  slot.waiterCount = 0;
+}
+
+// Worker: one upstream request at a time. The reply is handed to every
+// waiter; their responses on the AsyncTCP task send it.
+static void rpcTask(void *) {
+  int idx;
+  for (;;) {
+    if (xQueueReceive(rpcQueue, &idx, portMAX_DELAY) != pdTRUE)
+      continue;
+    RpcSlot &slot = slots[idx];
+
+    xSemaphoreTake(rpcMutex, portMAX_DELAY);
+    String payload = slot.payload;
+    xSemaphoreGive(rpcMutex);
+
+    std::shared_ptr<String> reply(new String());
+    unsigned long rpcStart = millis();
+    int status = upstreamPost(payload, *reply);
+    metricsObserveRpc(RPC_KIND_PROXY, millis() - rpcStart, status == 200);
+    // Waiters already got a 200 header, so failures are reported the way
+    // the daemon reports its own: in "result"
+    if (status != 200)
+      *reply = "{\"arguments\":{},\"result\":\"" + *reply + "\"}";
+
+    xSemaphoreTake(rpcMutex, portMAX_DELAY);
+    for (int i = 0; i < slot.waiterCount; i++) {
+      slot.waiters[i]->reply = reply;
+      slot.waiters[i]->ready = true;
+      slot.waiters[i].reset();
+    }
+    slot.waiterCount = 0;
+
+    if (!slot.readOnly) {
+      // Cached reads may predate this change
+      lastMutateMs = millis();
+      for (RpcSlot &s : slots) {
+        if (s.state == SLOT_READY)
+          freeSlot(s);
+      }
+      freeSlot(slot);
+    } else if (status != 200 || (long)(slot.startMs - lastMutateMs) <= 0 ||
+               cachedBytes() + reply->length() > RPC_CACHE_BYTES) {
+      freeSlot(slot);
+    } else {
+      slot.reply = reply;
+      slot.fetchedMs = millis();
+      slot.state = SLOT_READY;
+    }
+    xSemaphoreGive(rpcMutex);
+  }
+}
+
+// --- Handler ---
+
+// The response is started by the caller once the lock is released
+static void addWaiter(RpcSlot &slot, RpcWaiterRef &out, bool hasTag,
+                      long tag) {
+  RpcWaiterRef w(new RpcWaiter());
+  w->ready = false;
+  w->hasTag = hasTag;
+  w->tag = tag;
+  slot.waiters[slot.waiterCount++] = w;
+  out = w;
+}
+
+// Join, reuse or start an upstream request. Called with the lock held;
+// returns false when every slot is busy. A cached reply comes back in
+// cached, otherwise the caller waits on waiter.
+static bool submit(const String &payload, bool readOnly, bool hasTag,
+                   long tag, std::shared_ptr<String> &cached,
+                   RpcWaiterRef &waiter) {
+  RpcSlot *target = nullptr;
+  if (readOnly) {
+    for (RpcSlot &s : slots) {
+      if (s.state == SLOT_FREE || !s.readOnly || s.payload != payload)
+        continue;
+      if (s.state == SLOT_READY && millis() - s.fetchedMs < RPC_CACHE_MS) {
+        cached = s.reply;
+        statCached++;
+        return true;
+      }
+      if (s.state == SLOT_FETCHING && s.waiterCount < RPC_MAX_WAITERS) {
+        addWaiter(s, waiter, hasTag, tag);
+        statCoalesced++;
+        return true;
+      }
+      if (s.state == SLOT_READY)
+        target = &s; // Expired copy of this query
+    }
+  }
+
+  // Else a free slot, else the oldest cached reply
+  for (RpcSlot &s : slots) {
+    if (target && target->payload == payload)
+      break;
+    if (s.state == SLOT_FREE) {
+      target = &s;
+      break;
+    }
+    if (s.state == SLOT_READY &&
+        (!target || s.fetchedMs < target->fetchedMs))
+      target = &s;
+  }
+  if (!target)
+    return false;
+
+  int idx = target - slots;
+  freeSlot(*target);
+  target->state = SLOT_FETCHING;
+  target->readOnly = readOnly;
+  target->payload = payload;
+  target->startMs = millis();
+  addWaiter(*target, waiter, hasTag, tag);
+  if (xQueueSend(rpcQueue, &idx, 0) != pdTRUE) {
+    freeSlot(*target);
+    waiter.reset();
+    return false;
+  }
+  if (readOnly)
+    statUpstream++;
+  else
+    statPassThrough++;
+  return true;
+}
+
+static void handleRpcBody(AsyncWebServerRequest *request, uint8_t *data,
+                          size_t len, size_t index, size_t total) {
+  if (total > RPC_MAX_BODY)
+    return; // Refused by handleRpc
+  if (index == 0)
+    request->_tempObject = malloc(total + 1); // Freed with the request
+  char *body = (char *)request->_tempObject;
+  if (!body)
+    return;
+  memcpy(body + index, data, len);
+  if (index + len == total)
+    body[total] = '\0';
+}
+
+static void handleRpc(AsyncWebServerRequest *request) {
+  if (!rpcProxy) {
+    request->send(404, "text/plain", "Not found");
+    return;
+  }
+  DaemonConfig cfg = getDaemonConfig();
+  if (cfg.user.length() > 0 &&
+      !request->authenticate(cfg.user.c_str(), cfg.pass.c_str())) {
+    request->requestAuthentication("Transmission");
+    return;
+  }
+  if (!request->hasHeader(SESSION_HEADER) ||
+      request->getHeader(SESSION_HEADER)->value() != proxySessionId) {
+    AsyncWebServerResponse *response = request->beginResponse(
+        409, "text/html", "<h1>409: Conflict</h1><p>Invalid session id</p>");
+    response->addHeader(SESSION_HEADER, proxySessionId);
+    request->send(response);
+    return;
+  }
+
+  char *body = (char *)request->_tempObject;
+  if (request->contentLength() > RPC_MAX_BODY) {
+    statRefused++;
+    request->send(413, "text/plain", "Request too large");
+    return;
+  }
+  DynamicJsonDocument doc(3072);
+  if (!body || deserializeJson(doc, body)) {
+    request->send(400, "text/plain", "Bad request");
+    return;
+  }
+
+  const char *method = doc["method"] | "";
+  bool hasTag = doc.containsKey("tag");
+  long tag = doc["tag"] | 0L;
+  bool readOnly = isReadOnly(method);
+  if (readOnly &&
+      serveFromSnapshot(request, method, doc["arguments"], hasTag, tag))
+    return;
+
+  // Upstream sees the request without the tag, so equal queries from
+  // different clients share a key and a reply
+  doc.remove("tag");
+  String payload;
+  serializeJson(doc, payload);
+
+  std::shared_ptr<String> cached;
+  RpcWaiterRef waiter;
+  xSemaphoreTake(rpcMutex, portMAX_DELAY);
+  bool queued = submit(payload, readOnly, hasTag, tag, cached, waiter);
+  xSemaphoreGive(rpcMutex);
+  if (!queued) {
+    statRefused++;
+    request->send(503, "text/plain", "Proxy busy");
+  } else if (cached) {
+    sendReply(request, cached, hasTag, tag);
+  } else {
+    sendWhenReady(request, waiter);
+  }
+}
+
+void setupRpcProxy(AsyncWebServer &server) {
+  rpcMutex = xSemaphoreCreateMutex();
+  rpcQueue = xQueueCreate(RPC_SLOTS, sizeof(int));
+  snprintf(proxySessionId, sizeof(proxySessionId), "%08lx%08lx",
+           (unsigned long)esp_random(), (unsigned long)esp_random());
+  xTaskCreatePinnedToCore(rpcTask, "RpcProxy", 8192, NULL, 1, NULL, 0);
+  server.on(RPC_PATH, HTTP_POST, webTimed(RPC_PATH, handleRpc), nullptr,
+            handleRpcBody);
+}
+
+void fillRpcProxyJson(JsonObject obj) {
+  obj["enabled"] = rpcProxy;
+  obj["snapshot"] = statSnapshot;
+  obj["cached"] = statCached;
+  obj["coalesced"] = statCoalesced;
+  obj["upstream"] = statUpstream;
+  obj["pass"] = statPassThrough;
+  obj["refused"] = statRefused;
+}
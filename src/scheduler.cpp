@@ -0,0 +1,214 @@
+#include "scheduler.h"
+#include "logger.h"
+#include <freertos/task.h>
+
+#define SCHED_TICK_MS 10
+#define WHEEL_SLOTS 32 // 320 ms per turn; longer jobs wait for their tick
+#define MAX_JOBS 16
+
+struct Job {
+  const char *name;
+  SchedFn fn;
+  uint32_t periodMs;
+  uint32_t deadline; // millis()
+  uint32_t tick;     // Wheel tick the job fires on (see curTick)
+  bool armed;
+  int8_t next; // Next job in the same slot, -1 = end
+  // Stats
+  uint32_t runs;
+  uint32_t totalUs;
+  uint32_t maxUs;
+  uint32_t maxLateMs;
+};
+
+static Job jobs[MAX_JOBS];
+static int jobCount = 0;
+static int8_t wheel[WHEEL_SLOTS];
+// Ticks count from setup and wrap with uint32_t like millis(); curMs is
+// the millis() at which tick curTick starts. Only differences are compared,
+// so nothing breaks when millis() wraps after 49.7 days.
+static uint32_t curTick = 0; // Next tick to process
+static uint32_t curMs = 0;
+
+static SchedFn eventHandlers[EVENT_COUNT];
+static volatile uint32_t pendingEvents = 0;
+static portMUX_TYPE schedMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t loopTask = nullptr;
+
+void setupScheduler() {
+  loopTask = xTaskGetCurrentTaskHandle();
+  for (int i = 0; i < WHEEL_SLOTS; i++)
+    wheel[i] = -1;
+  curTick = 0;
+  curMs = millis();
+}
+
+// Rounded up, so a job never fires before its deadline
+static void insertJob(int id) {
+  Job &j = jobs[id];
+  int32_t ahead = (int32_t)(j.deadline - curMs);
+  if (ahead < 0)
+    ahead = 0;
+  j.tick = curTick + (ahead + SCHED_TICK_MS - 1) / SCHED_TICK_MS;
+  int8_t &head = wheel[j.tick % WHEEL_SLOTS];
+  j.next = head;
+  head = id;
+  j.armed = true;
+}
+
+static void removeJob(int id) {
+  int8_t *link = &wheel[jobs[id].tick % WHEEL_SLOTS];
+  while (*link >= 0) {
+    if (*link == id) {
+      *link = jobs[id].next;
+      break;
+    }
+    link = &jobs[*link].next;
+  }
+  jobs[id].armed = false;
+}
+
+int schedAddJob(const char *name, uint32_t periodMs, SchedFn fn) {
+  if (jobCount >= MAX_JOBS) {
+    LOG_E("sched", "no room for job %s", name);
+    return -1;
+  }
+  int id = jobCount++;
+  Job &j = jobs[id];
+  memset(&j, 0, sizeof(j));
+  j.name = name;
+  j.fn = fn;
+  j.periodMs = periodMs;
+  j.next = -1;
+  if (periodMs > 0) {
+    j.deadline = millis() + periodMs;
+    insertJob(id);
+  }
+  return id;
+}
+
+void schedRunIn(int job, uint32_t delayMs) {
+  if (job < 0 || job >= jobCount)
+    return;
+  if (jobs[job].armed)
+    removeJob(job);
+  jobs[job].deadline = millis() + delayMs;
+  insertJob(job);
+}
+
+void schedOnEvent(SchedEvent ev, SchedFn fn) { eventHandlers[ev] = fn; }
+
+void schedPost(SchedEvent ev) {
+  portENTER_CRITICAL(&schedMux);
+  pendingEvents |= 1u << ev;
+  portEXIT_CRITICAL(&schedMux);
+  if (loopTask)
+    xTaskNotifyGive(loopTask);
+}
+
+void IRAM_ATTR schedPostFromIsr(SchedEvent ev, BaseType_t *woken) {
+  portENTER_CRITICAL_ISR(&schedMux);
+  pendingEvents |= 1u << ev;
+  portEXIT_CRITICAL_ISR(&schedMux);
+  if (loopTask)
+    vTaskNotifyGiveFromISR(loopTask, woken);
+}
+
+static void runJob(int id, uint32_t now) {
+  Job &j = jobs[id];
+  j.armed = false;
+  uint32_t late = now - j.deadline;
+  if (late > j.maxLateMs)
+    j.maxLateMs = late;
+
+  uint32_t start = micros();
+  j.fn();
+  uint32_t us = micros() - start;
+  j.runs++;
+  j.totalUs += us;
+  if (us > j.maxUs)
+    j.maxUs = us;
+
+  // Periodic jobs keep their phase unless they fell a whole period behind.
+  // A job that re-armed itself keeps that deadline.
+  if (j.periodMs > 0 && !j.armed) {
+    j.deadline += j.periodMs;
+    if ((int32_t)(millis() - j.deadline) >= 0)
+      j.deadline = millis() + j.periodMs;
+    insertJob(id);
+  }
+}
+
+void schedRun() {
+  portENTER_CRITICAL(&schedMux);
+  uint32_t events = pendingEvents;
+  pendingEvents = 0;
+  portEXIT_CRITICAL(&schedMux);
+  for (int ev = 0; ev < EVENT_COUNT; ev++) {
+    if ((events & (1u << ev)) && eventHandlers[ev])
+      eventHandlers[ev]();
+  }
+
+  uint32_t now = millis();
+  while ((int32_t)(now - curMs) >= 0) {
+    // Advance first: jobs re-armed while this tick runs land on a later one
+    uint32_t tick = curTick++;
+    curMs += SCHED_TICK_MS;
+    int slot = tick % WHEEL_SLOTS;
+    // Unlink and run due jobs one at a time, searching from the head again
+    // after each: a job may re-arm others in this slot. Jobs for a later
+    // turn of the wheel stay linked.
+    for (;;) {
+      int8_t *link = &wheel[slot];
+      while (*link >= 0 && jobs[*link].tick != tick)
+        link = &jobs[*link].next;
+      if (*link < 0)
+        break;
+      int8_t id = *link;
+      *link = jobs[id].next;
+      runJob(id, now);
+    }
+  }
+}
+
+void schedIdle(uint32_t maxWaitMs) {
+  if (pendingEvents)
+    return;
+  uint32_t now = millis();
+  uint32_t wait = maxWaitMs;
+  // A handful of jobs: a scan is cheaper than walking the wheel
+  for (int i = 0; i < jobCount; i++) {
+    if (!jobs[i].armed)
+      continue;
+    uint32_t due = curMs + (jobs[i].tick - curTick) * SCHED_TICK_MS;
+    int32_t left = (int32_t)(due - now);
+    if (left <= 0)
+      return;
+    if ((uint32_t)left < wait)
+      wait = left;
+  }
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+}
+
+void printSchedReport(Print &out) {
+  for (int i = 0; i < jobCount; i++) {
+    const Job &j = jobs[i];
+    out.printf("sched: %-6s n=%-5lu avg %lu us, max %lu us, late %lu ms\n",
+               j.name, (unsigned long)j.runs,
+               (unsigned long)(j.runs ? j.totalUs / j.runs : 0),
+               (unsigned long)j.maxUs, (unsigned long)j.maxLateMs);
+  }
+}
+
+void fillSchedJson(JsonArray arr) {
+  for (int i = 0; i < jobCount; i++) {
+    const Job &j = jobs[i];
+    JsonObject o = arr.createNestedObject();
+    o["name"] = j.name;
+    o["period"] = j.periodMs;
+    o["n"] = j.runs;
+    o["avg_us"] = j.runs ? j.totalUs / j.runs : 0;
+    o["max_us"] = j.maxUs;
+    o["late_ms"] = j.maxLateMs;
+  }
+}
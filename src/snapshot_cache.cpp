@@ -0,0 +1,210 @@
+#include "snapshot_cache.h"
+#include "logger.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "transmission_client.h"
+#include <LittleFS.h>
+#include <esp32/rom/crc.h>
+
+#define SNAPSHOT_FILE "/snapshot.bin"
+#define SNAPSHOT_TMP "/snapshot.tmp" // Renamed over the file when complete
+#define SNAPSHOT_MAGIC 0x4e534f47    // "GOSN"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_SAVE_MS 300000 // Save check period; writes only on change
+#define SNAPSHOT_NAME_MAX 120   // Longer names are cut (list rows show less)
+
+// File: header, count records (each followed by its name bytes), then a
+// CRC-32 of everything before it
+struct __attribute__((packed)) SnapshotHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  int32_t dlSpeed;
+  int32_t ulSpeed;
+  int64_t freeSpace;
+  uint8_t altSpeed;
+};
+
+struct __attribute__((packed)) SnapshotRecord {
+  int32_t id;
+  uint8_t status;
+  int8_t priority;
+  uint16_t percent; // percentDone * 10000
+  uint32_t rateDownload;
+  uint32_t rateUpload;
+  float uploadRatio;
+  uint8_t nameLen;
+};
+
+// File with a running CRC over everything read or written
+struct CrcFile {
+  File &file;
+  uint32_t crc;
+  bool ok;
+};
+
+static uint32_t savedRev = 0;
+static bool saved = false;
+static int restoredCount = -1; // -1 = nothing restored
+static uint32_t loadUs = 0;
+static uint32_t saves = 0;
+static uint32_t saveErrors = 0;
+static uint32_t lastSaveUs = 0;
+static uint32_t lastSaveBytes = 0;
+
+static void put(CrcFile &w, const void *data, size_t len) {
+  w.crc = crc32_le(w.crc, (const uint8_t *)data, len);
+  w.ok = w.ok && w.file.write((const uint8_t *)data, len) == len;
+}
+
+static void get(CrcFile &r, void *data, size_t len) {
+  r.ok = r.ok && r.file.read((uint8_t *)data, len) == len;
+  if (r.ok)
+    r.crc = crc32_le(r.crc, (const uint8_t *)data, len);
+}
+
+// Byte length of name cut to the limit without splitting a UTF-8 sequence
+static size_t nameLength(const String &name) {
+  size_t len = name.length();
+  if (len <= SNAPSHOT_NAME_MAX)
+    return len;
+  len = SNAPSHOT_NAME_MAX;
+  while (len > 0 && (name[len] & 0xC0) == 0x80)
+    len--;
+  return len;
+}
+
+// Runs on the loop task, which owns the snapshot
+static bool saveSnapshot() {
+  File file = LittleFS.open(SNAPSHOT_TMP, "w");
+  if (!file)
+    return false;
+  CrcFile w = {file, 0, true};
+
+  int count = transmission.getTorrentCount();
+  SnapshotHeader hdr;
+  hdr.magic = SNAPSHOT_MAGIC;
+  hdr.version = SNAPSHOT_VERSION;
+  hdr.count = count;
+  hdr.dlSpeed = transmission.getDownloadSpeed();
+  hdr.ulSpeed = transmission.getUploadSpeed();
+  hdr.freeSpace = transmission.getFreeSpace();
+  hdr.altSpeed = transmission.isAltSpeedEnabled();
+  put(w, &hdr, sizeof(hdr));
+
+  const TorrentInfo *list = transmission.getTorrents();
+  for (int i = 0; i < count && w.ok; i++) {
+    const TorrentInfo &t = list[i];
+    SnapshotRecord rec;
+    rec.id = t.id;
+    rec.status = t.status;
+    rec.priority = t.bandwidthPriority;
+    rec.percent = (uint16_t)(constrain(t.percentDone, 0.0f, 1.0f) * 10000);
+    rec.rateDownload = t.rateDownload;
+    rec.rateUpload = t.rateUpload;
+    rec.uploadRatio = t.uploadRatio;
+    rec.nameLen = nameLength(t.name);
+    put(w, &rec, sizeof(rec));
+    put(w, t.name.c_str(), rec.nameLen);
+  }
+  uint32_t crc = w.crc;
+  w.ok = w.ok && file.write((const uint8_t *)&crc, sizeof(crc)) == sizeof(crc);
+  lastSaveBytes = file.size();
+  file.close();
+
+  if (!w.ok || !LittleFS.rename(SNAPSHOT_TMP, SNAPSHOT_FILE)) {
+    LittleFS.remove(SNAPSHOT_TMP);
+    return false;
+  }
+  return true;
+}
+
+bool loadSnapshotCache() {
+  File file = LittleFS.open(SNAPSHOT_FILE, "r");
+  if (!file)
+    return false;
+
+  unsigned long t0 = micros();
+  CrcFile r = {file, 0, true};
+  SnapshotHeader hdr;
+  get(r, &hdr, sizeof(hdr));
+  r.ok = r.ok && hdr.magic == SNAPSHOT_MAGIC &&
+         hdr.version == SNAPSHOT_VERSION && hdr.count <= MAX_TORRENTS;
+
+  // Nothing else reads the list this early, so records go straight in
+  TorrentInfo *list = transmission.getTorrents();
+  char name[SNAPSHOT_NAME_MAX + 1];
+  int count = r.ok ? hdr.count : 0;
+  for (int i = 0; i < count && r.ok; i++) {
+    SnapshotRecord rec;
+    get(r, &rec, sizeof(rec));
+    r.ok = r.ok && rec.nameLen <= SNAPSHOT_NAME_MAX;
+    get(r, name, r.ok ? rec.nameLen : 0);
+    if (!r.ok)
+      break;
+    name[rec.nameLen] = '\0';
+
+    TorrentInfo &t = list[i];
+    t.id = rec.id;
+    t.name = name;
+    t.status = rec.status;
+    t.percentDone = rec.percent / 10000.0f;
+    t.rateDownload = rec.rateDownload;
+    t.rateUpload = rec.rateUpload;
+    t.uploadRatio = rec.uploadRatio;
+    t.bandwidthPriority = rec.priority;
+  }
+  uint32_t crc = r.crc;
+  uint32_t stored = 0;
+  bool ok = r.ok &&
+            file.read((uint8_t *)&stored, sizeof(stored)) == sizeof(stored) &&
+            stored == crc;
+  file.close();
+  if (!ok) {
+    LOG_W("snap", "invalid, ignored");
+    return false;
+  }
+
+  transmission.restoreSnapshot(count, hdr.dlSpeed, hdr.ulSpeed,
+                               hdr.freeSpace, hdr.altSpeed != 0);
+  restoredCount = count;
+  loadUs = micros() - t0;
+  bootMark(BOOT_CACHE);
+  LOG_I("snap", "%d torrents in %lu us", count, (unsigned long)loadUs);
+  return true;
+}
+
+// Save when a live fetch changed the snapshot since the last save. Rates
+// change on almost every fetch, so the period is what bounds flash wear.
+static void snapshotTick() {
+  if (transmission.isSnapshotStale() || transmission.getSnapshotTime() == 0)
+    return; // Nothing newer than what is on flash
+  uint32_t rev = transmission.getRevision();
+  if (saved && rev == savedRev)
+    return;
+
+  unsigned long t0 = micros();
+  if (!saveSnapshot()) {
+    saveErrors++;
+    LOG_E("snap", "save failed");
+    return;
+  }
+  lastSaveUs = micros() - t0;
+  savedRev = rev;
+  saved = true;
+  saves++;
+}
+
+void setupSnapshotCache() {
+  schedAddJob("snap", SNAPSHOT_SAVE_MS, snapshotTick);
+}
+
+void fillSnapshotCacheJson(JsonObject obj) {
+  obj["restored"] = restoredCount;
+  obj["load_us"] = loadUs;
+  obj["stale"] = transmission.isSnapshotStale();
+  obj["saves"] = saves;
+  obj["errors"] = saveErrors;
+  obj["save_us"] = lastSaveUs;
+  obj["bytes"] = lastSaveBytes;
+}
@@ -0,0 +1,113 @@
+#include "status_model.h"
+
+// The transmission task runs on core 0, the UI on core 1
+static portMUX_TYPE statusMux = portMUX_INITIALIZER_UNLOCKED;
+
+static StatusModel model = {-1.0f, -1, -127, 0, false, 0, 0, 0, false, 0};
+static uint8_t dirtyMask = SB_ALL;
+
+int rssiToBars(long rssi) {
+  if (rssi >= -60)
+    return 4;
+  if (rssi >= -70)
+    return 3;
+  if (rssi >= -80)
+    return 2;
+  if (rssi >= -90)
+    return 1;
+  return 0;
+}
+
+// num / den rounded the way printf rounds the last digit it shows: to
+// nearest, exact halves to even
+static long roundedDiv(int64_t num, int64_t den) {
+  int64_t q = num / den;
+  int64_t r = num % den;
+  if (2 * r > den || (2 * r == den && (q & 1)))
+    q++;
+  return (long)q;
+}
+
+// Rate at the precision formatSpeedShort() shows it (B, 0.1K, 0.1M)
+static long speedKey(long bytes) {
+  if (bytes < 1024)
+    return bytes;
+  if (bytes < 1048576)
+    return 0x10000000L | roundedDiv((int64_t)bytes * 10, 1024);
+  return 0x20000000L | roundedDiv((int64_t)bytes * 10, 1048576);
+}
+
+void statusSetBattery(float volts, int pct) {
+  portENTER_CRITICAL(&statusMux);
+  model.battVolts = volts;
+  if (pct != model.battPct) {
+    model.battPct = pct;
+    dirtyMask |= SB_BATTERY;
+  }
+  portEXIT_CRITICAL(&statusMux);
+}
+
+void statusSetRssi(long rssi) {
+  int bars = rssiToBars(rssi);
+  portENTER_CRITICAL(&statusMux);
+  model.rssi = rssi;
+  if (bars != model.wifiBars) {
+    model.wifiBars = bars;
+    dirtyMask |= SB_WIFI;
+  }
+  portEXIT_CRITICAL(&statusMux);
+}
+
+void statusSetTransfer(bool connected, long dl, long ul, long long freeBytes,
+                       bool altSpeed) {
+  int freeGB = freeBytes > 0 ? (int)(freeBytes / 1073741824LL) : 0;
+  portENTER_CRITICAL(&statusMux);
+  uint8_t mask = 0;
+  if (connected != model.transConnected)
+    mask |= SB_SPEEDS | SB_EXTRAS;
+  if (speedKey(dl) != speedKey(model.dlSpeed) ||
+      speedKey(ul) != speedKey(model.ulSpeed))
+    mask |= SB_SPEEDS;
+  if (freeGB != model.freeGB || altSpeed != model.altSpeed)
+    mask |= SB_EXTRAS;
+  model.transConnected = connected;
+  model.dlSpeed = dl;
+  model.ulSpeed = ul;
+  model.freeGB = freeGB;
+  model.altSpeed = altSpeed;
+  dirtyMask |= mask;
+  portEXIT_CRITICAL(&statusMux);
+}
+
+bool statusSetOta(int percent) {
+  bool changed;
+  portENTER_CRITICAL(&statusMux);
+  changed = (percent != model.otaProgress);
+  if (changed) {
+    model.otaProgress = percent;
+    dirtyMask |= SB_OTA;
+  }
+  portEXIT_CRITICAL(&statusMux);
+  return changed;
+}
+
+void statusInvalidate(uint8_t mask) {
+  portENTER_CRITICAL(&statusMux);
+  dirtyMask |= mask;
+  portEXIT_CRITICAL(&statusMux);
+}
+
+uint8_t statusTakeChanges(StatusModel &out) {
+  portENTER_CRITICAL(&statusMux);
+  out = model;
+  uint8_t mask = dirtyMask;
+  dirtyMask = 0;
+  portEXIT_CRITICAL(&statusMux);
+  return mask;
+}
+
+void statusRead(StatusModel &out) {
+  portENTER_CRITICAL(&statusMux);
+  out = model;
+  portEXIT_CRITICAL(&statusMux);
+}
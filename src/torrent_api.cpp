@@ -0,0 +1,421 @@
+#include "torrent_api.h"
+#include "transmission_client.h"
+#include <algorithm>
+#include <memory>
+
+#define API_QUERY_MAX 32
+#define API_LINE_MAX 768 // One rendered torrent; long names are cut
+
+enum ApiSort : uint8_t {
+  SORT_NONE, // Snapshot (daemon) order
+  SORT_ID,
+  SORT_NAME,
+  SORT_STATUS,
+  SORT_PROGRESS,
+  SORT_DOWNLOAD,
+  SORT_UPLOAD,
+  SORT_RATIO,
+  SORT_PRIORITY
+};
+
+struct ApiQuery {
+  uint16_t flag; // TorrentFlag bits, 0 = all
+  char search[API_QUERY_MAX + 1];
+  ApiSort sort;
+  bool desc;
+  bool hasSince;
+  uint32_t since;
+};
+
+struct NamedValue {
+  const char *name;
+  uint16_t value;
+};
+
+static const NamedValue filterNames[] = {
+    {"all", 0},
+    {"downloading", TORRENT_FLAG_DOWNLOADING},
+    {"queued_down", TORRENT_FLAG_QUEUED_DOWN},
+    {"seeding", TORRENT_FLAG_SEEDING},
+    {"queued_seed", TORRENT_FLAG_QUEUED_SEED},
+    {"paused", TORRENT_FLAG_PAUSED},
+    {"complete", TORRENT_FLAG_COMPLETE},
+    {"incomplete", TORRENT_FLAG_INCOMPLETE},
+    {"active", TORRENT_FLAG_ACTIVE},
+    {"checking", TORRENT_FLAG_CHECKING}};
+
+static const NamedValue sortNames[] = {
+    {"id", SORT_ID},           {"name", SORT_NAME},
+    {"status", SORT_STATUS},   {"progress", SORT_PROGRESS},
+    {"dl", SORT_DOWNLOAD},     {"ul", SORT_UPLOAD},
+    {"ratio", SORT_RATIO},     {"priority", SORT_PRIORITY}};
+
+template <size_t N>
+static bool lookupName(const NamedValue (&table)[N], const String &name,
+                       uint16_t &value) {
+  for (size_t i = 0; i < N; i++) {
+    if (name == table[i].name) {
+      value = table[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool parseQuery(AsyncWebServerRequest *request, ApiQuery &q,
+                       String &error) {
+  q.flag = 0;
+  q.search[0] = '\0';
+  q.sort = SORT_NONE;
+  q.desc = false;
+  q.hasSince = false;
+  q.since = 0;
+
+  if (request->hasArg("filter") &&
+      !lookupName(filterNames, request->arg("filter"), q.flag)) {
+    error = "Unknown filter";
+    return false;
+  }
+  if (request->hasArg("sort")) {
+    uint16_t sort;
+    if (!lookupName(sortNames, request->arg("sort"), sort)) {
+      error = "Unknown sort";
+      return false;
+    }
+    q.sort = (ApiSort)sort;
+  }
+  q.desc = request->hasArg("order") && request->arg("order") == "desc";
+  if (request->hasArg("q")) {
+    String s = request->arg("q");
+    s.toLowerCase();
+    strncpy(q.search, s.c_str(), API_QUERY_MAX);
+    q.search[API_QUERY_MAX] = '\0';
+  }
+  if (request->hasArg("since")) {
+    q.hasSince = true;
+    q.since = strtoul(request->arg("since").c_str(), nullptr, 10);
+  }
+  return true;
+}
+
+static bool matchesQuery(const TorrentInfo &t, const ApiQuery &q) {
+  if (q.flag != 0 && !(t.flags & q.flag))
+    return false;
+  return q.search[0] == '\0' || strstr(t.nameLower.c_str(), q.search);
+}
+
+// Negative, zero or positive like strcmp, for ascending order
+static int compareTorrents(const TorrentInfo &a, const TorrentInfo &b,
+                           ApiSort sort) {
+  switch (sort) {
+  case SORT_NAME:
+    return strcmp(a.nameLower.c_str(), b.nameLower.c_str());
+  case SORT_STATUS:
+    return a.status - b.status;
+  case SORT_PROGRESS:
+    return (a.percentDone > b.percentDone) - (a.percentDone < b.percentDone);
+  case SORT_DOWNLOAD:
+    return (a.rateDownload > b.rateDownload) -
+           (a.rateDownload < b.rateDownload);
+  case SORT_UPLOAD:
+    return (a.rateUpload > b.rateUpload) - (a.rateUpload < b.rateUpload);
+  case SORT_RATIO:
+    return (a.uploadRatio > b.uploadRatio) - (a.uploadRatio < b.uploadRatio);
+  case SORT_PRIORITY:
+    return a.bandwidthPriority - b.bandwidthPriority;
+  default:
+    return 0;
+  }
+}
+
+// Copy s into out as JSON string contents. Stops early (on a UTF-8
+// boundary) when out is full. Returns the bytes written.
+static size_t escapeJson(char *out, size_t cap, const char *s) {
+  size_t n = 0;
+  for (; *s; s++) {
+    unsigned char c = *s;
+    char esc[7];
+    size_t len;
+    if (c == '"' || c == '\\') {
+      esc[0] = '\\';
+      esc[1] = c;
+      len = 2;
+    } else if (c < 0x20) {
+      len = snprintf(esc, sizeof(esc), "\\u%04x", c);
+    } else {
+      esc[0] = c;
+      len = 1;
+    }
+    if (n + len > cap) {
+      while (n > 0 && ((unsigned char)out[n - 1] & 0xC0) == 0x80)
+        n--; // Continuation bytes of a cut character
+      if (n > 0 && ((unsigned char)out[n - 1] & 0xC0) == 0xC0)
+        n--; // Its lead byte
+      break;
+    }
+    memcpy(out + n, esc, len);
+    n += len;
+  }
+  return n;
+}
+
+static size_t renderTorrent(char *out, size_t cap, const TorrentInfo &t) {
+  size_t n = snprintf(out, cap, "{\"id\":%d,\"name\":\"", t.id);
+  n += escapeJson(out + n, cap - n - 160, t.name.c_str());
+  n += snprintf(out + n, cap - n,
+                "\",\"status\":%d,\"pct\":%.1f,\"dl\":%ld,\"ul\":%ld,"
+                "\"ratio\":%.2f,\"prio\":%d,\"rev\":%lu}",
+                t.status, t.percentDone * 100.0f, t.rateDownload,
+                t.rateUpload, t.uploadRatio, t.bandwidthPriority,
+                (unsigned long)t.rev);
+  return n;
+}
+
+static int findTorrent(const TorrentInfo *torrents, int count, int id,
+                       int hint) {
+  if (hint >= 0 && hint < count && torrents[hint].id == id)
+    return hint;
+  for (int i = 0; i < count; i++) {
+    if (torrents[i].id == id)
+      return i;
+  }
+  return -1;
+}
+
+// --- List stream ---
+
+enum StreamPhase : uint8_t {
+  PHASE_HEAD,
+  PHASE_REMOVED,
+  PHASE_ROWS,
+  PHASE_TAIL,
+  PHASE_DONE
+};
+
+// Selected at request time; rows are rendered from the live snapshot as
+// the connection drains. A torrent that changes meanwhile is sent with its
+// newer revision and simply shows up again in the next delta.
+struct TorrentStream {
+  StreamPhase phase;
+  uint32_t rev;
+  bool full;
+  unsigned long ageMs;
+  int total;
+  int ids[MAX_TORRENTS];
+  int slots[MAX_TORRENTS]; // Snapshot index hints for ids
+  int count;
+  int removed[MAX_TORRENTS + REMOVED_LOG_SIZE];
+  int removedCount;
+  int pos;
+  bool rowSent;
+  char line[API_LINE_MAX];
+  size_t lineLen;
+  size_t lineOff;
+};
+
+static void selectTorrents(TorrentStream &st, const ApiQuery &q) {
+  TorrentInfo *torrents = transmission.getTorrents();
+  int count = transmission.getTorrentCount();
+
+  st.rev = transmission.getRevision();
+  unsigned long taken = transmission.getSnapshotTime();
+  st.ageMs = taken ? millis() - taken : 0;
+  st.full = true;
+  st.removedCount = 0;
+  if (q.hasSince) {
+    int n = transmission.getRemovedSince(q.since, st.removed,
+                                         REMOVED_LOG_SIZE);
+    if (n >= 0) {
+      st.full = false;
+      st.removedCount = n;
+    }
+  }
+
+  st.total = 0;
+  st.count = 0;
+  for (int i = 0; i < count; i++) {
+    const TorrentInfo &t = torrents[i];
+    bool match = matchesQuery(t, q);
+    if (match)
+      st.total++;
+    if (!st.full && (int32_t)(t.rev - q.since) <= 0)
+      continue; // Unchanged since the client's copy
+    if (match)
+      st.slots[st.count++] = i;
+    else if (!st.full)
+      st.removed[st.removedCount++] = t.id; // Changed out of the view
+  }
+
+  if (q.sort != SORT_NONE) {
+    ApiSort sort = q.sort;
+    bool desc = q.desc;
+    std::sort(st.slots, st.slots + st.count, [&](int a, int b) {
+      int c = compareTorrents(torrents[a], torrents[b], sort);
+      if (c == 0)
+        c = torrents[a].id - torrents[b].id;
+      return desc ? c > 0 : c < 0;
+    });
+  } else if (q.desc) {
+    std::reverse(st.slots, st.slots + st.count);
+  }
+  for (int i = 0; i < st.count; i++)
+    st.ids[i] = torrents[st.slots[i]].id;
+}
+
+// Render the next piece of output into st.line. False when done.
+static bool nextLine(TorrentStream &st) {
+  st.lineOff = 0;
+  st.lineLen = 0;
+  while (st.lineLen == 0) {
+    switch (st.phase) {
+    case PHASE_HEAD:
+      st.lineLen = snprintf(st.line, sizeof(st.line),
+                            "{\"rev\":%lu,\"full\":%s,\"age_ms\":%lu,"
+                            "\"total\":%d,\"removed\":[",
+                            (unsigned long)st.rev,
+                            st.full ? "true" : "false", st.ageMs, st.total);
+      st.phase = PHASE_REMOVED;
+      st.pos = 0;
+      break;
+    case PHASE_REMOVED:
+      if (st.pos < st.removedCount) {
+        st.lineLen = snprintf(st.line, sizeof(st.line), "%s%d",
+                              st.pos ? "," : "", st.removed[st.pos]);
+        st.pos++;
+      } else {
+        st.lineLen = snprintf(st.line, sizeof(st.line), "],\"torrents\":[");
+        st.phase = PHASE_ROWS;
+        st.pos = 0;
+      }
+      break;
+    case PHASE_ROWS: {
+      if (st.pos >= st.count) {
+        st.phase = PHASE_TAIL;
+        break;
+      }
+      transmission.lockTorrents();
+      const TorrentInfo *torrents = transmission.getTorrents();
+      int i = findTorrent(torrents, transmission.getTorrentCount(),
+                          st.ids[st.pos], st.slots[st.pos]);
+      if (i >= 0) {
+        size_t n = 0;
+        if (st.rowSent)
+          st.line[n++] = ',';
+        n += renderTorrent(st.line + n, sizeof(st.line) - n, torrents[i]);
+        st.lineLen = n;
+        st.rowSent = true;
+      }
+      transmission.unlockTorrents();
+      st.pos++;
+      break;
+    }
+    case PHASE_TAIL:
+      st.lineLen = snprintf(st.line, sizeof(st.line), "]}");
+      st.phase = PHASE_DONE;
+      break;
+    case PHASE_DONE:
+      return false;
+    }
+  }
+  return true;
+}
+
+void sendTorrentList(AsyncWebServerRequest *request) {
+  ApiQuery q;
+  String error;
+  if (!parseQuery(request, q, error)) {
+    request->send(400, "text/plain", error);
+    return;
+  }
+
+  std::shared_ptr<TorrentStream> st(new (std::nothrow) TorrentStream);
+  if (!st) {
+    request->send(503, "text/plain", "Out of memory");
+    return;
+  }
+  st->phase = PHASE_HEAD;
+  st->rowSent = false;
+  st->lineLen = st->lineOff = 0;
+  transmission.lockTorrents();
+  selectTorrents(*st, q);
+  transmission.unlockTorrents();
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/json",
+      [st](uint8_t *buf, size_t maxLen, size_t) -> size_t {
+        size_t n = 0;
+        while (n < maxLen) {
+          if (st->lineOff == st->lineLen && !nextLine(*st))
+            break;
+          size_t k = min(maxLen - n, st->lineLen - st->lineOff);
+          memcpy(buf + n, st->line + st->lineOff, k);
+          st->lineOff += k;
+          n += k;
+        }
+        return n;
+      });
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+void sendTorrent(AsyncWebServerRequest *request, int id) {
+  char line[API_LINE_MAX];
+  size_t n = 0;
+
+  transmission.lockTorrents();
+  int i = findTorrent(transmission.getTorrents(),
+                      transmission.getTorrentCount(), id, -1);
+  if (i >= 0)
+    n = renderTorrent(line, sizeof(line) - 1, transmission.getTorrents()[i]);
+  transmission.unlockTorrents();
+
+  if (i < 0) {
+    request->send(404, "text/plain", "No such torrent");
+    return;
+  }
+  line[n] = '\0';
+  request->send(200, "application/json", line);
+}
+
+bool renderTorrentDelta(uint32_t since, String &out, int maxRows) {
+  int removed[REMOVED_LOG_SIZE];
+  int removedCount = transmission.getRemovedSince(since, removed,
+                                                  REMOVED_LOG_SIZE);
+  if (removedCount < 0)
+    return false;
+
+  const TorrentInfo *torrents = transmission.getTorrents();
+  int count = transmission.getTorrentCount();
+  int changed = 0;
+  for (int i = 0; i < count; i++) {
+    if ((int32_t)(torrents[i].rev - since) > 0)
+      changed++;
+  }
+  if (changed > maxRows)
+    return false;
+
+  char line[API_LINE_MAX];
+  snprintf(line, sizeof(line), "{\"from\":%lu,\"rev\":%lu,\"removed\":[",
+           (unsigned long)since, (unsigned long)transmission.getRevision());
+  out.reserve(64 + removedCount * 8 + changed * 160);
+  out = line;
+  for (int i = 0; i < removedCount; i++) {
+    if (i)
+      out += ',';
+    out += removed[i];
+  }
+  out += "],\"torrents\":[";
+  bool first = true;
+  for (int i = 0; i < count; i++) {
+    if ((int32_t)(torrents[i].rev - since) <= 0)
+      continue;
+    if (!first)
+      out += ',';
+    first = false;
+    size_t n = renderTorrent(line, sizeof(line) - 1, torrents[i]);
+    line[n] = '\0';
+    out += line;
+  }
+  out += "]}";
+  return true;
+}
@@ -1,39 +1,91 @@
 #include "torrent_list_gui.h"
+#include "custom_filters.h"
 #include "display_utils.h"
+#include "logger.h"
+#include "profiler.h"
 #include "transmission_client.h"
 #include <TFT_eSPI.h>
 
 // External TFT reference
-extern TFT_eSPI tft;
+extern ProfiledTFT tft;
 
 // State variables
 static TorrentListState listState = TORRENT_LIST_BROWSING;
 static TorrentFilter currentFilter = FILTER_ALL;
 static int scrollOffset = 0;
 static int selectedTorrent = 0;
+static int pickerIndex = 0; // Highlighted filter in the picker overlay
+
+// Match counts for custom filters, refreshed once per snapshot
+static int customFilterCounts[MAX_CUSTOM_FILTERS];
 
 // Search state
 static String searchQuery = "";
 static int kbRow = 0;
 static int kbCol = 0;
 static bool shiftActive = false;
+static bool fuzzySearch = false; // Subsequence matching with ranking
+
+// Lowercase copy of searchQuery, rebuilt only when the query changes
+#define MAX_QUERY_LEN 30
+static char queryLower[MAX_QUERY_LEN + 1] = "";
+static int queryLowerLen = 0;
 
 // Filtered torrent indices
 static int filteredIndices[MAX_TORRENTS];
+static int filteredScores[MAX_TORRENTS]; // Fuzzy rank, parallel to indices
 static int filteredCount = 0;
 
-// Last fetch time
+// Last fetch time, failed fetches included
 static unsigned long lastFetchTime = 0;
+#define RECONCILE_GAP_MS 500 // Between fetches while the list is stale
+
+// Snapshot revision the filtered list was built from
+static uint32_t listRevision = 0;
+static bool listSynced = false;
+static bool listCached = false; // Showing last session's snapshot
+
+// List layout
+#define ROW_H 36
+#define CONTENT_Y 44
+#define MAX_VISIBLE 5     // 180 / 36 = 5 rows
+#define ROW_STATS_DY 14   // Stats line band starts here within a row
+#define SCROLLBAR_X 316
+#define LIST_BOTTOM 220   // Hint bar starts here; the last row is clipped
+
+// Dirty tracking: fingerprints of what is currently on screen. A region is
+// repainted only when its fingerprint changes or the frame was invalidated
+// by another screen drawing over the content area.
+static bool listFrameValid = false;
+static uint32_t filterBarPrint = 0;
+static uint32_t rowHeadPrint[MAX_VISIBLE];  // Name, status icon, selection
+static uint32_t rowStatsPrint[MAX_VISIBLE]; // Rates, priority, ratio, percent
+static uint32_t scrollBarPrint = 0;
+static uint32_t emptyStatePrint = 0;
+
+// Estimated pixel bytes pushed over SPI (RGB565) by the last refresh
+static uint32_t refreshBytes = 0;
+static uint32_t lastRefreshBytes = 0;
 
 // Virtual keyboard layouts (same as wifi_scan_gui)
 static const char *kbRowsLower[] = {"1234567890", "qwertyuiop", "asdfghjkl",
                                     "zxcvbnm"};
 static const char *kbRowsUpper[] = {"!@#$%^&*()", "QWERTYUIOP", "ASDFGHJKL",
                                     "ZXCVBNM"};
-#define KB_ROWS 5 // 4 char rows + 1 action row
+#define KB_ROWS 5    // 4 char rows + 1 action row
+#define KB_ACTIONS 4 // Shift, Space, Clear, Fuzzy
+
+// Built-in filters followed by user-defined ones
+static int getTotalFilterCount() {
+  return FILTER_COUNT + getCustomFilterCount();
+}
 
 // Filter names
 const char *getFilterName(TorrentFilter filter) {
+  if (filter >= FILTER_COUNT) {
+    const CustomFilter *cf = getCustomFilter(filter - FILTER_COUNT);
+    return cf ? cf->name : "???";
+  }
   switch (filter) {
   case FILTER_ALL:
     return "All";
@@ -60,59 +112,126 @@ const char *getFilterName(TorrentFilter filter) {
   }
 }
 
-// Check if torrent matches current filter and search
-static bool matchesFilter(const TorrentInfo &t) {
-  // Check search query first
-  if (searchQuery.length() > 0) {
-    String nameLower = t.name;
-    nameLower.toLowerCase();
-    String queryLower = searchQuery;
-    queryLower.toLowerCase();
-    if (nameLower.indexOf(queryLower) < 0) {
-      return false;
-    }
+// Rebuild the lowercase query buffer after searchQuery changed
+static void updateQueryLower() {
+  queryLowerLen = min((int)searchQuery.length(), MAX_QUERY_LEN);
+  for (int i = 0; i < queryLowerLen; i++) {
+    queryLower[i] = tolower((unsigned char)searchQuery[i]);
   }
+  queryLower[queryLowerLen] = '\0';
+}
 
-  // Check status filter
-  switch (currentFilter) {
-  case FILTER_ALL:
-    return true;
-  case FILTER_DOWNLOADING:
-    return t.status == TR_STATUS_DOWNLOAD;
-  case FILTER_QUEUED_DOWN:
-    return t.status == TR_STATUS_DOWNLOAD_WAIT;
-  case FILTER_SEEDING:
-    return t.status == TR_STATUS_SEED;
-  case FILTER_QUEUED_SEED:
-    return t.status == TR_STATUS_SEED_WAIT;
-  case FILTER_PAUSED:
-    return t.status == TR_STATUS_STOPPED;
-  case FILTER_COMPLETE:
-    return t.percentDone >= 1.0;
-  case FILTER_INCOMPLETE:
-    return t.percentDone < 1.0;
-  case FILTER_ACTIVE:
-    return t.rateDownload > 0 || t.rateUpload > 0;
-  case FILTER_CHECKING:
-    return t.status == TR_STATUS_CHECK || t.status == TR_STATUS_CHECK_WAIT;
-  default:
+static bool isWordStart(const char *name, int pos) {
+  if (pos == 0)
     return true;
+  char prev = name[pos - 1];
+  return prev == ' ' || prev == '.' || prev == '-' || prev == '_' ||
+         prev == '[' || prev == '(';
+}
+
+// Match the cached lowercase name against the query without allocating.
+// Returns -1 for no match, otherwise a rank (higher = better). Exact mode
+// ranks everything equally so the daemon's order is kept.
+static int matchQuery(const TorrentInfo &t) {
+  if (queryLowerLen == 0)
+    return 0;
+
+  const char *name = t.nameLower.c_str();
+  if (!fuzzySearch) {
+    return strstr(name, queryLower) ? 0 : -1;
+  }
+
+  // Fuzzy: every query char must appear in order. Consecutive runs and
+  // matches at word starts score higher.
+  int score = 0;
+  int run = 0;
+  int q = 0;
+  for (int i = 0; name[i] != '\0' && q < queryLowerLen; i++) {
+    if (name[i] == queryLower[q]) {
+      run++;
+      score += 1 + run * 2;
+      if (isWordStart(name, i))
+        score += 5;
+      q++;
+    } else {
+      run = 0;
+    }
   }
+  return (q == queryLowerLen) ? score : -1;
 }
 
-// Rebuild filtered list
-static void applyFilter() {
-  filteredCount = 0;
+// Bucket flag for each filter (0 = matches everything)
+static const uint16_t filterFlags[FILTER_COUNT] = {
+    0,                          // FILTER_ALL
+    TORRENT_FLAG_DOWNLOADING,   // FILTER_DOWNLOADING
+    TORRENT_FLAG_QUEUED_DOWN,   // FILTER_QUEUED_DOWN
+    TORRENT_FLAG_SEEDING,       // FILTER_SEEDING
+    TORRENT_FLAG_QUEUED_SEED,   // FILTER_QUEUED_SEED
+    TORRENT_FLAG_PAUSED,        // FILTER_PAUSED
+    TORRENT_FLAG_COMPLETE,      // FILTER_COMPLETE
+    TORRENT_FLAG_INCOMPLETE,    // FILTER_INCOMPLETE
+    TORRENT_FLAG_ACTIVE,        // FILTER_ACTIVE
+    TORRENT_FLAG_CHECKING       // FILTER_CHECKING
+};
+
+// Check if torrent matches the current status or custom filter
+static bool matchesFilter(const TorrentInfo &t) {
+  if (currentFilter >= FILTER_COUNT) {
+    const CustomFilter *cf = getCustomFilter(currentFilter - FILTER_COUNT);
+    return cf && evalFilterProgram(cf->program, t);
+  }
+  uint16_t flag = filterFlags[currentFilter];
+  return flag == 0 || (t.flags & flag);
+}
+
+// Evaluate every custom filter once over a new snapshot
+static void countCustomFilters() {
   TorrentInfo *torrents = transmission.getTorrents();
   int total = transmission.getTorrentCount();
+  int n = getCustomFilterCount();
+
+  for (int f = 0; f < n; f++) {
+    const FilterProgram &prog = getCustomFilter(f)->program;
+    int count = 0;
+    for (int i = 0; i < total; i++) {
+      if (evalFilterProgram(prog, torrents[i]))
+        count++;
+    }
+    customFilterCounts[f] = count;
+  }
+}
 
-  for (int i = 0; i < total && filteredCount < MAX_TORRENTS; i++) {
-    if (matchesFilter(torrents[i])) {
-      filteredIndices[filteredCount++] = i;
+// Number of torrents in a filter bucket (ignores the search query).
+// Built-in counts are maintained at ingest, so this costs no extra pass or
+// RPC; custom counts come from countCustomFilters().
+static int getFilterBucketCount(TorrentFilter filter) {
+  if (filter >= FILTER_COUNT)
+    return customFilterCounts[filter - FILTER_COUNT];
+  uint16_t flag = filterFlags[filter];
+  if (flag == 0)
+    return transmission.getTorrentCount();
+  return transmission.getFlagCount((TorrentFlag)flag);
+}
+
+// Stable insertion sort by fuzzy score (best first). The filtered set is
+// small and already mostly ordered between keystrokes.
+static void sortByScore() {
+  for (int i = 1; i < filteredCount; i++) {
+    int idx = filteredIndices[i];
+    int score = filteredScores[i];
+    int j = i - 1;
+    while (j >= 0 && filteredScores[j] < score) {
+      filteredIndices[j + 1] = filteredIndices[j];
+      filteredScores[j + 1] = filteredScores[j];
+      j--;
     }
+    filteredIndices[j + 1] = idx;
+    filteredScores[j + 1] = score;
   }
+}
 
-  // Adjust selection if out of bounds
+// Adjust selection if out of bounds
+static void clampSelection() {
   if (selectedTorrent >= filteredCount) {
     selectedTorrent = filteredCount > 0 ? filteredCount - 1 : 0;
   }
@@ -121,14 +240,80 @@ static void applyFilter() {
   }
 }
 
+// Rebuild filtered list from the full torrent snapshot
+static void applyFilter() {
+  // Custom filters may have been removed from the web UI
+  if (currentFilter >= getTotalFilterCount())
+    currentFilter = FILTER_ALL;
+
+  filteredCount = 0;
+  TorrentInfo *torrents = transmission.getTorrents();
+  int total = transmission.getTorrentCount();
+
+  for (int i = 0; i < total && filteredCount < MAX_TORRENTS; i++) {
+    if (!matchesFilter(torrents[i]))
+      continue;
+    int score = matchQuery(torrents[i]);
+    if (score < 0)
+      continue;
+    filteredIndices[filteredCount] = i;
+    filteredScores[filteredCount] = score;
+    filteredCount++;
+  }
+
+  if (fuzzySearch && queryLowerLen > 0)
+    sortByScore();
+  clampSelection();
+}
+
+// The query only grew, so every new match is already in the current result
+// set: re-test just those instead of rescanning the whole snapshot
+static void narrowFilter() {
+  TorrentInfo *torrents = transmission.getTorrents();
+  int kept = 0;
+
+  for (int i = 0; i < filteredCount; i++) {
+    int score = matchQuery(torrents[filteredIndices[i]]);
+    if (score < 0)
+      continue;
+    filteredIndices[kept] = filteredIndices[i];
+    filteredScores[kept] = score;
+    kept++;
+  }
+  filteredCount = kept;
+
+  if (fuzzySearch && queryLowerLen > 0)
+    sortByScore();
+  clampSelection();
+}
+
 void initTorrentListGui() {
   listState = TORRENT_LIST_BROWSING;
   currentFilter = FILTER_ALL;
   scrollOffset = 0;
   selectedTorrent = 0;
   searchQuery = "";
+  updateQueryLower();
   filteredCount = 0;
   lastFetchTime = 0;
+  listSynced = false;
+}
+
+// Re-filter when the snapshot changed. Web API requests also fetch on the
+// loop task, so a new snapshot can arrive between our own fetches.
+static void syncSnapshot() {
+  bool cached = transmission.isSnapshotStale();
+  if (cached != listCached) {
+    listCached = cached;
+    listFrameValid = false; // The hint bar says whether the list is cached
+  }
+  uint32_t rev = transmission.getRevision();
+  if (listSynced && rev == listRevision)
+    return;
+  listRevision = rev;
+  listSynced = true;
+  countCustomFilters();
+  applyFilter();
 }
 
 // Format speed for display
@@ -151,17 +336,106 @@ static const char *getPriorityStr(int priority) {
   return "Md";
 }
 
+// FNV-1a over 32-bit values and strings, for screen region fingerprints
+#define FNV_SEED 2166136261u
+static uint32_t fnvMix(uint32_t h, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    h ^= (v >> (i * 8)) & 0xFF;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static uint32_t fnvMixStr(uint32_t h, const char *s, int maxLen) {
+  for (int i = 0; i < maxLen && s[i] != '\0'; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Speed at the precision formatSpeed() displays it
+static uint32_t speedDisplayKey(long bytesPerSec) {
+  if (bytesPerSec < 1024)
+    return bytesPerSec;
+  if (bytesPerSec < 1024 * 1024)
+    return 0x10000000 | (bytesPerSec / 1024);
+  return 0x20000000 | (bytesPerSec / (1024 * 1024 / 10));
+}
+
+static void countPixels(int w, int h) { refreshBytes += (uint32_t)w * h * 2; }
+
 // Draw progress bar
-static void drawProgressBar(int x, int y, int w, int h, float percent) {
+static void drawProgressBar(TFT_eSPI &gfx, int x, int y, int w, int h,
+                            float percent) {
   // Background
-  tft.fillRect(x, y, w, h, UI_GREY);
+  gfx.fillRect(x, y, w, h, UI_GREY);
   // Filled portion
   int fillW = (int)(w * percent);
   if (fillW > 0) {
-    tft.fillRect(x, y, fillW, h, TFT_GREEN);
+    gfx.fillRect(x, y, fillW, h, TFT_GREEN);
   }
 }
 
+// Small rounded badge with a number in it
+static void drawCountBadge(int x, int y, int count, uint16_t bg) {
+  char buf[8];
+  snprintf(buf, sizeof(buf), "%d", count);
+  int w = strlen(buf) * 6 + 6;
+  tft.fillRoundRect(x, y, w, 13, 4, bg);
+  tft.setTextColor(UI_WHITE, bg);
+  tft.setCursor(x + 3, y + 3);
+  tft.print(buf);
+}
+
+// Filter picker overlay: all filters with their bucket counts, 2 columns
+#define PICKER_ROWS 7
+static void drawFilterPicker() {
+  int boxX = 20;
+  int boxY = 46;
+  int boxW = 280;
+  int boxH = 170;
+  tft.fillRoundRect(boxX, boxY, boxW, boxH, 6, UI_CARD_BG);
+  tft.drawRoundRect(boxX, boxY, boxW, boxH, 6, UI_CYAN);
+
+  tft.setTextSize(1);
+  tft.setTextColor(UI_CYAN, UI_CARD_BG);
+  tft.setCursor(boxX + 10, boxY + 8);
+  tft.print("Filters");
+
+  int cellW = 130;
+  int cellH = 18;
+  int gridY = boxY + 22;
+  for (int f = 0; f < getTotalFilterCount(); f++) {
+    int col = f / PICKER_ROWS;
+    int row = f % PICKER_ROWS;
+    int x = boxX + 8 + col * (cellW + 4);
+    int y = gridY + row * (cellH + 2);
+
+    bool sel = (f == pickerIndex);
+    uint16_t bg = sel ? UI_SELECTED_BG : UI_CARD_BG;
+    tft.fillRoundRect(x, y, cellW, cellH, 3, bg);
+    if (f == currentFilter)
+      tft.drawRoundRect(x, y, cellW, cellH, 3, UI_CYAN);
+
+    // Custom filters in yellow to tell them apart
+    uint16_t fg = (f >= FILTER_COUNT) ? TFT_YELLOW : UI_WHITE;
+    tft.setTextColor(sel ? UI_CYAN : fg, bg);
+    tft.setCursor(x + 8, y + 5);
+    tft.print(getFilterName((TorrentFilter)f));
+
+    int count = getFilterBucketCount((TorrentFilter)f);
+    drawCountBadge(x + cellW - 40, y + 2, count,
+                   count > 0 ? UI_TAB_BG : UI_BG);
+  }
+
+  // Hint bar
+  tft.fillRect(0, 220, 320, 20, UI_TAB_BG);
+  tft.setTextColor(UI_GREY, UI_TAB_BG);
+  tft.setCursor(10, 225);
+  tft.print("A:Apply  B:Close  Arrows:Move");
+}
+
 // Draw filter bar at top
 static void drawFilterBar() {
   int y = 24;
@@ -173,7 +447,7 @@ static void drawFilterBar() {
   tft.setTextColor(UI_GREY, UI_TAB_BG);
   tft.setCursor(5, y + 6);
   if (searchQuery.length() > 0) {
-    tft.print("\"");
+    tft.print(fuzzySearch ? "~\"" : "\"");
     // Truncate long search
     if (searchQuery.length() > 8) {
       tft.print(searchQuery.substring(0, 8));
@@ -186,10 +460,12 @@ static void drawFilterBar() {
     tft.print("[VOL:Search]");
   }
 
-  // Filter name
+  // Filter name with bucket count badge
   tft.setTextColor(UI_CYAN, UI_TAB_BG);
   tft.setCursor(110, y + 6);
   tft.print(getFilterName(currentFilter));
+  drawCountBadge(tft.getCursorX() + 4, y + 3,
+                 getFilterBucketCount(currentFilter), UI_CARD_BG);
 
   // Count
   int total = transmission.getTorrentCount();
@@ -198,31 +474,36 @@ static void drawFilterBar() {
   tft.printf("%d/%d", filteredCount, total);
 }
 
-// Draw a single torrent row
-static void drawTorrentRow(int listIdx, int screenY, bool selected) {
-  if (listIdx >= filteredCount)
-    return;
-
-  int idx = filteredIndices[listIdx];
-  TorrentInfo *torrents = transmission.getTorrents();
-  const TorrentInfo &t = torrents[idx];
-
-  int rowH = 36;
+// Fingerprint of the name line (also covers row background)
+static uint32_t rowHeadFingerprint(const TorrentInfo &t, bool selected) {
+  uint32_t h = fnvMix(FNV_SEED, t.id);
+  h = fnvMixStr(h, t.name.c_str(), 42);
+  h = fnvMix(h, t.status);
+  return fnvMix(h, selected);
+}
 
-  // Background
-  uint16_t bgColor = selected ? UI_SELECTED_BG : UI_BG;
-  tft.fillRect(0, screenY, 320, rowH, bgColor);
+// Fingerprint of the stats line, at displayed precision
+static uint32_t rowStatsFingerprint(const TorrentInfo &t) {
+  uint32_t h = fnvMix(FNV_SEED, speedDisplayKey(t.rateUpload));
+  h = fnvMix(h, speedDisplayKey(t.rateDownload));
+  h = fnvMix(h, t.bandwidthPriority);
+  h = fnvMix(h, t.uploadRatio < 0 ? -1 : (int)(t.uploadRatio * 10 + 0.5f));
+  h = fnvMix(h, (int)(t.percentDone * 100));
+  return fnvMix(h, (int)(45 * t.percentDone));
+}
 
-  // Line 1: Name (truncated)
-  tft.setTextSize(1);
-  tft.setTextColor(UI_WHITE, bgColor);
-  tft.setCursor(5, screenY + 3);
+// Line 1: name and status icon
+static void drawRowHead(TFT_eSPI &gfx, const TorrentInfo &t, int screenY,
+                        uint16_t bgColor) {
+  gfx.setTextSize(1);
+  gfx.setTextColor(UI_WHITE, bgColor);
+  gfx.setCursor(5, screenY + 3);
 
   String name = t.name;
   if (name.length() > 42) {
     name = name.substring(0, 42);
   }
-  tft.print(name);
+  gfx.print(name);
 
   // Status icon based on status
   const char *statusIcon = "";
@@ -251,54 +532,178 @@ static void drawTorrentRow(int listIdx, int screenY, bool selected) {
     statusColor = UI_GREY;
     break;
   }
-  tft.setTextColor(statusColor, bgColor);
-  tft.setCursor(305, screenY + 3);
-  tft.print(statusIcon);
+  gfx.setTextColor(statusColor, bgColor);
+  gfx.setCursor(305, screenY + 3);
+  gfx.print(statusIcon);
+}
 
-  // Line 2: Stats
+// Line 2: speeds, priority, ratio, percent and progress bar
+static void drawRowStats(TFT_eSPI &gfx, const TorrentInfo &t, int screenY,
+                         uint16_t bgColor) {
   int y2 = screenY + 16;
-  tft.setTextColor(UI_GREY, bgColor);
-  tft.setCursor(5, y2);
+  gfx.setTextSize(1);
+  gfx.setTextColor(UI_GREY, bgColor);
+  gfx.setCursor(5, y2);
 
   // U: and D: speeds
-  tft.print("U:");
-  tft.setTextColor(UI_CYAN, bgColor);
-  tft.print(formatSpeed(t.rateUpload));
+  gfx.print("U:");
+  gfx.setTextColor(UI_CYAN, bgColor);
+  gfx.print(formatSpeed(t.rateUpload));
 
-  tft.setTextColor(UI_GREY, bgColor);
-  tft.print(" D:");
-  tft.setTextColor(TFT_GREEN, bgColor);
-  tft.print(formatSpeed(t.rateDownload));
+  gfx.setTextColor(UI_GREY, bgColor);
+  gfx.print(" D:");
+  gfx.setTextColor(TFT_GREEN, bgColor);
+  gfx.print(formatSpeed(t.rateDownload));
 
   // Priority
-  tft.setTextColor(UI_GREY, bgColor);
-  tft.setCursor(150, y2);
-  tft.print("Pri:");
-  tft.setTextColor(UI_WHITE, bgColor);
-  tft.print(getPriorityStr(t.bandwidthPriority));
+  gfx.setTextColor(UI_GREY, bgColor);
+  gfx.setCursor(150, y2);
+  gfx.print("Pri:");
+  gfx.setTextColor(UI_WHITE, bgColor);
+  gfx.print(getPriorityStr(t.bandwidthPriority));
 
   // Ratio
-  tft.setTextColor(UI_GREY, bgColor);
-  tft.setCursor(195, y2);
-  tft.print("R:");
-  tft.setTextColor(UI_WHITE, bgColor);
+  gfx.setTextColor(UI_GREY, bgColor);
+  gfx.setCursor(195, y2);
+  gfx.print("R:");
+  gfx.setTextColor(UI_WHITE, bgColor);
   if (t.uploadRatio < 0) {
-    tft.print("-");
+    gfx.print("-");
   } else {
-    tft.printf("%.1f", t.uploadRatio);
+    gfx.printf("%.1f", t.uploadRatio);
   }
 
   // Percent
   int pct = (int)(t.percentDone * 100);
-  tft.setTextColor(UI_WHITE, bgColor);
-  tft.setCursor(235, y2);
-  tft.printf("%3d%%", pct);
+  gfx.setTextColor(UI_WHITE, bgColor);
+  gfx.setCursor(235, y2);
+  gfx.printf("%3d%%", pct);
 
   // Progress bar
-  drawProgressBar(270, y2, 45, 8, t.percentDone);
+  drawProgressBar(gfx, 270, y2, 45, 8, t.percentDone);
+}
+
+// Row compositor: rows are drawn into an off-screen sprite and pushed to the
+// panel with DMA while the CPU composes the next one. Two sprites alternate
+// so a buffer is never rewritten while it is still being sent.
+static TFT_eSprite rowSprite[2] = {TFT_eSprite(&tft), TFT_eSprite(&tft)};
+static uint16_t *rowBuf[2] = {nullptr, nullptr};
+static int rowBufNext = 0;
+static bool rowDmaReady = false;  // false: draw straight to the panel
+static bool rowRendererTried = false;
+
+// Frame time of the last full list repaint
+static uint32_t lastFullRedrawMicros = 0;
+
+// Cursor moves are applied at once but drawn at most once per frame, so a
+// burst of UP/DOWN steps collapses into a single repaint of the final view
+#define SCROLL_FRAME_MS 33
+static bool cursorMovePending = false;
+static unsigned long lastListFrameMs = 0;
+
+static void initRowRenderer() {
+  rowRendererTried = true;
+  if (!tft.initDMA()) {
+    LOG_W("list", "DMA init failed, using direct drawing");
+    return;
+  }
+  for (int i = 0; i < 2; i++) {
+    rowSprite[i].setColorDepth(16);
+    // DMA can only read internal RAM
+    rowSprite[i].setAttribute(PSRAM_ENABLE, false);
+    rowBuf[i] = (uint16_t *)rowSprite[i].createSprite(320, ROW_H);
+    if (!rowBuf[i]) {
+      LOG_W("list", "no RAM for row sprites, using direct drawing");
+      for (int j = 0; j < i; j++) {
+        rowSprite[j].deleteSprite();
+        rowBuf[j] = nullptr;
+      }
+      return;
+    }
+  }
+  rowDmaReady = true;
+}
+
+// Open / close an SPI transaction around a batch of row pushes
+static void beginRowBatch() {
+  if (rowDmaReady)
+    tft.startWrite();
+}
+
+static void endRowBatch() {
+  if (rowDmaReady) {
+    tft.dmaWait();
+    tft.endWrite();
+  }
+}
+
+// Direct drawing must not overlap a DMA transfer in flight
+static void waitRowDma() {
+  if (rowDmaReady)
+    tft.dmaWait();
+}
+
+// Draw a single torrent row. With statsOnly, only the second line band is
+// repainted (name and status icon are known to be unchanged).
+static void drawTorrentRow(int listIdx, int screenY, bool selected,
+                           bool statsOnly) {
+  if (listIdx >= filteredCount)
+    return;
+
+  int idx = filteredIndices[listIdx];
+  TorrentInfo *torrents = transmission.getTorrents();
+  const TorrentInfo &t = torrents[idx];
+  uint16_t bgColor = selected ? UI_SELECTED_BG : UI_BG;
+  int bandH = ROW_H - ROW_STATS_DY - 1; // Between name line and divider
+  int rowH = min(ROW_H, LIST_BOTTOM - screenY);
+  bandH = min(bandH, rowH - ROW_STATS_DY);
+
+  if (rowDmaReady) {
+    // Compose at y=0 in the sprite, then push the row (or just its stats
+    // band, which is contiguous in the buffer)
+    TFT_eSprite &spr = rowSprite[rowBufNext];
+    uint16_t *buf = rowBuf[rowBufNext];
+    rowBufNext ^= 1;
+
+    if (statsOnly) {
+      spr.fillRect(0, ROW_STATS_DY, 320, bandH, bgColor);
+      drawRowStats(spr, t, 0, bgColor);
+      tft.pushImageDMA(0, screenY + ROW_STATS_DY, 320, bandH,
+                       buf + ROW_STATS_DY * 320);
+      countPixels(320, bandH);
+      profAddDrawCall();
+      profAddSpiBytes(320 * bandH * 2);
+      return;
+    }
+
+    spr.fillSprite(bgColor);
+    drawRowHead(spr, t, 0, bgColor);
+    drawRowStats(spr, t, 0, bgColor);
+    spr.drawFastHLine(5, ROW_H - 1, 310, UI_GREY);
+    tft.pushImageDMA(0, screenY, 320, rowH, buf);
+    countPixels(320, rowH);
+    profAddDrawCall();
+    profAddSpiBytes(320 * rowH * 2);
+    return;
+  }
+
+  if (statsOnly) {
+    tft.fillRect(0, screenY + ROW_STATS_DY, 320, bandH, bgColor);
+    countPixels(320, bandH);
+    drawRowStats(tft, t, screenY, bgColor);
+    return;
+  }
 
-  // Divider line
-  tft.drawFastHLine(5, screenY + rowH - 1, 310, UI_GREY);
+  // Background
+  tft.fillRect(0, screenY, 320, rowH, bgColor);
+  countPixels(320, rowH);
+
+  drawRowHead(tft, t, screenY, bgColor);
+  drawRowStats(tft, t, screenY, bgColor);
+
+  // Divider line (hidden under the hint bar on the last row)
+  if (rowH == ROW_H)
+    tft.drawFastHLine(5, screenY + ROW_H - 1, 310, UI_GREY);
 }
 
 // Draw virtual keyboard for search
@@ -353,11 +758,12 @@ static void drawSearchKeyboard() {
 
   // Action row
   int actY = startY + 4 * (keyH + 4);
-  const char *actions[] = {"Shift", "Space", "Clear"};
-  int actW = 80;
-  int actX = (320 - 3 * actW) / 2;
+  const char *actions[KB_ACTIONS] = {"Shift", "Space", "Clear",
+                                     fuzzySearch ? "Fuzzy:On" : "Fuzzy:Off"};
+  int actW = 76;
+  int actX = (320 - KB_ACTIONS * actW) / 2;
 
-  for (int i = 0; i < 3; i++) {
+  for (int i = 0; i < KB_ACTIONS; i++) {
     bool sel = (kbRow == 4 && kbCol == i);
     int x = actX + i * actW;
 
@@ -373,6 +779,22 @@ static void drawSearchKeyboard() {
     tft.print(actions[i]);
   }
 
+  // Live results: filter narrows with every keystroke
+  int resY = actY + keyH + 6;
+  tft.setTextColor(UI_GREY, UI_BG);
+  tft.setCursor(10, resY);
+  tft.printf("%d match%s", filteredCount, filteredCount == 1 ? "" : "es");
+  if (filteredCount > 0 && searchQuery.length() > 0) {
+    const TorrentInfo &best = transmission.getTorrents()[filteredIndices[0]];
+    tft.setTextColor(UI_WHITE, UI_BG);
+    tft.setCursor(10, resY + 12);
+    if (best.name.length() > 50) {
+      tft.print(best.name.substring(0, 50));
+    } else {
+      tft.print(best.name);
+    }
+  }
+
   // Hint bar
   tft.fillRect(0, 220, 320, 20, UI_TAB_BG);
   tft.setTextColor(UI_GREY, UI_TAB_BG);
@@ -380,113 +802,238 @@ static void drawSearchKeyboard() {
   tft.print("A:Type  B:Back  VOL:Done  START:Clear");
 }
 
+// Hint bar: static text, only drawn on full repaints
+static void drawListHintBar() {
+  tft.fillRect(0, 220, 320, 20, UI_TAB_BG);
+  tft.setTextSize(1);
+  if (listCached) {
+    // Saved session rates, not live ones
+    tft.setTextColor(TFT_YELLOW, UI_TAB_BG);
+    tft.setCursor(5, 225);
+    tft.print("CACHED - waiting for Transmission  ");
+    tft.setTextColor(UI_GREY, UI_TAB_BG);
+    tft.print("D:");
+    tft.print(formatSpeed(transmission.getDownloadSpeed()));
+    tft.print(" U:");
+    tft.print(formatSpeed(transmission.getUploadSpeed()));
+    return;
+  }
+  tft.setTextColor(UI_GREY, UI_TAB_BG);
+  tft.setCursor(5, 225);
+  tft.print("MENU:");
+  tft.setTextColor(UI_WHITE, UI_TAB_BG);
+  tft.print("Menu ");
+  tft.setTextColor(UI_GREY, UI_TAB_BG);
+  tft.print("VOL:");
+  tft.setTextColor(UI_WHITE, UI_TAB_BG);
+  tft.print("Srch ");
+  tft.setTextColor(UI_GREY, UI_TAB_BG);
+  tft.print("B,L/R:");
+  tft.setTextColor(UI_WHITE, UI_TAB_BG);
+  tft.print("Filt ");
+  tft.setTextColor(UI_GREY, UI_TAB_BG);
+  tft.print("SEL:");
+  tft.setTextColor(UI_WHITE, UI_TAB_BG);
+  tft.print("Spd ");
+  tft.setTextColor(UI_GREY, UI_TAB_BG);
+  tft.print("START:");
+  tft.setTextColor(UI_WHITE, UI_TAB_BG);
+  tft.print("Pause");
+}
+
 void drawTorrentList() {
-  // Fetch immediately on first draw, then every 3 seconds
-  if (lastFetchTime == 0 || millis() - lastFetchTime > 3000) {
+  // Fetch immediately on first draw, then every 3 seconds. A cached list
+  // is replaced as soon as the daemon answers; while torrent-get keeps
+  // failing, those retries are spaced so frames and keys don't stall.
+  unsigned long sinceFetch = millis() - lastFetchTime;
+  bool reconcile = transmission.isSnapshotStale() &&
+                   transmission.isConnected() &&
+                   sinceFetch > RECONCILE_GAP_MS;
+  if (lastFetchTime == 0 || reconcile || sinceFetch > 3000) {
+    PROFILE_SCOPE(PROF_FETCH);
     transmission.fetchTorrents();
-    applyFilter();
     lastFetchTime = millis();
   }
+  syncSnapshot();
 
   if (listState == TORRENT_LIST_SEARCHING) {
     drawSearchKeyboard();
+    listFrameValid = false;
+    return;
+  }
+
+  if (listState == TORRENT_LIST_PICKING_FILTER) {
+    drawFilterBar();
+    drawFilterPicker();
+    listFrameValid = false;
     return;
   }
 
-  // Clear content area
-  tft.fillRect(0, 24, 320, 196, UI_BG);
+  if (!rowRendererTried)
+    initRowRenderer();
 
-  // Draw filter bar
-  drawFilterBar();
+  refreshBytes = 0;
+  bool full = !listFrameValid;
+  uint32_t startMicros = micros();
+  cursorMovePending = false;
 
-  // Draw torrent rows
-  int rowH = 36;
-  int contentY = 44;
-  int maxVisible = 5; // 180 / 36 = 5 rows
+  if (full) {
+    // Another screen drew over the content area: start from a clean slate
+    tft.fillRect(0, 24, 320, 196, UI_BG);
+    countPixels(320, 196);
+    drawListHintBar();
+    countPixels(320, 20);
+  }
+
+  // Filter bar
+  uint32_t fp = fnvMixStr(FNV_SEED, searchQuery.c_str(), MAX_QUERY_LEN);
+  fp = fnvMix(fp, fuzzySearch);
+  fp = fnvMix(fp, currentFilter);
+  fp = fnvMix(fp, getFilterBucketCount(currentFilter));
+  fp = fnvMix(fp, filteredCount);
+  fp = fnvMix(fp, transmission.getTorrentCount());
+  if (full || fp != filterBarPrint) {
+    drawFilterBar();
+    countPixels(320, 20);
+    filterBarPrint = fp;
+  }
 
-  for (int i = 0; i < maxVisible && (scrollOffset + i) < filteredCount; i++) {
+  // Torrent rows: full repaint when the name line changed, otherwise just
+  // the stats band when only numbers changed
+  bool anyRowDrawn = false;
+  TorrentInfo *torrents = transmission.getTorrents();
+  beginRowBatch();
+  for (int i = 0; i < MAX_VISIBLE; i++) {
     int listIdx = scrollOffset + i;
-    bool selected = (listIdx == selectedTorrent);
-    drawTorrentRow(listIdx, contentY + i * rowH, selected);
+    int screenY = CONTENT_Y + i * ROW_H;
+    uint32_t head = 0; // 0 = empty slot
+    uint32_t stats = 0;
+
+    if (listIdx < filteredCount) {
+      const TorrentInfo &t = torrents[filteredIndices[listIdx]];
+      bool selected = (listIdx == selectedTorrent);
+      head = rowHeadFingerprint(t, selected);
+      stats = rowStatsFingerprint(t);
+
+      if (full || head != rowHeadPrint[i]) {
+        drawTorrentRow(listIdx, screenY, selected, false);
+        anyRowDrawn = true;
+      } else if (stats != rowStatsPrint[i]) {
+        drawTorrentRow(listIdx, screenY, selected, true);
+        anyRowDrawn = true;
+      }
+    } else if (!full && rowHeadPrint[i] != 0) {
+      // Row scrolled out or filtered away
+      int h = min(ROW_H, LIST_BOTTOM - screenY);
+      waitRowDma();
+      tft.fillRect(0, screenY, 320, h, UI_BG);
+      countPixels(320, h);
+      anyRowDrawn = true;
+    }
+
+    rowHeadPrint[i] = head;
+    rowStatsPrint[i] = stats;
   }
+  endRowBatch();
 
   // Empty state
+  uint32_t emptyPrint = 0;
   if (filteredCount == 0) {
+    emptyPrint = (transmission.getTorrentCount() == 0) ? 1 : 2;
+  }
+  if (emptyPrint != 0 &&
+      (full || anyRowDrawn || emptyPrint != emptyStatePrint)) {
+    tft.fillRect(0, 116, 320, 16, UI_BG);
+    countPixels(320, 16);
     tft.setTextSize(1);
     tft.setTextColor(UI_GREY, UI_BG);
     tft.setCursor(100, 120);
-    if (transmission.getTorrentCount() == 0) {
+    if (emptyPrint == 1) {
       tft.print("No torrents found");
     } else {
       tft.print("No matches for filter");
     }
   }
+  emptyStatePrint = emptyPrint;
 
-  // Scroll indicator
-  if (filteredCount > maxVisible) {
+  // Scroll indicator (rows paint over its column, so redraw with them)
+  uint32_t sp = 0;
+  if (filteredCount > MAX_VISIBLE) {
+    sp = fnvMix(fnvMix(FNV_SEED, filteredCount), scrollOffset);
+  }
+  if (sp != 0 && (full || anyRowDrawn || sp != scrollBarPrint)) {
     int barH = 150;
     int barY = 50;
-    int thumbH = max(20, barH * maxVisible / filteredCount);
+    int thumbH = max(20, barH * MAX_VISIBLE / filteredCount);
     int thumbY = barY + (barH - thumbH) * scrollOffset /
-                            max(1, filteredCount - maxVisible);
-
-    tft.fillRect(316, barY, 4, barH, UI_GREY);
-    tft.fillRect(316, thumbY, 4, thumbH, UI_CYAN);
+                            max(1, filteredCount - MAX_VISIBLE);
+
+    tft.fillRect(SCROLLBAR_X, barY, 4, barH, UI_GREY);
+    tft.fillRect(SCROLLBAR_X, thumbY, 4, thumbH, UI_CYAN);
+    countPixels(4, barH + thumbH);
+  } else if (sp == 0 && scrollBarPrint != 0 && !full) {
+    tft.fillRect(SCROLLBAR_X, 50, 4, 150, UI_BG);
+    countPixels(4, 150);
   }
+  scrollBarPrint = sp;
+
+  listFrameValid = true;
+  bootMark(BOOT_FIRST_LIST);
+  if (!listCached)
+    bootMark(BOOT_LIVE_LIST);
+  lastRefreshBytes = refreshBytes;
+  lastListFrameMs = millis();
+  if (full)
+    lastFullRedrawMicros = micros() - startMicros;
+}
 
-  // Hint bar
-  tft.fillRect(0, 220, 320, 20, UI_TAB_BG);
-  tft.setTextSize(1);
-  tft.setTextColor(UI_GREY, UI_TAB_BG);
-  tft.setCursor(5, 225);
-  tft.print("MENU:");
-  tft.setTextColor(UI_WHITE, UI_TAB_BG);
-  tft.print("Menu ");
-  tft.setTextColor(UI_GREY, UI_TAB_BG);
-  tft.print("VOL:");
-  tft.setTextColor(UI_WHITE, UI_TAB_BG);
-  tft.print("Srch ");
-  tft.setTextColor(UI_GREY, UI_TAB_BG);
-  tft.print("L/R:");
-  tft.setTextColor(UI_WHITE, UI_TAB_BG);
-  tft.print("Filt ");
-  tft.setTextColor(UI_GREY, UI_TAB_BG);
-  tft.print("SEL:");
-  tft.setTextColor(UI_WHITE, UI_TAB_BG);
-  tft.print("Spd ");
-  tft.setTextColor(UI_GREY, UI_TAB_BG);
-  tft.print("START:");
-  tft.setTextColor(UI_WHITE, UI_TAB_BG);
-  tft.print("Pause");
+void invalidateTorrentList() { listFrameValid = false; }
+
+uint32_t getTorrentListRefreshBytes() { return lastRefreshBytes; }
+
+uint32_t getTorrentListRedrawMicros() { return lastFullRedrawMicros; }
+
+bool isTorrentListUsingDma() { return rowDmaReady; }
+
+int getTorrentListFrameWait() {
+  if (!cursorMovePending)
+    return -1;
+  unsigned long since = millis() - lastListFrameMs;
+  return since >= SCROLL_FRAME_MS ? 0 : SCROLL_FRAME_MS - since;
 }
 
 bool handleTorrentListInput(bool up, bool down, bool left, bool right, bool a,
                             bool b, bool start, bool select, bool volume) {
   bool update = false;
+  syncSnapshot(); // Indices below must point at the current snapshot
 
   if (listState == TORRENT_LIST_SEARCHING) {
     // Keyboard navigation
     if (up && kbRow > 0) {
       kbRow--;
-      int maxCol = (kbRow < 4) ? strlen(kbRowsLower[kbRow]) - 1 : 2;
+      int maxCol =
+          (kbRow < 4) ? strlen(kbRowsLower[kbRow]) - 1 : KB_ACTIONS - 1;
       if (kbCol > maxCol)
         kbCol = maxCol;
       update = true;
     } else if (down && kbRow < KB_ROWS - 1) {
       kbRow++;
-      int maxCol = (kbRow < 4) ? strlen(kbRowsLower[kbRow]) - 1 : 2;
+      int maxCol =
+          (kbRow < 4) ? strlen(kbRowsLower[kbRow]) - 1 : KB_ACTIONS - 1;
       if (kbCol > maxCol)
         kbCol = maxCol;
       update = true;
     } else if (left) {
-      int maxCol = (kbRow < 4) ? strlen(kbRowsLower[kbRow]) - 1 : 2;
+      int maxCol =
+          (kbRow < 4) ? strlen(kbRowsLower[kbRow]) - 1 : KB_ACTIONS - 1;
       if (kbCol > 0)
         kbCol--;
       else
         kbCol = maxCol;
       update = true;
     } else if (right) {
-      int maxCol = (kbRow < 4) ? strlen(kbRowsLower[kbRow]) - 1 : 2;
+      int maxCol =
+          (kbRow < 4) ? strlen(kbRowsLower[kbRow]) - 1 : KB_ACTIONS - 1;
       if (kbCol < maxCol)
         kbCol++;
       else
@@ -494,58 +1041,97 @@ bool handleTorrentListInput(bool up, bool down, bool left, bool right, bool a,
       update = true;
     } else if (a) {
       if (kbRow < 4) {
-        // Type character
+        // Type character - the longer query can only narrow the results
         const char **rows = shiftActive ? kbRowsUpper : kbRowsLower;
-        if (searchQuery.length() < 30) {
+        if (searchQuery.length() < MAX_QUERY_LEN) {
           searchQuery += rows[kbRow][kbCol];
+          updateQueryLower();
+          narrowFilter();
         }
       } else {
         // Action row
         if (kbCol == 0) {
           shiftActive = !shiftActive;
         } else if (kbCol == 1) {
-          if (searchQuery.length() < 30)
+          if (searchQuery.length() < MAX_QUERY_LEN) {
             searchQuery += ' ';
+            updateQueryLower();
+            narrowFilter();
+          }
         } else if (kbCol == 2) {
           searchQuery = "";
+          updateQueryLower();
+          applyFilter();
+        } else if (kbCol == 3) {
+          fuzzySearch = !fuzzySearch;
+          applyFilter();
         }
       }
       update = true;
     } else if (b) {
-      // Backspace - delete last character
+      // Backspace - delete last character (widens results, full rescan)
       if (searchQuery.length() > 0) {
-        searchQuery = searchQuery.substring(0, searchQuery.length() - 1);
+        searchQuery.remove(searchQuery.length() - 1);
+        updateQueryLower();
+        applyFilter();
       }
       update = true;
     } else if (volume) {
       // Done searching (same button that opened search)
       listState = TORRENT_LIST_BROWSING;
-      applyFilter();
       update = true;
     } else if (start) {
       // Clear search
       searchQuery = "";
+      updateQueryLower();
+      applyFilter();
+      update = true;
+    }
+  } else if (listState == TORRENT_LIST_PICKING_FILTER) {
+    int row = pickerIndex % PICKER_ROWS;
+    int col = pickerIndex / PICKER_ROWS;
+    if (up && row > 0) {
+      pickerIndex--;
+      update = true;
+    } else if (down && row < PICKER_ROWS - 1 &&
+               pickerIndex + 1 < getTotalFilterCount()) {
+      pickerIndex++;
+      update = true;
+    } else if ((left && col > 0) || (right && col == 0)) {
+      int target = left ? pickerIndex - PICKER_ROWS : pickerIndex + PICKER_ROWS;
+      if (target >= 0 && target < getTotalFilterCount())
+        pickerIndex = target;
+      update = true;
+    } else if (a) {
+      currentFilter = (TorrentFilter)pickerIndex;
+      scrollOffset = 0;
+      selectedTorrent = 0;
+      applyFilter();
+      listState = TORRENT_LIST_BROWSING;
+      update = true;
+    } else if (b || volume) {
+      listState = TORRENT_LIST_BROWSING;
       update = true;
     }
   } else {
-    // Browsing mode
+    // Browsing mode. Cursor moves are drawn by the frame pacer
+    // (getTorrentListFrameWait), not immediately.
     if (up && selectedTorrent > 0) {
       selectedTorrent--;
       if (selectedTorrent < scrollOffset) {
         scrollOffset = selectedTorrent;
       }
-      update = true;
+      cursorMovePending = true;
     } else if (down && selectedTorrent < filteredCount - 1) {
       selectedTorrent++;
-      int maxVisible = 5;
-      if (selectedTorrent >= scrollOffset + maxVisible) {
-        scrollOffset = selectedTorrent - maxVisible + 1;
+      if (selectedTorrent >= scrollOffset + MAX_VISIBLE) {
+        scrollOffset = selectedTorrent - MAX_VISIBLE + 1;
       }
-      update = true;
+      cursorMovePending = true;
     } else if (left) {
       // Previous filter
       int f = (int)currentFilter;
-      f = (f - 1 + FILTER_COUNT) % FILTER_COUNT;
+      f = (f - 1 + getTotalFilterCount()) % getTotalFilterCount();
       currentFilter = (TorrentFilter)f;
       scrollOffset = 0;
       selectedTorrent = 0;
@@ -554,7 +1140,7 @@ bool handleTorrentListInput(bool up, bool down, bool left, bool right, bool a,
     } else if (right) {
       // Next filter
       int f = (int)currentFilter;
-      f = (f + 1) % FILTER_COUNT;
+      f = (f + 1) % getTotalFilterCount();
       currentFilter = (TorrentFilter)f;
       scrollOffset = 0;
       selectedTorrent = 0;
@@ -571,6 +1157,11 @@ bool handleTorrentListInput(bool up, bool down, bool left, bool right, bool a,
         transmission.toggleTorrentPause(torrents[idx].id);
         update = true;
       }
+    } else if (b) {
+      // Open filter picker
+      pickerIndex = (int)currentFilter;
+      listState = TORRENT_LIST_PICKING_FILTER;
+      update = true;
     } else if (volume) {
       // Open search
       listState = TORRENT_LIST_SEARCHING;
@@ -588,7 +1179,6 @@ bool handleTorrentListInput(bool up, bool down, bool left, bool right, bool a,
         update = true;
       }
     }
-    // Note: B is handled in main.cpp to return to menu
   }
 
   return update;
@@ -602,3 +1192,8 @@ void enterTorrentSearchMode() {
 }
 
 bool isInTorrentSearchMode() { return listState == TORRENT_LIST_SEARCHING; }
+
+void onCustomFiltersChanged() {
+  countCustomFilters();
+  applyFilter();
+}
@@ -1,5 +1,10 @@
 #include "transmission_client.h"
-#include "config_utils.h" // For transHost, etc.
+#include "config_utils.h" // For getDaemonConfig()
+#include "logger.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "status_model.h"
 #include <WiFi.h>
 
 TransmissionClient::TransmissionClient() {
@@ -12,24 +17,47 @@ TransmissionClient::TransmissionClient() {
   _freeSpace = 0;
   _sessionId = "";
   _torrentCount = 0;
+  memset(_flagCounts, 0, sizeof(_flagCounts));
+  _revision = 0;
+  _snapshotTime = 0;
+  _stale = false;
+  _torrentMutex = nullptr;
+  _removedHead = 0;
+  _removedCount = 0;
+  _removedFloor = 0;
 }
 
 void TransmissionClient::begin() {
-  // Initial setup if needed
+  _torrentMutex = xSemaphoreCreateMutex();
+  _revision = esp_random();
+  _removedFloor = _revision;
 }
 
 void TransmissionClient::update() {
   if (WiFi.status() != WL_CONNECTED) {
     _connected = false;
+    publishStatus();
     return;
   }
 
   if (millis() - _lastUpdate > _interval) {
     _lastUpdate = millis();
     fetchStats();
+    publishStatus();
+    schedPost(EVENT_NET); // Wake the UI loop to redraw the status bar
   }
 }
 
+void TransmissionClient::setUpdateInterval(unsigned long ms) {
+  _interval = ms;
+}
+
+// Push the latest session values to the status bar model
+void TransmissionClient::publishStatus() {
+  statusSetTransfer(_connected, _dlSpeed, _ulSpeed, _freeSpace,
+                    _altSpeedEnabled);
+}
+
 bool TransmissionClient::isConnected() { return _connected; }
 
 long TransmissionClient::getDownloadSpeed() { return _dlSpeed; }
@@ -41,15 +69,16 @@ bool TransmissionClient::isAltSpeedEnabled() { return _altSpeedEnabled; }
 long long TransmissionClient::getFreeSpace() { return _freeSpace; }
 
 void TransmissionClient::toggleAltSpeed() {
-  if (transHost.length() == 0 || !_connected)
+  DaemonConfig cfg = getDaemonConfig();
+  if (cfg.host.length() == 0 || !_connected)
     return;
 
   HTTPClient http;
-  String url = "http://" + transHost + ":" + String(transPort) + transPath;
+  String url = cfg.url();
 
   http.begin(url);
-  if (transUser.length() > 0) {
-    http.setAuthorization(transUser.c_str(), transPass.c_str());
+  if (cfg.user.length() > 0) {
+    http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
   }
   http.addHeader("Content-Type", "application/json");
   if (_sessionId.length() > 0) {
@@ -66,6 +95,7 @@ void TransmissionClient::toggleAltSpeed() {
   const char *headerKeys[] = {"X-Transmission-Session-Id"};
   http.collectHeaders(headerKeys, 1);
 
+  unsigned long rpcStart = millis();
   int httpCode = http.POST(payload);
 
   if (httpCode == 409) {
@@ -73,33 +103,36 @@ void TransmissionClient::toggleAltSpeed() {
     http.end();
 
     http.begin(url);
-    if (transUser.length() > 0) {
-      http.setAuthorization(transUser.c_str(), transPass.c_str());
+    if (cfg.user.length() > 0) {
+      http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
     }
     http.addHeader("Content-Type", "application/json");
     http.addHeader("X-Transmission-Session-Id", _sessionId);
     httpCode = http.POST(payload);
   }
+  metricsObserveRpc(RPC_KIND_ACTION, millis() - rpcStart, httpCode == 200);
 
   if (httpCode == 200) {
     // Toggle was successful, update local state
     _altSpeedEnabled = !_altSpeedEnabled;
-    Serial.println(_altSpeedEnabled ? "Alt Speed ON" : "Alt Speed OFF");
+    LOG_I("rpc", "alt speed %s", _altSpeedEnabled ? "on" : "off");
+    publishStatus();
   }
 
   http.end();
 }
 
 void TransmissionClient::fetchStats() {
-  if (transHost.length() == 0)
+  DaemonConfig cfg = getDaemonConfig(); // Copy, the loop may change it
+  if (cfg.host.length() == 0)
     return;
 
   HTTPClient http;
-  String url = "http://" + transHost + ":" + String(transPort) + transPath;
+  String url = cfg.url();
 
   http.begin(url);
-  if (transUser.length() > 0) {
-    http.setAuthorization(transUser.c_str(), transPass.c_str());
+  if (cfg.user.length() > 0) {
+    http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
   }
   http.addHeader("Content-Type", "application/json");
   if (_sessionId.length() > 0) {
@@ -113,6 +146,7 @@ void TransmissionClient::fetchStats() {
   const char *headerKeys[] = {"X-Transmission-Session-Id"};
   http.collectHeaders(headerKeys, 1);
 
+  unsigned long rpcStart = millis();
   int httpCode = http.POST(payload);
 
   if (httpCode == 409) {
@@ -120,21 +154,26 @@ void TransmissionClient::fetchStats() {
     http.end();
 
     http.begin(url);
-    if (transUser.length() > 0) {
-      http.setAuthorization(transUser.c_str(), transPass.c_str());
+    if (cfg.user.length() > 0) {
+      http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
     }
     http.addHeader("Content-Type", "application/json");
     http.addHeader("X-Transmission-Session-Id", _sessionId);
     httpCode = http.POST(payload);
   }
 
+  String resp;
+  if (httpCode == 200)
+    resp = http.getString();
+  metricsObserveRpc(RPC_KIND_STATS, millis() - rpcStart, httpCode == 200);
+
   if (httpCode == 200) {
-    String resp = http.getString();
     DynamicJsonDocument doc(2048);
     DeserializationError error = deserializeJson(doc, resp);
 
     if (!error && doc["result"] == "success") {
       _connected = true;
+      bootMark(BOOT_RPC);
       _dlSpeed = doc["arguments"]["downloadSpeed"];
       _ulSpeed = doc["arguments"]["uploadSpeed"];
     } else {
@@ -149,8 +188,8 @@ void TransmissionClient::fetchStats() {
   // Now fetch session-get for alt-speed-enabled
   if (_connected) {
     http.begin(url);
-    if (transUser.length() > 0) {
-      http.setAuthorization(transUser.c_str(), transPass.c_str());
+    if (cfg.user.length() > 0) {
+      http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
     }
     http.addHeader("Content-Type", "application/json");
     http.addHeader("X-Transmission-Session-Id", _sessionId);
@@ -158,10 +197,14 @@ void TransmissionClient::fetchStats() {
 
     String payload2 = "{\"method\":\"session-get\",\"arguments\":{\"fields\":["
                       "\"alt-speed-enabled\",\"download-dir-free-space\"]}}";
+    rpcStart = millis();
     int code2 = http.POST(payload2);
+    String resp2;
+    if (code2 == 200)
+      resp2 = http.getString();
+    metricsObserveRpc(RPC_KIND_STATS, millis() - rpcStart, code2 == 200);
 
     if (code2 == 200) {
-      String resp2 = http.getString();
       DynamicJsonDocument doc2(4096); // Larger buffer for full session response
       DeserializationError err2 = deserializeJson(doc2, resp2);
       if (!err2 && doc2["result"] == "success") {
@@ -178,21 +221,58 @@ int TransmissionClient::getTorrentCount() { return _torrentCount; }
 
 TorrentInfo *TransmissionClient::getTorrents() { return _torrents; }
 
-void TransmissionClient::fetchTorrents() {
-  Serial.printf("fetchTorrents: host=%s, connected=%d\n", transHost.c_str(),
-                _connected);
+int TransmissionClient::getFlagCount(TorrentFlag flag) {
+  for (int bit = 0; bit < TORRENT_FLAG_BITS; bit++) {
+    if (flag == (1 << bit))
+      return _flagCounts[bit];
+  }
+  return 0;
+}
+
+// Classify a torrent into every filter bucket it belongs to
+static uint16_t computeTorrentFlags(const TorrentInfo &t) {
+  uint16_t flags = 0;
+  switch (t.status) {
+  case TR_STATUS_DOWNLOAD:
+    flags |= TORRENT_FLAG_DOWNLOADING;
+    break;
+  case TR_STATUS_DOWNLOAD_WAIT:
+    flags |= TORRENT_FLAG_QUEUED_DOWN;
+    break;
+  case TR_STATUS_SEED:
+    flags |= TORRENT_FLAG_SEEDING;
+    break;
+  case TR_STATUS_SEED_WAIT:
+    flags |= TORRENT_FLAG_QUEUED_SEED;
+    break;
+  case TR_STATUS_STOPPED:
+    flags |= TORRENT_FLAG_PAUSED;
+    break;
+  case TR_STATUS_CHECK:
+  case TR_STATUS_CHECK_WAIT:
+    flags |= TORRENT_FLAG_CHECKING;
+    break;
+  }
+  flags |= (t.percentDone >= 1.0) ? TORRENT_FLAG_COMPLETE
+                                  : TORRENT_FLAG_INCOMPLETE;
+  if (t.rateDownload > 0 || t.rateUpload > 0)
+    flags |= TORRENT_FLAG_ACTIVE;
+  return flags;
+}
 
-  if (transHost.length() == 0 || !_connected) {
-    Serial.println("fetchTorrents: SKIPPED (no host or not connected)");
+void TransmissionClient::fetchTorrents() {
+  DaemonConfig cfg = getDaemonConfig();
+  if (cfg.host.length() == 0 || !_connected) {
+    LOG_D("rpc", "torrent-get skipped (no host or not connected)");
     return;
   }
 
   HTTPClient http;
-  String url = "http://" + transHost + ":" + String(transPort) + transPath;
+  String url = cfg.url();
 
   http.begin(url);
-  if (transUser.length() > 0) {
-    http.setAuthorization(transUser.c_str(), transPass.c_str());
+  if (cfg.user.length() > 0) {
+    http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
   }
   http.addHeader("Content-Type", "application/json");
   if (_sessionId.length() > 0) {
@@ -209,28 +289,33 @@ void TransmissionClient::fetchTorrents() {
   const char *headerKeys[] = {"X-Transmission-Session-Id"};
   http.collectHeaders(headerKeys, 1);
 
+  unsigned long rpcStart = millis();
   int httpCode = http.POST(payload);
-  Serial.printf("fetchTorrents: POST httpCode=%d\n", httpCode);
 
   if (httpCode == 409) {
     _sessionId = http.header("X-Transmission-Session-Id");
-    Serial.println("fetchTorrents: Got 409, retrying with new session");
+    LOG_D("rpc", "torrent-get: new session id, retrying");
     http.end();
 
     http.begin(url);
-    if (transUser.length() > 0) {
-      http.setAuthorization(transUser.c_str(), transPass.c_str());
+    if (cfg.user.length() > 0) {
+      http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
     }
     http.addHeader("Content-Type", "application/json");
     http.addHeader("X-Transmission-Session-Id", _sessionId);
     http.setTimeout(3000);
     httpCode = http.POST(payload);
-    Serial.printf("fetchTorrents: Retry httpCode=%d\n", httpCode);
   }
 
+  String resp;
+  if (httpCode == 200)
+    resp = http.getString();
+  metricsObserveRpc(RPC_KIND_TORRENTS, millis() - rpcStart, httpCode == 200);
+
+  if (httpCode != 200)
+    LOG_W("rpc", "torrent-get failed (HTTP %d)", httpCode);
   if (httpCode == 200) {
-    String resp = http.getString();
-    Serial.printf("fetchTorrents: Response len=%d\n", resp.length());
+    LOG_D("rpc", "torrent-get: %u bytes", resp.length());
 
     // Use larger buffer for torrent list (response is ~30KB, need ~2x for
     // ArduinoJson)
@@ -238,37 +323,171 @@ void TransmissionClient::fetchTorrents() {
     DeserializationError error = deserializeJson(doc, resp);
 
     if (error) {
-      Serial.printf("fetchTorrents: JSON parse error: %s\n", error.c_str());
+      LOG_W("rpc", "torrent-get: bad JSON (%s)", error.c_str());
     }
 
     if (!error && doc["result"] == "success") {
-      JsonArray torrents = doc["arguments"]["torrents"];
-      _torrentCount = 0;
-
-      for (JsonObject t : torrents) {
-        if (_torrentCount >= MAX_TORRENTS)
-          break;
-
-        _torrents[_torrentCount].id = t["id"];
-        _torrents[_torrentCount].name = t["name"].as<String>();
-        _torrents[_torrentCount].status = t["status"];
-        _torrents[_torrentCount].percentDone = t["percentDone"];
-        _torrents[_torrentCount].rateDownload = t["rateDownload"];
-        _torrents[_torrentCount].rateUpload = t["rateUpload"];
-        _torrents[_torrentCount].uploadRatio = t["uploadRatio"];
-        _torrents[_torrentCount].bandwidthPriority = t["bandwidthPriority"];
-        _torrentCount++;
-      }
-
-      Serial.printf("Fetched %d torrents\n", _torrentCount);
+      ingestTorrents(doc["arguments"]["torrents"]);
+      LOG_D("rpc", "fetched %d torrents", _torrentCount);
     }
   }
 
   http.end();
 }
 
+void TransmissionClient::fetchTorrentsIfStale(unsigned long maxAgeMs) {
+  if (_snapshotTime != 0 && millis() - _snapshotTime < maxAgeMs)
+    return;
+  fetchTorrents();
+}
+
+template <typename T> static bool updateField(T &field, T value) {
+  if (field == value)
+    return false;
+  field = value;
+  return true;
+}
+
+// Copy a torrent-get reply into the snapshot. Torrents that changed get
+// the next revision; ids that disappeared go to the removal log.
+void TransmissionClient::ingestTorrents(JsonArray torrents) {
+  static int oldIds[MAX_TORRENTS];
+  int oldCount = _torrentCount;
+  for (int i = 0; i < oldCount; i++)
+    oldIds[i] = _torrents[i].id;
+
+  uint32_t rev = _revision + 1;
+  bool changed = false;
+  int count = 0;
+
+  lockTorrents();
+  memset(_flagCounts, 0, sizeof(_flagCounts));
+  for (JsonObject t : torrents) {
+    if (count >= MAX_TORRENTS)
+      break;
+    TorrentInfo &dst = _torrents[count];
+
+    bool dirty = count >= oldCount;
+    dirty |= updateField(dst.id, t["id"].as<int>());
+
+    // Only reallocate the name (and its lowercase search key) when the
+    // torrent in this slot was renamed or replaced
+    const char *name = t["name"] | "";
+    if (strcmp(dst.name.c_str(), name) != 0) {
+      dst.name = name;
+      dst.nameLower = name;
+      dst.nameLower.toLowerCase();
+      dirty = true;
+    }
+    dirty |= updateField(dst.status, t["status"].as<int>());
+    dirty |= updateField(dst.percentDone, t["percentDone"].as<float>());
+    dirty |= updateField(dst.rateDownload, t["rateDownload"].as<long>());
+    dirty |= updateField(dst.rateUpload, t["rateUpload"].as<long>());
+    dirty |= updateField(dst.uploadRatio, t["uploadRatio"].as<float>());
+    dirty |= updateField(dst.bandwidthPriority,
+                         t["bandwidthPriority"].as<int>());
+
+    // Bucket flags follow the fields, so they only change with them
+    if (dirty) {
+      dst.flags = computeTorrentFlags(dst);
+      dst.rev = rev;
+      changed = true;
+    }
+    for (int bit = 0; bit < TORRENT_FLAG_BITS; bit++) {
+      if (dst.flags & (1 << bit))
+        _flagCounts[bit]++;
+    }
+    count++;
+  }
+  _torrentCount = count;
+
+  // Ids are usually in the same slots as last time; search only if not
+  for (int i = 0; i < oldCount; i++) {
+    if (i < count && _torrents[i].id == oldIds[i])
+      continue;
+    bool found = false;
+    for (int j = 0; j < count && !found; j++)
+      found = _torrents[j].id == oldIds[i];
+    if (!found) {
+      logRemoved(oldIds[i], rev);
+      changed = true;
+    }
+  }
+
+  if (changed)
+    _revision = rev;
+  _snapshotTime = millis();
+  _stale = false;
+  unlockTorrents();
+}
+
+void TransmissionClient::restoreSnapshot(int count, long dlSpeed,
+                                         long ulSpeed, long long freeSpace,
+                                         bool altSpeed) {
+  lockTorrents();
+  memset(_flagCounts, 0, sizeof(_flagCounts));
+  for (int i = 0; i < count; i++) {
+    TorrentInfo &t = _torrents[i];
+    t.nameLower = t.name;
+    t.nameLower.toLowerCase();
+    t.flags = computeTorrentFlags(t);
+    t.rev = _revision;
+    for (int bit = 0; bit < TORRENT_FLAG_BITS; bit++) {
+      if (t.flags & (1 << bit))
+        _flagCounts[bit]++;
+    }
+  }
+  _torrentCount = count;
+  _stale = true;
+  unlockTorrents();
+
+  _dlSpeed = dlSpeed;
+  _ulSpeed = ulSpeed;
+  _freeSpace = freeSpace;
+  _altSpeedEnabled = altSpeed;
+}
+
+bool TransmissionClient::isSnapshotStale() { return _stale; }
+
+void TransmissionClient::logRemoved(int id, uint32_t rev) {
+  if (_removedCount == REMOVED_LOG_SIZE) {
+    // Dropping the oldest entry: deltas from before it are no longer exact
+    _removedFloor = _removed[_removedHead].rev;
+  } else {
+    _removedCount++;
+  }
+  _removed[_removedHead].id = id;
+  _removed[_removedHead].rev = rev;
+  _removedHead = (_removedHead + 1) % REMOVED_LOG_SIZE;
+}
+
+uint32_t TransmissionClient::getRevision() { return _revision; }
+
+unsigned long TransmissionClient::getSnapshotTime() { return _snapshotTime; }
+
+// Call with the lock held when not on the loop task
+int TransmissionClient::getRemovedSince(uint32_t since, int *ids, int max) {
+  // Unsigned differences keep this right across wraparound
+  if (since - _removedFloor > _revision - _removedFloor)
+    return -1;
+  int n = 0;
+  for (int i = 0; i < _removedCount && n < max; i++) {
+    const RemovedTorrent &r = _removed[i];
+    if ((int32_t)(r.rev - since) > 0)
+      ids[n++] = r.id;
+  }
+  return n;
+}
+
+void TransmissionClient::lockTorrents() {
+  xSemaphoreTake(_torrentMutex, portMAX_DELAY);
+}
+
+void TransmissionClient::unlockTorrents() { xSemaphoreGive(_torrentMutex); }
+
 void TransmissionClient::toggleTorrentPause(int torrentId) {
-  if (transHost.length() == 0 || !_connected)
+  DaemonConfig cfg = getDaemonConfig();
+  if (cfg.host.length() == 0 || !_connected)
     return;
 
   // Find current status
@@ -284,11 +503,11 @@ void TransmissionClient::toggleTorrentPause(int torrentId) {
     return;
 
   HTTPClient http;
-  String url = "http://" + transHost + ":" + String(transPort) + transPath;
+  String url = cfg.url();
 
   http.begin(url);
-  if (transUser.length() > 0) {
-    http.setAuthorization(transUser.c_str(), transPass.c_str());
+  if (cfg.user.length() > 0) {
+    http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
   }
   http.addHeader("Content-Type", "application/json");
   if (_sessionId.length() > 0) {
@@ -305,6 +524,7 @@ void TransmissionClient::toggleTorrentPause(int torrentId) {
   const char *headerKeys[] = {"X-Transmission-Session-Id"};
   http.collectHeaders(headerKeys, 1);
 
+  unsigned long rpcStart = millis();
   int httpCode = http.POST(payload);
 
   if (httpCode == 409) {
@@ -312,16 +532,17 @@ void TransmissionClient::toggleTorrentPause(int torrentId) {
     http.end();
 
     http.begin(url);
-    if (transUser.length() > 0) {
-      http.setAuthorization(transUser.c_str(), transPass.c_str());
+    if (cfg.user.length() > 0) {
+      http.setAuthorization(cfg.user.c_str(), cfg.pass.c_str());
     }
     http.addHeader("Content-Type", "application/json");
     http.addHeader("X-Transmission-Session-Id", _sessionId);
     httpCode = http.POST(payload);
   }
+  metricsObserveRpc(RPC_KIND_ACTION, millis() - rpcStart, httpCode == 200);
 
   if (httpCode == 200) {
-    Serial.printf("Torrent %d: %s\n", torrentId, method.c_str());
+    LOG_I("rpc", "torrent %d: %s", torrentId, method.c_str());
     // Refresh torrent list
     fetchTorrents();
   }
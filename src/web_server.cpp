@@ -1,14 +1,229 @@
 #include "web_server.h"
-#include "battery_utils.h" // For battery voltage
 #include "config_utils.h"  // For ssid, password, etc.
+#include "battery_utils.h"
+#include "custom_filters.h"
+#include "display_utils.h"
+#include "gui_handler.h"
+#include "live_events.h"
+#include "logger.h"
+#include "metrics.h"
+#include "ota_stream.h"
+#include "power_manager.h"
+#include "profiler.h"
+#include "rpc_proxy.h"
+#include "scheduler.h"
+#include "snapshot_cache.h"
+#include "status_model.h"
+#include "torrent_api.h"
+#include "torrent_list_gui.h" // Filter refresh, list repaint stats
+#include "transmission_client.h"
 #include "web_pages.h"
+#include "wifi_link.h"
+#include "wifi_scan_cache.h"
 #include <HTTPClient.h>
-#include <Update.h>
 #include <WiFi.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+AsyncWebServer server(80);
+
+// Handlers run on the AsyncTCP task, several connections at a time. They
+// must answer quickly and never touch the display: anything that draws or
+// changes UI state is queued for the loop task (runOnLoop), settings
+// changes included (queueSettings), and anything slow runs as a job on the
+// worker task that the browser polls (/job). ESPAsyncWebServer 1.2.x
+// closes each connection after its response, so there is no keep-alive;
+// the dashboard's requests are served side by side instead.
+
+#define WEB_BUDGET_MS 30 // Handler time before it counts as slow
+#define WEB_ACTION_QUEUE_LEN 8
+#define SETTINGS_QUEUE_LEN 4
+#define SETTINGS_DOC_SIZE 1536
+#define MAX_WEB_JOBS 4
+#define WEB_JOB_ARGS 5
+#define WEB_JOB_KEEP_MS 60000 // Finished results stay pollable this long
+#define RESTART_DELAY_MS 1000 // Lets the response reach the client
+#define TORRENT_API_MAX_AGE_MS 3000 // Older snapshots are refetched
+
+// --- Loop-side actions ---
+
+typedef void (*WebAction)();
+static QueueHandle_t webActions = nullptr;
+
+static bool runOnLoop(WebAction fn) {
+  if (xQueueSend(webActions, &fn, 0) != pdTRUE) {
+    LOG_W("web", "action queue full");
+    return false;
+  }
+  schedPost(EVENT_WEB);
+  return true;
+}
+
+// Settings changes, as JSON in the config export format. Other tasks read
+// the settings, so only the loop task changes them (see config_utils.h).
+static QueueHandle_t settingsQueue = nullptr;
+
+static bool queueSettings(const JsonDocument &changes) {
+  String *json = new String();
+  serializeJson(changes, *json);
+  if (xQueueSend(settingsQueue, &json, 0) != pdTRUE) {
+    delete json;
+    LOG_W("web", "settings queue full");
+    return false;
+  }
+  schedPost(EVENT_WEB);
+  return true;
+}
+
+static void applySettings();
+
+void processWebActions() {
+  WebAction fn;
+  while (xQueueReceive(webActions, &fn, 0) == pdTRUE) {
+    fn();
+  }
+  applySettings();
+}
+
+static int restartJob = -1;
+
+static void restartNow() {
+  flushConfig(); // Saves are deferred; don't lose the one that came with us
+  LOG_I("web", "restarting");
+  logFlush(500);
+  ESP.restart();
+}
+
+static void armRestart() { schedRunIn(restartJob, RESTART_DELAY_MS); }
+
+// One refresh in flight at a time, however many clients poll
+static volatile bool torrentRefreshQueued = false;
+
+static void refreshTorrents() {
+  torrentRefreshQueued = false;
+  PROFILE_SCOPE(PROF_FETCH);
+  transmission.fetchTorrentsIfStale(TORRENT_API_MAX_AGE_MS);
+}
+
+// --- Worker jobs ---
+
+enum WebJobState : uint8_t { JOB_FREE, JOB_QUEUED, JOB_RUNNING, JOB_DONE };
+
+typedef String (*WebJobFn)(const String *args);
+
+struct WebJob {
+  uint16_t id;
+  WebJobState state;
+  WebJobFn fn;
+  String args[WEB_JOB_ARGS];
+  String result;
+  unsigned long doneMs;
+};
+
+static WebJob webJobs[MAX_WEB_JOBS];
+static uint16_t nextJobId = 1;
+static SemaphoreHandle_t jobMutex = nullptr;
+static QueueHandle_t jobQueue = nullptr;
+
+static void webJobTask(void *) {
+  int slot;
+  for (;;) {
+    if (xQueueReceive(jobQueue, &slot, portMAX_DELAY) != pdTRUE)
+      continue;
+    WebJob &job = webJobs[slot];
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    job.state = JOB_RUNNING;
+    WebJobFn fn = job.fn;
+    String args[WEB_JOB_ARGS];
+    for (int i = 0; i < WEB_JOB_ARGS; i++)
+      args[i] = job.args[i];
+    xSemaphoreGive(jobMutex);
+
+    String result = fn(args);
+
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    job.result = result;
+    job.state = JOB_DONE;
+    job.doneMs = millis();
+    xSemaphoreGive(jobMutex);
+  }
+}
+
+// Queue fn(args) on the worker. Returns the job id, or 0 when busy.
+static uint16_t startWebJob(WebJobFn fn, const String *args, int argCount) {
+  uint16_t id = 0;
+  xSemaphoreTake(jobMutex, portMAX_DELAY);
+  int slot = -1;
+  for (int i = 0; i < MAX_WEB_JOBS && slot < 0; i++) {
+    if (webJobs[i].state == JOB_FREE ||
+        (webJobs[i].state == JOB_DONE &&
+         millis() - webJobs[i].doneMs > WEB_JOB_KEEP_MS))
+      slot = i;
+  }
+  if (slot >= 0) {
+    WebJob &job = webJobs[slot];
+    id = job.id = nextJobId++;
+    if (nextJobId == 0)
+      nextJobId = 1;
+    job.state = JOB_QUEUED;
+    job.fn = fn;
+    for (int i = 0; i < WEB_JOB_ARGS; i++)
+      job.args[i] = i < argCount ? args[i] : String();
+    job.result = "";
+    if (xQueueSend(jobQueue, &slot, 0) != pdTRUE) {
+      job.state = JOB_FREE;
+      id = 0;
+    }
+  }
+  xSemaphoreGive(jobMutex);
+  return id;
+}
+
+// --- Helpers ---
+
+static uint32_t webSlowCount = 0;
+static uint32_t webMaxMs = 0;
+static const char *webSlowestRoute = "";
+
+ArRequestHandlerFunction webTimed(const char *path,
+                                  ArRequestHandlerFunction fn) {
+  return [path, fn](AsyncWebServerRequest *request) {
+    unsigned long start = millis();
+    fn(request);
+    uint32_t ms = millis() - start;
+    if (ms > webMaxMs) {
+      webMaxMs = ms;
+      webSlowestRoute = path;
+    }
+    if (ms > WEB_BUDGET_MS) {
+      webSlowCount++;
+      LOG_W("web", "%s took %lu ms", path, (unsigned long)ms);
+    }
+  };
+}
+
+// Register a route with its handler time checked against the budget
+static void route(const char *path, WebRequestMethodComposite method,
+                  ArRequestHandlerFunction fn) {
+  server.on(path, method, webTimed(path, fn));
+}
 
-WebServer server(80);
+static void sendJson(AsyncWebServerRequest *request,
+                     const JsonDocument &doc) {
+  AsyncResponseStream *response =
+      request->beginResponseStream("application/json");
+  serializeJson(doc, *response);
+  request->send(response);
+}
 
-extern int otaProgress;
+static void sendNoCache(AsyncWebServerRequest *request,
+                        AsyncWebServerResponse *response) {
+  response->addHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+  response->addHeader("Pragma", "no-cache");
+  response->addHeader("Expires", "-1");
+  request->send(response);
+}
 
 const char *update_html = R"(
 <!DOCTYPE html>
@@ -20,235 +235,319 @@ body { font-family: sans-serif; padding: 20px; background: #222; color: #fff; te
 form { background: #333; padding: 20px; border-radius: 8px; display: inline-block; }
 input { padding: 10px; margin: 10px 0; width: 100%; box-sizing: border-box; }
 input[type=submit] { background: #d35400; color: white; border: none; cursor: pointer; font-weight: bold; }
+p { color: #aaa; font-size: 0.9em; }
 </style>
 </head>
 <body>
 <h1>Firmware Update</h1>
 <form id='upload_form' method='POST' action='/update' enctype='multipart/form-data'>
-<input type='file' name='update' id='file_input'>
+<input type='file' name='update' id='file_input' multiple accept='.bin,.gz,.json'>
+<p>Pick firmware.bin.gz together with firmware.json to upload less and verify the image.</p>
 <input type='submit' value='Update' id='update_btn'>
 </form>
 <script>
 var form = document.getElementById('upload_form');
-form.onsubmit = function(event) {
-  event.preventDefault();
-  var fileInput = document.getElementById('file_input');
-  var file = fileInput.files[0];
-  if (!file) return;
+var btn = document.getElementById('update_btn');
+function upload(file, manifest) {
+  var url = '/update';
+  if (manifest) {
+    url += '?size=' + manifest.size + '&sha256=' + encodeURIComponent(manifest.sha256);
+  }
   var formData = new FormData();
   formData.append('update', file);
   var xhr = new XMLHttpRequest();
-  xhr.open('POST', '/update', true);
+  xhr.open('POST', url, true);
   xhr.upload.onprogress = function(e) {
     if (e.lengthComputable) {
       var percent = Math.round((e.loaded / e.total) * 100);
-      document.getElementById('update_btn').value = '[' + percent + '%] Uploading...'; 
-      document.getElementById('update_btn').style.backgroundColor = '#2980b9'; // Change color to blue
+      btn.value = '[' + percent + '%] Uploading...';
+      btn.style.backgroundColor = '#2980b9'; // Change color to blue
     }
   };
   xhr.onload = function() {
     if (xhr.status === 200) {
       document.body.innerHTML = '<h1>' + xhr.responseText + '</h1>';
     } else {
-      document.getElementById('update_btn').value = 'Failed';
+      btn.value = 'Failed: ' + xhr.responseText;
     }
   };
   xhr.send(formData);
+}
+form.onsubmit = function(event) {
+  event.preventDefault();
+  var files = document.getElementById('file_input').files;
+  var image = null, manifestFile = null;
+  for (var i = 0; i < files.length; i++) {
+    if (/\.json$/i.test(files[i].name)) manifestFile = files[i];
+    else image = files[i];
+  }
+  if (!image) return;
+  if (!manifestFile) { upload(image, null); return; }
+  var reader = new FileReader();
+  reader.onload = function() {
+    var manifest;
+    try { manifest = JSON.parse(reader.result); } catch (e) { btn.value = 'Bad manifest'; return; }
+    upload(image, manifest);
+  };
+  reader.readAsText(manifestFile);
 };
 </script>
 </body>
 </html>
 )";
 
-void handleUpdate() {
-  server.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server.sendHeader("Pragma", "no-cache");
-  server.sendHeader("Expires", "-1");
-  server.send(200, "text/html", update_html);
+void handleUpdate(AsyncWebServerRequest *request) {
+  sendNoCache(request, request->beginResponse(200, "text/html", update_html));
 }
 
-void handleUpdateUpload() {
-  server.send(200, "text/plain",
-              (Update.hasError()) ? "Update Failed"
-                                  : "Update Success! Rebooting...");
-  delay(1000); // Give time for the client to receive the response
-  ESP.restart();
-}
+// The upload that owns the OTA stream; others are turned away
+static AsyncWebServerRequest *otaRequest = nullptr;
 
-void handleUpdateMultipart() {
-  HTTPUpload &upload = server.upload();
-  if (upload.status == UPLOAD_FILE_START) {
-    Serial.printf("Update: %s\n", upload.filename.c_str());
-    currentState = STATE_OTA; // Trigger UI update
-    otaProgress = 0;
-    drawStatusBar(); // Force initial draw
+// Screen the upload interrupted, restored if it fails
+static State preOtaState = STATE_CONNECTED;
 
-    if (!Update.begin(UPDATE_SIZE_UNKNOWN)) { // start with max available size
-      Update.printError(Serial);
-    }
-  } else if (upload.status == UPLOAD_FILE_WRITE) {
-    if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
-      Update.printError(Serial);
-    } else {
-      // Calculate progress
-      // Use Content-Length header if available
-      size_t total = 0;
-      if (server.hasHeader("Content-Length")) {
-        total = server.header("Content-Length").toInt();
-      }
+// Loop side of an upload start. The bar itself is drawn by the status bar
+// job as the progress in the status model moves.
+static void enterOtaScreen() {
+  powerNoteActivity();
+  if (currentState != STATE_OTA)
+    preOtaState = currentState;
+  currentState = STATE_OTA;
+  statusInvalidate(SB_EXTRAS); // Left slot switches to the OTA label
+}
 
-      if (total > 0) {
-        int p = (int)((float)Update.progress() / (float)total * 100.0);
-        if (p > 100)
-          p = 100;
+// Loop side of a failed or aborted upload
+static void leaveOtaScreen() {
+  if (currentState != STATE_OTA)
+    return;
+  currentState = preOtaState;
+  statusInvalidate(SB_ALL);
+  drawStatusBar();
+  if (currentState == STATE_CONNECTED)
+    drawDashboard(); // List refreshes were held back during the upload
+}
 
-        if (p != otaProgress) {
-          otaProgress = p;
-          Serial.printf("OTA Progress: %d%%\n", otaProgress);
-          drawStatusBar();
-        }
+void handleUpdateUpload(AsyncWebServerRequest *request) {
+  if (request != otaRequest) {
+    request->send(otaStreamActive() ? 409 : 400, "text/plain",
+                  otaStreamActive() ? "Another update is in progress"
+                                    : "No firmware in the request");
+    return;
+  }
+  otaRequest = nullptr;
+  const char *error = otaStreamError();
+  if (error[0] != '\0') {
+    request->send(500, "text/plain", String("Update Failed: ") + error);
+    runOnLoop(leaveOtaScreen);
+    return;
+  }
+  request->send(200, "text/plain", "Update Success! Rebooting...");
+  runOnLoop(armRestart);
+}
+
+// Runs on the AsyncTCP task per received chunk. A manifest passed as
+// ?size=&sha256= is checked before the new image is made bootable.
+// Progress only goes into the status model; the loop draws it.
+void handleUpdateMultipart(AsyncWebServerRequest *request,
+                           const String &filename, size_t index,
+                           uint8_t *data, size_t len, bool final) {
+  if (index == 0) {
+    if (otaStreamActive())
+      return; // otaRequest's upload keeps going
+    LOG_I("ota", "upload %s", filename.c_str());
+    otaRequest = request;
+    request->onDisconnect([request]() {
+      if (otaRequest == request) {
+        otaStreamAbort(); // Client went away mid-upload
+        otaRequest = nullptr;
+        runOnLoop(leaveOtaScreen);
       }
-    }
-  } else if (upload.status == UPLOAD_FILE_END) {
-    if (Update.end(true)) { // true to set the size to the current progress
-      Serial.printf("Update Success: %u\nRebooting...\n", upload.totalSize);
-      otaProgress = 100;
-      drawStatusBar();
-    } else {
-      Update.printError(Serial);
-    }
+    });
+
+    size_t imageSize = 0;
+    String sha256;
+    if (request->hasParam("size"))
+      imageSize = request->getParam("size")->value().toInt();
+    if (request->hasParam("sha256"))
+      sha256 = request->getParam("sha256")->value();
+
+    statusSetOta(0);
+    runOnLoop(enterOtaScreen);
+    otaStreamBegin(imageSize, sha256.c_str(), request->contentLength());
+  }
+  if (request != otaRequest)
+    return;
+
+  if (len > 0 && otaStreamWrite(data, len)) {
+    int p = otaStreamProgress();
+    if (statusSetOta(p))
+      LOG_D("ota", "%d%%", p);
   }
+
+  if (final && otaStreamEnd())
+    statusSetOta(100);
 }
 
 // Forward declarations
-void handleRoot();
-void handleScanWifi();
-void handleScan();
-void handleSave();
-void handleReset();
-void handleRestart();
-void handleStatus();
-void handleGetParams();
-void handleSaveParams();
-void handleTestTransmission();
+void handleRoot(AsyncWebServerRequest *request);
+void handleScanWifi(AsyncWebServerRequest *request);
+void handleScan(AsyncWebServerRequest *request);
+void handleSave(AsyncWebServerRequest *request);
+void handleReset(AsyncWebServerRequest *request);
+void handleRestart(AsyncWebServerRequest *request);
+void handleStatus(AsyncWebServerRequest *request);
+void handleGetParams(AsyncWebServerRequest *request);
+void handleSaveParams(AsyncWebServerRequest *request);
+void handleTestTransmission(AsyncWebServerRequest *request);
+void handleJob(AsyncWebServerRequest *request);
+void handleGetFilters(AsyncWebServerRequest *request);
+void handleSaveFilters(AsyncWebServerRequest *request);
+void handlePerf(AsyncWebServerRequest *request);
+void handlePower(AsyncWebServerRequest *request);
+void handleTorrents(AsyncWebServerRequest *request);
+void handleConfigExport(AsyncWebServerRequest *request);
+void handleConfigImport(AsyncWebServerRequest *request);
 
 // ...
 void setupServerRoutes() {
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/scan_wifi", HTTP_GET, handleScanWifi); // JSON handler
-  server.on("/scan", HTTP_GET, handleScan);          // HTML Page
-  server.on("/save", HTTP_POST, handleSave);
-  server.on("/reset", HTTP_POST, handleReset);
-  server.on("/restart", HTTP_POST, handleRestart);
-  server.on("/status", HTTP_GET, handleStatus);
-  server.on("/get_params", HTTP_GET, handleGetParams);
-  server.on("/save_params", HTTP_POST, handleSaveParams);
-  server.on("/test_transmission", HTTP_POST, handleTestTransmission);
+  webActions = xQueueCreate(WEB_ACTION_QUEUE_LEN, sizeof(WebAction));
+  settingsQueue = xQueueCreate(SETTINGS_QUEUE_LEN, sizeof(String *));
+  jobMutex = xSemaphoreCreateMutex();
+  jobQueue = xQueueCreate(MAX_WEB_JOBS, sizeof(int));
+  xTaskCreatePinnedToCore(webJobTask, "WebJobs", 8192, NULL, 1, NULL, 0);
+  restartJob = schedAddJob("reboot", 0, restartNow);
+
+  route("/", HTTP_GET, handleRoot);
+  route("/scan_wifi", HTTP_GET, handleScanWifi); // JSON handler
+  route("/scan", HTTP_GET, handleScan);          // HTML Page
+  route("/save", HTTP_POST, handleSave);
+  route("/reset", HTTP_POST, handleReset);
+  route("/restart", HTTP_POST, handleRestart);
+  route("/status", HTTP_GET, handleStatus);
+  route("/get_params", HTTP_GET, handleGetParams);
+  route("/save_params", HTTP_POST, handleSaveParams);
+  route("/config/export", HTTP_GET, handleConfigExport);
+  route("/config/import", HTTP_POST, handleConfigImport);
+  route("/test_transmission", HTTP_POST, handleTestTransmission);
+  route("/job", HTTP_GET, handleJob);
+  route("/get_filters", HTTP_GET, handleGetFilters);
+  route("/save_filters", HTTP_POST, handleSaveFilters);
+  route("/perf", HTTP_GET, handlePerf);
+  route("/power", HTTP_GET, handlePower);
+  route("/api/torrents", HTTP_GET, handleTorrents); // Also /api/torrents/<id>
+  setupLiveEvents(server);                           // /events, SSE push
+  setupRpcProxy(server);  // /transmission/rpc
+  setupMetrics(server);   // /metrics, Prometheus text format
+  setupLogRoutes(server); // /logs, ring buffer as text
 
   // Firmware Update Handlers
-  const char *headerKeys[] = {"Content-Length"};
-  server.collectHeaders(headerKeys, 1);
-  server.on("/update", HTTP_GET, handleUpdate);
+  route("/update", HTTP_GET, handleUpdate);
   server.on("/update", HTTP_POST, handleUpdateUpload, handleUpdateMultipart);
-}
 
-// Scan handler that returns JSON for web_pages.h JS
-void handleScanWifi() {
-  Serial.println("Hit /scan_wifi");
+  server.onNotFound([](AsyncWebServerRequest *request) {
+    request->send(404, "text/plain", "Not found");
+  });
+}
 
-  // Ensure WiFi mode allows scanning (needs STA component)
-  wifi_mode_t currentMode = WiFi.getMode();
-  if (currentMode == WIFI_MODE_AP) {
-    Serial.println("Web Scan: Switching to AP_STA mode for scanning");
-    WiFi.mode(WIFI_AP_STA);
-    delay(100); // Give time for mode switch
+// Networks from the scan cache, returned immediately. ?refresh=1 starts a
+// new background scan; the page polls until results arrive.
+void handleScanWifi(AsyncWebServerRequest *request) {
+  if (request->hasArg("refresh")) {
+    runOnLoop(scanCacheRequest);
   }
+  DynamicJsonDocument doc(3072);
+  fillScanCacheJson(doc.to<JsonArray>());
+  AsyncResponseStream *response =
+      request->beginResponseStream("application/json");
+  response->addHeader("X-Scanning",
+                      isScanCacheBusy() || request->hasArg("refresh") ? "1"
+                                                                      : "0");
+  serializeJson(doc, *response);
+  request->send(response);
+}
 
-  int n = WiFi.scanNetworks();
-  Serial.printf("Scanned %d networks\n", n);
-  DynamicJsonDocument doc(2048);
-  JsonArray array = doc.to<JsonArray>();
-
-  if (n > 0) {
-    for (int i = 0; i < n; ++i) {
-      JsonObject obj = array.createNestedObject();
-      obj["ssid"] = WiFi.SSID(i);
-      obj["rssi"] = WiFi.RSSI(i);
-      obj["secure"] = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
-    }
+// The dashboard is static and gzipped at build time, so it goes out of
+// flash as-is. Device values are filled in by the page from /status.
+void handleRoot(AsyncWebServerRequest *request) {
+  if (request->hasHeader("If-None-Match") &&
+      request->getHeader("If-None-Match")->value() == dashboard_etag) {
+    request->send(304);
+    return;
   }
-
-  WiFi.scanDelete();
-  String json;
-  serializeJson(doc, json);
-  server.send(200, "application/json", json);
+  AsyncWebServerResponse *response = request->beginResponse_P(
+      200, "text/html", dashboard_html_gz, dashboard_html_gz_len);
+  response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("ETag", dashboard_etag);
+  // Revalidate every time; a firmware update changes the ETag
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
 }
 
-void handleRoot() {
-  // Fix 1: Add Cache-Control headers
-  server.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server.sendHeader("Pragma", "no-cache");
-  server.sendHeader("Expires", "-1");
-
-  String page = dashboard_html;
+// Answered from the cached snapshot right away. A stale snapshot is
+// refetched on the loop task, ready for the client's next poll.
+void handleTorrents(AsyncWebServerRequest *request) {
+  unsigned long taken = transmission.getSnapshotTime();
+  if ((taken == 0 || millis() - taken > TORRENT_API_MAX_AGE_MS) &&
+      !torrentRefreshQueued) {
+    torrentRefreshQueued = runOnLoop(refreshTorrents);
+  }
 
-  if (WiFi.getMode() == WIFI_AP || WiFi.getMode() == WIFI_AP_STA) {
-    page.replace("%MODE%", "AP");
-    page.replace("%IP%", WiFi.softAPIP().toString());
+  const String &url = request->url();
+  int slash = url.indexOf('/', strlen("/api/torrents"));
+  if (slash >= 0 && slash + 1 < (int)url.length()) {
+    sendTorrent(request, url.substring(slash + 1).toInt());
   } else {
-    page.replace("%MODE%", "STA");
-    page.replace("%IP%", WiFi.localIP().toString());
+    sendTorrentList(request);
   }
-
-  // Common Replacements
-  page.replace("%SSID%",
-               (WiFi.getMode() == WIFI_STA) ? WiFi.SSID() : "ODROID-AP");
-  page.replace("%RSSI%",
-               (WiFi.getMode() == WIFI_STA) ? String(WiFi.RSSI()) : "0");
-  page.replace("%MAC%", WiFi.macAddress());
-  page.replace("%VERSION%", VERSION);
-  page.replace("%BUILD_DATE%", __DATE__ " " __TIME__);
-
-  server.send(200, "text/html", page);
 }
 
 // /scan endpoint was previously serving index_html.
 // Since we unified the UI, we can redirect /scan to / or remove it.
 // However, to avoid broken links if any, let's redirect to root.
-void handleScan() {
-  server.sendHeader("Location", "/", true);
-  server.send(302, "text/plain", "");
+void handleScan(AsyncWebServerRequest *request) { request->redirect("/"); }
+
+// Settings that don't fit the stored record are refused, never cut
+static bool argTooLong(AsyncWebServerRequest *request, const char *name,
+                       size_t max) {
+  if (!request->hasArg(name) || request->arg(name).length() <= max)
+    return false;
+  request->send(400, "text/plain",
+                String(name) + " is too long (max " + String(max) +
+                    " bytes)");
+  return true;
 }
 
-void handleSave() {
-  if (server.hasArg("ssid") && server.hasArg("password")) {
-    ssid = server.arg("ssid");
-    password = server.arg("password");
-    saveConfig();
-    String response = "Saved. Restarting...";
-    server.send(200, "text/plain", response);
-    delay(1000);
-    ESP.restart();
+void handleSave(AsyncWebServerRequest *request) {
+  if (argTooLong(request, "ssid", CONFIG_SSID_MAX) ||
+      argTooLong(request, "password", CONFIG_PASSWORD_MAX))
+    return;
+  if (request->hasArg("ssid") && request->hasArg("password")) {
+    DynamicJsonDocument changes(512);
+    changes["ssid"] = request->arg("ssid");
+    changes["password"] = request->arg("password");
+    changes["restart"] = true;
+    if (!queueSettings(changes)) {
+      request->send(503, "text/plain", "Busy, try again");
+      return;
+    }
+    request->send(200, "text/plain", "Saved. Restarting...");
   } else {
-    server.send(400, "text/plain", "Missing ssid or password");
+    request->send(400, "text/plain", "Missing ssid or password");
   }
 }
 
-void handleReset() {
+void handleReset(AsyncWebServerRequest *request) {
   deleteConfig();
-  String response = "Configuration deleted. Restarting...";
-  server.send(200, "text/plain", response);
-  delay(1000);
-  ESP.restart();
+  request->send(200, "text/plain", "Configuration deleted. Restarting...");
+  runOnLoop(armRestart);
 }
 
-void handleRestart() {
-  server.send(200, "text/plain", "Restarting...");
-  delay(1000);
-  ESP.restart();
+void handleRestart(AsyncWebServerRequest *request) {
+  request->send(200, "text/plain", "Restarting...");
+  runOnLoop(armRestart);
 }
 
-void handleStatus() {
+void handleStatus(AsyncWebServerRequest *request) {
   DynamicJsonDocument doc(512); // Increased size
   doc["rssi"] = WiFi.RSSI();
   doc["ip"] = WiFi.localIP().toString();
@@ -261,24 +560,37 @@ void handleStatus() {
 
   if (isAPMode) {
     doc["mode"] = "AP";
+    lockConfig();
     doc["ap_ssid"] = apSSID;
     doc["ap_password"] = apPassword;
+    unlockConfig();
     doc["ip"] = WiFi.softAPIP().toString(); // Correct IP for AP mode
   } else {
     doc["mode"] = "STA";
+    doc["ssid"] = WiFi.SSID();
   }
+  doc["mac"] = WiFi.macAddress();
+  doc["version"] = VERSION;
+  doc["build"] = __DATE__ " " __TIME__;
 
   // Battery
-  float battV = getBatteryVoltage();
-  doc["batt"] = battV;
+  BatteryReading batt = getBatteryReading();
+  doc["batt"] = batt.volts;
+  doc["batt_pct"] = batt.percent;
+  doc["batt_min"] = batt.minutesLeft; // -1: charging or still learning
 
-  String json;
-  serializeJson(doc, json);
-  server.send(200, "application/json", json);
+  // Display: cost of the last torrent list refresh
+  doc["list_bytes"] = getTorrentListRefreshBytes();
+  doc["list_us"] = getTorrentListRedrawMicros();
+  doc["list_dma"] = isTorrentListUsingDma();
+
+  sendJson(request, doc);
 }
 
-void handleGetParams() {
-  DynamicJsonDocument doc(512);
+
+void handleGetParams(AsyncWebServerRequest *request) {
+  DynamicJsonDocument doc(1024);
+  lockConfig();
   doc["host"] = transHost;
   doc["port"] = transPort;
   doc["path"] = transPath;
@@ -287,57 +599,135 @@ void handleGetParams() {
   doc["ap_ssid"] = apSSID;
   doc["ap_password"] = apPassword;
   doc["brightness"] = brightness;
-  String json;
-  serializeJson(doc, json);
-  server.send(200, "application/json", json);
-}
-
-void handleSaveParams() {
-  if (server.hasArg("host"))
-    transHost = server.arg("host");
-  if (server.hasArg("port"))
-    transPort = server.arg("port").toInt();
-  if (server.hasArg("path"))
-    transPath = server.arg("path");
-  if (server.hasArg("user"))
-    transUser = server.arg("user");
-  if (server.hasArg("pass"))
-    transPass = server.arg("pass");
-  bool apChanged = false;
-  if (server.hasArg("ap_ssid")) {
-    String newApSSID = server.arg("ap_ssid");
-    if (newApSSID != apSSID) {
-      apSSID = newApSSID;
-      apChanged = true;
-    }
+  doc["dim_s"] = dimTimeout;
+  doc["blank_s"] = blankTimeout;
+  doc["pwr_save"] = powerSave;
+  doc["rpc_proxy"] = rpcProxy;
+  doc["ip_static"] = staticIp;
+  doc["ip_addr"] = staticAddr;
+  doc["ip_gw"] = staticGateway;
+  doc["ip_mask"] = staticMask;
+  doc["ip_dns"] = staticDns;
+  unlockConfig();
+  fillWifiLeaseJson(doc.createNestedObject("lease"));
+  sendJson(request, doc);
+}
+
+// All settings as a JSON file download, secrets included
+void handleConfigExport(AsyncWebServerRequest *request) {
+  DynamicJsonDocument doc(1024);
+  exportConfigJson(doc.to<JsonObject>());
+  AsyncResponseStream *response =
+      request->beginResponseStream("application/json");
+  response->addHeader("Content-Disposition",
+                      "attachment; filename=\"odroid-config.json\"");
+  serializeJson(doc, *response);
+  request->send(response);
+}
+
+// Settings from an exported file (form field "config"). Keys that are
+// missing keep their current value; Wi-Fi changes apply after the restart.
+void handleConfigImport(AsyncWebServerRequest *request) {
+  if (!request->hasArg("config")) {
+    request->send(400, "text/plain", "Missing config");
+    return;
   }
-  if (server.hasArg("ap_password")) {
-    String newApPass = server.arg("ap_password");
-    if (newApPass != apPassword) {
-      apPassword = newApPass;
-      apChanged = true;
-    }
+  DynamicJsonDocument doc(1536);
+  DeserializationError err = deserializeJson(doc, request->arg("config"));
+  if (err || !doc.is<JsonObject>()) {
+    request->send(400, "text/plain", "Not a config file");
+    return;
+  }
+  const char *tooLong = configJsonTooLong(doc.as<JsonObject>());
+  if (tooLong) {
+    request->send(400, "text/plain", String(tooLong) + " is too long");
+    return;
   }
-  if (server.hasArg("brightness")) {
-    brightness = server.arg("brightness").toInt();
-    setBrightness(brightness);
+  doc["restart"] = true;
+  if (doc.overflowed() || !queueSettings(doc)) {
+    request->send(503, "text/plain", "Busy, try again");
+    return;
   }
+  request->send(200, "text/plain", "Imported. Restarting...");
+}
 
-  saveConfig();
-  server.send(200, "text/plain", "Saved params");
-  delay(100); // Give time for response to flush
+static void applyApSettings() {
+  startSoftAp();
+  LOG_I("web", "AP settings updated");
+}
 
-  // Apply AP changes immediately if in AP or AP_STA mode
-  if (apChanged) {
-    if (apPassword.length() >= 8) {
-      WiFi.softAP(apSSID.c_str(), apPassword.c_str());
-    } else {
-      WiFi.softAP(apSSID.c_str());
+// Applies queued settings changes (loop task). A "restart" member
+// restarts once the change is saved.
+static void applySettings() {
+  String *json;
+  while (xQueueReceive(settingsQueue, &json, 0) == pdTRUE) {
+    DynamicJsonDocument changes(SETTINGS_DOC_SIZE);
+    DeserializationError err = deserializeJson(changes, *json);
+    delete json;
+    if (err) {
+      LOG_E("web", "settings change lost (%s)", err.c_str());
+      continue;
     }
-    Serial.println("AP Settings updated via WebUI");
+    String oldApSSID = apSSID;
+    String oldApPassword = apPassword;
+    importConfigJson(changes.as<JsonObject>());
+    saveConfig();
+    applyPowerSettings(); // Brightness and idle timers
+    if (changes["restart"] | false)
+      armRestart();
+    else if (apSSID != oldApSSID || apPassword != oldApPassword)
+      applyApSettings(); // Restarting the AP drops the client's connection
   }
 }
 
+void handleSaveParams(AsyncWebServerRequest *request) {
+  if (argTooLong(request, "host", CONFIG_HOST_MAX) ||
+      argTooLong(request, "path", CONFIG_PATH_MAX) ||
+      argTooLong(request, "user", CONFIG_USER_MAX) ||
+      argTooLong(request, "pass", CONFIG_PASSWORD_MAX) ||
+      argTooLong(request, "ap_ssid", CONFIG_SSID_MAX) ||
+      argTooLong(request, "ap_password", CONFIG_PASSWORD_MAX) ||
+      argTooLong(request, "ip_addr", CONFIG_IP_MAX) ||
+      argTooLong(request, "ip_gw", CONFIG_IP_MAX) ||
+      argTooLong(request, "ip_mask", CONFIG_IP_MAX) ||
+      argTooLong(request, "ip_dns", CONFIG_IP_MAX))
+    return;
+
+  // Form fields and the config keys they set
+  static const char *const textFields[][2] = {
+      {"host", "t_host"},       {"path", "t_path"},
+      {"user", "t_user"},       {"pass", "t_pass"},
+      {"ap_ssid", "ap_ssid"},   {"ap_password", "ap_password"},
+      {"ip_addr", "ip_addr"},   {"ip_gw", "ip_gw"},
+      {"ip_mask", "ip_mask"},   {"ip_dns", "ip_dns"}};
+  DynamicJsonDocument changes(SETTINGS_DOC_SIZE);
+  for (const auto &f : textFields) {
+    if (request->hasArg(f[0]))
+      changes[f[1]] = request->arg(f[0]);
+  }
+  if (request->hasArg("port"))
+    changes["t_port"] = request->arg("port").toInt();
+  if (request->hasArg("brightness"))
+    changes["brightness"] = request->arg("brightness").toInt();
+  if (request->hasArg("dim_s"))
+    changes["dim_s"] = max(0L, request->arg("dim_s").toInt());
+  if (request->hasArg("blank_s"))
+    changes["blank_s"] = max(0L, request->arg("blank_s").toInt());
+  if (request->hasArg("pwr_save"))
+    changes["pwr_save"] = request->arg("pwr_save") == "1";
+  if (request->hasArg("rpc_proxy"))
+    changes["rpc_proxy"] = request->arg("rpc_proxy") == "1";
+  // Static IP profile: used from the next connect on
+  if (request->hasArg("ip_static"))
+    changes["ip_static"] = request->arg("ip_static") == "1";
+
+  if (changes.overflowed() || !queueSettings(changes)) {
+    request->send(503, "text/plain", "Busy, try again");
+    return;
+  }
+  request->send(200, "text/plain", "Saved params");
+}
+
 String formatSpeed(long bytes) {
   if (bytes < 1024)
     return String(bytes) + " B/s";
@@ -354,7 +744,7 @@ String testTransmission(const String &host, int port, const String &path,
 
   HTTPClient http;
   String url = "http://" + host + ":" + String(port) + path;
-  Serial.println("Testing: " + url);
+  LOG_I("web", "testing %s", url.c_str());
 
   // 1. Prepare Request to catch CSRF Token
   http.begin(url);
@@ -375,7 +765,7 @@ String testTransmission(const String &host, int port, const String &path,
   // 2. Handle CSRF (409)
   if (httpCode == 409) {
     sessionId = http.header("X-Transmission-Session-Id");
-    Serial.println("Got CSRF Token: " + sessionId);
+    LOG_D("web", "test: session id %s", sessionId.c_str());
     http.end(); // Close first connection
 
     // Retry with Token
@@ -422,13 +812,130 @@ String testTransmission(const String &host, int port, const String &path,
   return result;
 }
 
-void handleTestTransmission() {
-  String t_host = server.arg("host");
-  int t_port = server.arg("port").toInt();
-  String t_path = server.arg("path");
-  String t_user = server.arg("user");
-  String t_pass = server.arg("pass");
+static String testTransmissionJob(const String *args) {
+  return testTransmission(args[0], args[1].toInt(), args[2], args[3],
+                          args[4]);
+}
+
+// The RPC (with its 409 retry) takes up to several seconds, so it runs on
+// the worker. Replies 202 with a job id for /job.
+void handleTestTransmission(AsyncWebServerRequest *request) {
+  String args[WEB_JOB_ARGS] = {request->arg("host"), request->arg("port"),
+                               request->arg("path"), request->arg("user"),
+                               request->arg("pass")};
+  uint16_t id = startWebJob(testTransmissionJob, args, WEB_JOB_ARGS);
+  if (id == 0) {
+    request->send(503, "text/plain", "Busy, try again");
+    return;
+  }
+  request->send(202, "application/json", "{\"job\":" + String(id) + "}");
+}
+
+// Poll a worker job: {"state":"queued"|"running"|"done","result":...}
+void handleJob(AsyncWebServerRequest *request) {
+  static const char *stateNames[] = {"free", "queued", "running", "done"};
+  uint16_t id = request->arg("id").toInt();
+  DynamicJsonDocument doc(512);
+  bool found = false;
+  xSemaphoreTake(jobMutex, portMAX_DELAY);
+  for (int i = 0; i < MAX_WEB_JOBS; i++) {
+    if (webJobs[i].id == id && webJobs[i].state != JOB_FREE) {
+      doc["id"] = id;
+      doc["state"] = stateNames[webJobs[i].state];
+      if (webJobs[i].state == JOB_DONE)
+        doc["result"] = webJobs[i].result;
+      found = true;
+      break;
+    }
+  }
+  xSemaphoreGive(jobMutex);
+  if (!found) {
+    request->send(404, "text/plain", "Unknown job");
+    return;
+  }
+  sendJson(request, doc);
+}
+
+void handleGetFilters(AsyncWebServerRequest *request) {
+  DynamicJsonDocument doc(1024);
+  JsonArray array = doc.to<JsonArray>();
+  for (int i = 0; i < getCustomFilterCount(); i++) {
+    const CustomFilter *cf = getCustomFilter(i);
+    JsonObject obj = array.createNestedObject();
+    obj["name"] = cf->name;
+    obj["expr"] = cf->expr;
+  }
+  sendJson(request, doc);
+}
+
+// Validated filter rows waiting for the loop task, which owns the list
+static String pendingNames[MAX_CUSTOM_FILTERS];
+static String pendingExprs[MAX_CUSTOM_FILTERS];
+
+static void applyPendingFilters() {
+  String error;
+  if (setCustomFilters(pendingNames, pendingExprs, MAX_CUSTOM_FILTERS,
+                       error)) {
+    saveCustomFilters();
+    onCustomFiltersChanged();
+  }
+}
+
+// Expects name0..name3 / expr0..expr3. Every expression is compiled before
+// anything is saved, so a typo never replaces a working filter set.
+void handleSaveFilters(AsyncWebServerRequest *request) {
+  String names[MAX_CUSTOM_FILTERS];
+  String exprs[MAX_CUSTOM_FILTERS];
+  for (int i = 0; i < MAX_CUSTOM_FILTERS; i++) {
+    names[i] = request->arg("name" + String(i));
+    exprs[i] = request->arg("expr" + String(i));
+  }
+
+  String error;
+  if (!checkCustomFilters(names, exprs, MAX_CUSTOM_FILTERS, error)) {
+    request->send(400, "text/plain", error);
+    return;
+  }
+
+  for (int i = 0; i < MAX_CUSTOM_FILTERS; i++) {
+    pendingNames[i] = names[i];
+    pendingExprs[i] = exprs[i];
+  }
+  runOnLoop(applyPendingFilters);
+  request->send(200, "text/plain", "Saved filters");
+}
+
+static void hudOn() { setPerfHudEnabled(true); }
+static void hudOff() { setPerfHudEnabled(false); }
+
+// Profiler counters from the last 1 s window, scheduler job stats and
+// web handler timing. ?hud=1 / ?hud=0 toggles the on-screen overlay.
+void handlePerf(AsyncWebServerRequest *request) {
+  if (request->hasArg("hud")) {
+    runOnLoop(request->arg("hud") == "1" ? hudOn : hudOff);
+  }
+  DynamicJsonDocument doc(5120);
+  JsonObject obj = doc.to<JsonObject>();
+  fillPerfJson(obj);
+  fillSchedJson(obj.createNestedArray("jobs"));
+  JsonObject web = obj.createNestedObject("web");
+  web["slow"] = webSlowCount;
+  web["max_ms"] = webMaxMs;
+  web["max_route"] = webSlowestRoute;
+  fillLiveJson(obj.createNestedObject("live"));
+  fillRpcProxyJson(obj.createNestedObject("rpc"));
+  fillOtaJson(obj.createNestedObject("ota"));
+  fillConfigJson(obj.createNestedObject("config"));
+  fillSnapshotCacheJson(obj.createNestedObject("cache"));
+  fillBootJson(obj.createNestedObject("boot"));
+  fillLogJson(obj.createNestedObject("log"));
+  fillWifiLinkJson(obj.createNestedObject("wifi"));
+  sendJson(request, doc);
+}
 
-  String result = testTransmission(t_host, t_port, t_path, t_user, t_pass);
-  server.send(200, "text/plain", result);
+// Power mode, current estimate and time spent per mode
+void handlePower(AsyncWebServerRequest *request) {
+  DynamicJsonDocument doc(768);
+  fillPowerJson(doc.to<JsonObject>());
+  sendJson(request, doc);
 }
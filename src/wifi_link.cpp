@@ -0,0 +1,209 @@
+#include "wifi_link.h"
+#include "config_utils.h"
+#include "logger.h"
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <esp32/rom/crc.h>
+
+#define LINK_FILE "/wifi.bin"
+#define LINK_MAGIC 0x4b4c4f47 // "GOLK"
+
+// Stored with a CRC. Rewritten only when the AP or the lease changes.
+struct __attribute__((packed)) LinkCache {
+  uint32_t magic;
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip; // Last DHCP lease, 0 if the link never used DHCP
+  uint32_t gateway;
+  uint32_t mask;
+  uint32_t dns;
+  uint32_t crc; // Over everything before it
+};
+
+static LinkCache cache;
+static bool cacheValid = false;
+static bool usingCache = false;  // Current attempt targets the cached AP
+static bool staticActive = false; // Current attempt uses the static profile
+static bool linkUp = false;
+static bool everUp = false;
+static bool attemptPending = false; // Between the first begin and the IP
+static unsigned long attemptStart = 0;
+static bool dropped = false;
+static unsigned long lostAt = 0;
+
+static uint32_t coldMs = 0;
+static uint32_t lastResumeMs = 0;
+static uint32_t maxResumeMs = 0;
+static uint32_t totalResumeMs = 0;
+static uint32_t resumes = 0;
+static uint32_t cacheHits = 0;
+static uint32_t cacheMisses = 0; // Cached AP gone, fell back to a scan
+static uint32_t cacheWrites = 0;
+
+static uint32_t cacheCrc(const LinkCache &c) {
+  return crc32_le(0, (const uint8_t *)&c, offsetof(LinkCache, crc));
+}
+
+void loadWifiLink() {
+  File file = LittleFS.open(LINK_FILE, "r");
+  if (!file)
+    return;
+  bool ok = file.read((uint8_t *)&cache, sizeof(cache)) == sizeof(cache) &&
+            cache.magic == LINK_MAGIC && cache.crc == cacheCrc(cache);
+  file.close();
+  if (!ok) {
+    LOG_W("wifi", "cache invalid, ignored");
+    return;
+  }
+  cache.ssid[sizeof(cache.ssid) - 1] = '\0';
+  cacheValid = true;
+  LOG_I("wifi", "cached AP: %s on channel %u", cache.ssid, cache.channel);
+}
+
+// Static profile from the settings, or DHCP if it is off or incomplete
+static bool applyIpProfile() {
+  IPAddress ip, gateway, mask, dns;
+  if (staticIp && ip.fromString(staticAddr) &&
+      gateway.fromString(staticGateway) && mask.fromString(staticMask)) {
+    if (!dns.fromString(staticDns))
+      dns = gateway;
+    WiFi.config(ip, gateway, mask, dns);
+    return true;
+  }
+  if (staticIp)
+    LOG_W("wifi", "static IP profile incomplete, using DHCP");
+  WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+  return false;
+}
+
+void wifiLinkBegin(bool fullScan) {
+  if (!attemptPending) {
+    // After a drop, resume time counts from the drop
+    attemptPending = true;
+    attemptStart = dropped ? lostAt : millis();
+  }
+  if (usingCache)
+    cacheMisses++; // The cached attempt is being given up
+
+  staticActive = applyIpProfile();
+  usingCache = !fullScan && cacheValid && ssid == cache.ssid;
+  if (usingCache)
+    WiFi.begin(ssid.c_str(), password.c_str(), cache.channel, cache.bssid);
+  else
+    WiFi.begin(ssid.c_str(), password.c_str());
+}
+
+bool wifiLinkUsingCache() { return usingCache; }
+
+void startSoftAp() {
+  if (apPassword.length() >= 8)
+    WiFi.softAP(apSSID.c_str(), apPassword.c_str());
+  else
+    WiFi.softAP(apSSID.c_str());
+}
+
+// Remember the AP and lease of the link that just came up
+static void rememberLink() {
+  LinkCache next;
+  memset(&next, 0, sizeof(next));
+  next.magic = LINK_MAGIC;
+  strlcpy(next.ssid, WiFi.SSID().c_str(), sizeof(next.ssid));
+  uint8_t *bssid = WiFi.BSSID();
+  if (bssid)
+    memcpy(next.bssid, bssid, sizeof(next.bssid));
+  next.channel = WiFi.channel();
+  if (!staticActive) {
+    next.ip = WiFi.localIP();
+    next.gateway = WiFi.gatewayIP();
+    next.mask = WiFi.subnetMask();
+    next.dns = WiFi.dnsIP();
+  } else if (cacheValid && strcmp(cache.ssid, next.ssid) == 0) {
+    // Keep the last lease of this network for the settings page
+    next.ip = cache.ip;
+    next.gateway = cache.gateway;
+    next.mask = cache.mask;
+    next.dns = cache.dns;
+  }
+  next.crc = cacheCrc(next);
+  if (cacheValid && memcmp(&next, &cache, sizeof(next)) == 0)
+    return;
+
+  cache = next;
+  cacheValid = true;
+  File file = LittleFS.open(LINK_FILE, "w");
+  if (!file || file.write((const uint8_t *)&cache, sizeof(cache)) !=
+                   sizeof(cache)) {
+    LOG_E("wifi", "cache write failed");
+  } else {
+    cacheWrites++;
+  }
+  if (file)
+    file.close();
+}
+
+void wifiLinkUpdate() {
+  bool up = WiFi.status() == WL_CONNECTED && WiFi.localIP()[0] != 0;
+  if (up == linkUp)
+    return;
+  linkUp = up;
+  if (!up) {
+    dropped = true;
+    lostAt = millis();
+    return;
+  }
+
+  // Only connects started by wifiLinkBegin() are timed (not the Wi-Fi
+  // setup screen's)
+  if (attemptPending) {
+    uint32_t ms = millis() - attemptStart;
+    if (!everUp) {
+      coldMs = ms;
+    } else {
+      lastResumeMs = ms;
+      totalResumeMs += ms;
+      maxResumeMs = max(maxResumeMs, ms);
+      resumes++;
+    }
+    LOG_I("wifi", "up in %lu ms (%s AP, %s)", (unsigned long)ms,
+          usingCache ? "cached" : "scanned",
+          staticActive ? "static IP" : "DHCP");
+  }
+  if (usingCache)
+    cacheHits++;
+  attemptPending = false;
+  usingCache = false;
+  dropped = false;
+  everUp = true;
+  rememberLink();
+}
+
+void fillWifiLeaseJson(JsonObject obj) {
+  if (!cacheValid || cache.ip == 0)
+    return;
+  obj["ip"] = IPAddress(cache.ip).toString();
+  obj["gw"] = IPAddress(cache.gateway).toString();
+  obj["mask"] = IPAddress(cache.mask).toString();
+  obj["dns"] = IPAddress(cache.dns).toString();
+}
+
+void fillWifiLinkJson(JsonObject obj) {
+  obj["cached"] = cacheValid;
+  if (cacheValid) {
+    char bssid[18];
+    snprintf(bssid, sizeof(bssid), "%02x:%02x:%02x:%02x:%02x:%02x",
+             cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3],
+             cache.bssid[4], cache.bssid[5]);
+    obj["bssid"] = bssid;
+    obj["channel"] = cache.channel;
+  }
+  obj["static"] = staticActive;
+  obj["cold_ms"] = coldMs;
+  obj["resume_ms"] = lastResumeMs;
+  obj["resume_avg_ms"] = resumes ? totalResumeMs / resumes : 0;
+  obj["resume_max_ms"] = maxResumeMs;
+  obj["resumes"] = resumes;
+  obj["cache_hits"] = cacheHits;
+  obj["cache_misses"] = cacheMisses;
+  obj["writes"] = cacheWrites;
+}
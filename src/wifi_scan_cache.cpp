@@ -0,0 +1,147 @@
+#include "wifi_scan_cache.h"
+#include "logger.h"
+
+#define SCAN_TIMEOUT_MS 10000
+#define AP_REFRESH_MS 30000
+
+static ScanEntry entries[SCAN_CACHE_MAX];
+static int entryCount = 0;
+static uint32_t revision = 0;
+static bool scanning = false;
+static unsigned long scanStartMs = 0;
+static unsigned long lastScanMs = 0;
+static bool haveScan = false;
+
+// Readers may run on another task (web server)
+static portMUX_TYPE cacheMux = portMUX_INITIALIZER_UNLOCKED;
+
+void scanCacheRequest() {
+  if (scanning)
+    return;
+  // Scanning needs the station interface
+  wifi_mode_t mode = WiFi.getMode();
+  if (mode == WIFI_MODE_AP || mode == WIFI_MODE_NULL) {
+    LOG_D("scan", "switching to AP_STA mode for scanning");
+    WiFi.mode(WIFI_AP_STA);
+  }
+  if (WiFi.scanNetworks(true, true) == WIFI_SCAN_FAILED) { // async, hidden
+    LOG_W("scan", "start failed");
+    return;
+  }
+  scanning = true;
+  scanStartMs = millis();
+}
+
+// Keep the strongest BSSID per SSID. Hidden networks have no SSID to
+// merge on and are kept per BSSID.
+static int findSlot(const ScanEntry *list, int count, const String &ssid,
+                    const uint8_t *bssid) {
+  for (int i = 0; i < count; i++) {
+    if (ssid.length() > 0 ? ssid == list[i].ssid
+                          : memcmp(bssid, list[i].bssid, 6) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static void collectResults(int n) {
+  ScanEntry fresh[SCAN_CACHE_MAX];
+  int count = 0;
+
+  for (int i = 0; i < n; i++) {
+    String ssid = WiFi.SSID(i);
+    uint8_t *bssid = WiFi.BSSID(i);
+    int8_t rssi = WiFi.RSSI(i);
+    int slot = findSlot(fresh, count, ssid, bssid);
+    if (slot >= 0) {
+      if (rssi <= fresh[slot].rssi)
+        continue;
+    } else {
+      if (count < SCAN_CACHE_MAX) {
+        slot = count++;
+      } else {
+        // Full: replace the weakest if this one is stronger
+        slot = count - 1;
+        if (rssi <= fresh[slot].rssi)
+          continue;
+      }
+    }
+    ScanEntry &e = fresh[slot];
+    strlcpy(e.ssid, ssid.c_str(), sizeof(e.ssid));
+    memcpy(e.bssid, bssid, 6);
+    e.rssi = rssi;
+    e.channel = WiFi.channel(i);
+    e.auth = WiFi.encryptionType(i);
+
+    // Insertion step: keep the list sorted, strongest first
+    while (slot > 0 && fresh[slot].rssi > fresh[slot - 1].rssi) {
+      ScanEntry tmp = fresh[slot];
+      fresh[slot] = fresh[slot - 1];
+      fresh[slot - 1] = tmp;
+      slot--;
+    }
+  }
+  WiFi.scanDelete();
+
+  portENTER_CRITICAL(&cacheMux);
+  memcpy(entries, fresh, count * sizeof(ScanEntry));
+  entryCount = count;
+  revision++;
+  portEXIT_CRITICAL(&cacheMux);
+  LOG_D("scan", "%d results, %d networks", n, count);
+}
+
+void scanCacheUpdate() {
+  if (scanning) {
+    int n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING && millis() - scanStartMs < SCAN_TIMEOUT_MS)
+      return;
+    scanning = false;
+    lastScanMs = millis();
+    haveScan = true;
+    if (n >= 0) {
+      collectResults(n);
+    } else {
+      LOG_W("scan", "failed (%d)", n);
+      WiFi.scanDelete();
+    }
+    return;
+  }
+
+  // Setup mode: keep the list fresh for the web page. Never while a
+  // station connection is up or being made, scanning would disturb it.
+  wifi_mode_t mode = WiFi.getMode();
+  bool apMode = (mode == WIFI_AP || mode == WIFI_AP_STA);
+  if (apMode && WiFi.status() != WL_CONNECTED &&
+      (!haveScan || millis() - lastScanMs > AP_REFRESH_MS)) {
+    scanCacheRequest();
+  }
+}
+
+bool isScanCacheBusy() { return scanning; }
+
+uint32_t getScanCacheRevision() { return revision; }
+
+uint32_t getScanCacheAgeMs() {
+  return haveScan ? millis() - lastScanMs : UINT32_MAX;
+}
+
+int copyScanCache(ScanEntry *out, int max) {
+  portENTER_CRITICAL(&cacheMux);
+  int n = min(entryCount, max);
+  memcpy(out, entries, n * sizeof(ScanEntry));
+  portEXIT_CRITICAL(&cacheMux);
+  return n;
+}
+
+void fillScanCacheJson(JsonArray arr) {
+  ScanEntry list[SCAN_CACHE_MAX];
+  int n = copyScanCache(list, SCAN_CACHE_MAX);
+  for (int i = 0; i < n; i++) {
+    JsonObject obj = arr.createNestedObject();
+    obj["ssid"] = list[i].ssid;
+    obj["rssi"] = list[i].rssi;
+    obj["secure"] = (list[i].auth != WIFI_AUTH_OPEN);
+    obj["ch"] = list[i].channel;
+  }
+}
@@ -1,10 +1,14 @@
 #include "wifi_scan_gui.h"
 #include "config_utils.h"
 #include "display_utils.h"
+#include "logger.h"
+#include "torrent_list_gui.h"
+#include "wifi_link.h"
+#include "wifi_scan_cache.h"
 #include <WiFi.h>
 
 // External TFT reference
-extern TFT_eSPI tft;
+extern ProfiledTFT tft;
 
 // State variables
 static WifiScanState wifiScanState = WIFI_SCAN_IDLE;
@@ -16,12 +20,10 @@ static int detailButtonIndex = 0; // 0=Connect
 // Max visible networks on screen
 #define VISIBLE_NETWORKS 6
 
-// Cached network data
-static String scannedSSIDs[MAX_NETWORKS];
-static int scannedRSSI[MAX_NETWORKS];
-static bool scannedSecure[MAX_NETWORKS];
-static String scannedBSSID[MAX_NETWORKS];
-static wifi_auth_mode_t scannedAuth[MAX_NETWORKS];
+// Networks shown, copied from the scan cache (strongest first)
+static ScanEntry networks[MAX_NETWORKS];
+static uint32_t shownRevision = 0;
+#define CACHE_FRESH_MS 60000 // Show cached results without waiting
 
 // Password entry state
 static String passwordBuffer = "";
@@ -52,6 +54,17 @@ static const int KB_ROWS = 5;
 static String connectionStatus = "";
 static unsigned long statusTimeout = 0;
 
+// Background scan / connect
+#define SCAN_TIMEOUT_MS 10000
+#define CONNECT_TIMEOUT_MS 15000
+#define ANIM_FRAME_MS 250
+static unsigned long opStartMs = 0;
+static unsigned long lastAnimMs = 0;
+static int animFrame = 0;
+static String connectSSID = "";
+static String connectPassword = "";
+static WifiScanState connectReturnState = WIFI_SCAN_DETAILS;
+
 void initWifiScanGui() {
   wifiScanState = WIFI_SCAN_IDLE;
   passwordBuffer = "";
@@ -64,66 +77,77 @@ void initWifiScanGui() {
   detailButtonIndex = 0;
 }
 
-// Draw scanning screen (called before actual scan)
+// Spinner for the scan and connect screens: 8 dots on a ring, one lit
+static void drawSpinner(int cx, int cy) {
+  for (int i = 0; i < 8; i++) {
+    static const int8_t dx[] = {0, 7, 10, 7, 0, -7, -10, -7};
+    static const int8_t dy[] = {-10, -7, 0, 7, 10, 7, 0, -7};
+    uint16_t color = (i == animFrame % 8) ? UI_CYAN : UI_TAB_BG;
+    tft.fillCircle(cx + dx[i], cy + dy[i], 2, color);
+  }
+}
+
+// Elapsed time and a progress bar towards the timeout
+static void drawProgress(int y, unsigned long timeoutMs) {
+  unsigned long elapsed = millis() - opStartMs;
+  int w = min(elapsed, timeoutMs) * 200 / timeoutMs;
+  tft.drawRect(59, y, 202, 8, UI_GREY);
+  tft.fillRect(60, y + 1, w, 6, UI_CYAN);
+  tft.setTextSize(1);
+  tft.setTextColor(UI_GREY, UI_BG);
+  tft.setCursor(148, y + 14);
+  tft.printf("%2lus", elapsed / 1000);
+}
+
 void drawScanningScreen() {
   tft.fillRect(0, 24, 320, 216, UI_BG);
 
   tft.setTextSize(2);
   tft.setTextColor(UI_CYAN, UI_BG);
-  tft.setCursor(80, 100);
+  tft.setCursor(94, 100);
   tft.print("Scanning...");
+  drawSpinner(160, 70);
+  drawProgress(130, SCAN_TIMEOUT_MS);
 
+  tft.fillRect(0, 220, 320, 20, UI_TAB_BG);
   tft.setTextSize(1);
-  tft.setTextColor(UI_GREY, UI_BG);
-  tft.setCursor(70, 140);
-  tft.print("Please wait");
+  tft.setTextColor(UI_GREY, UI_TAB_BG);
+  tft.setCursor(5, 225);
+  tft.print("B:Cancel");
 }
 
 bool isInWifiScanMode() { return wifiScanState != WIFI_SCAN_IDLE; }
 
 WifiScanState getWifiScanState() { return wifiScanState; }
 
-void enterWifiScanMode() {
-  initWifiScanGui();
-  wifiScanState = WIFI_SCAN_LIST;
-
-  // Show scanning screen first
-  drawScanningScreen();
+static bool isSecure(int idx) { return networks[idx].auth != WIFI_AUTH_OPEN; }
 
-  // Ensure WiFi mode allows scanning (needs STA component)
-  wifi_mode_t currentMode = WiFi.getMode();
-  Serial.printf("WiFi Scan: Current mode=%d (0=NULL,1=STA,2=AP,3=AP_STA)\n",
-                currentMode);
+// Take the latest cache contents, keeping the cursor in range
+static void loadNetworks() {
+  networkCount = copyScanCache(networks, MAX_NETWORKS);
+  shownRevision = getScanCacheRevision();
+  if (selectedNetwork >= networkCount)
+    selectedNetwork = max(0, networkCount - 1);
+  if (scrollOffset > selectedNetwork)
+    scrollOffset = selectedNetwork;
+}
 
-  if (currentMode == WIFI_MODE_AP || currentMode == WIFI_MODE_NULL) {
-    Serial.println("WiFi Scan: Switching to AP_STA mode for scanning");
-    WiFi.mode(WIFI_AP_STA);
-    delay(500); // Longer delay for mode switch
-  }
+void enterWifiScanMode() {
+  initWifiScanGui();
+  opStartMs = millis();
 
   // Disconnect from any STA connection to allow clean scan
   WiFi.disconnect(false); // false = don't turn off STA mode
-  delay(100);
+  scanCacheRequest();
 
-  // Perform initial scan
-  Serial.println("WiFi Scan: Starting scan...");
-  int n = WiFi.scanNetworks(false, true); // false=async, true=show hidden
-  Serial.printf("WiFi Scan: Result=%d networks\n", n);
-
-  if (n < 0) {
-    Serial.printf("WiFi Scan Error: %d\n", n);
-    networkCount = 0;
+  // Recent results are listed right away and updated when the new scan
+  // lands; otherwise wait for the scan
+  if (getScanCacheAgeMs() < CACHE_FRESH_MS) {
+    loadNetworks();
+    wifiScanState = WIFI_SCAN_LIST;
   } else {
-    networkCount = min(n, MAX_NETWORKS);
-    for (int i = 0; i < networkCount; i++) {
-      scannedSSIDs[i] = WiFi.SSID(i);
-      scannedRSSI[i] = WiFi.RSSI(i);
-      scannedSecure[i] = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
-      scannedBSSID[i] = WiFi.BSSIDstr(i);
-      scannedAuth[i] = WiFi.encryptionType(i);
-    }
+    wifiScanState = WIFI_SCAN_SCANNING;
   }
-  WiFi.scanDelete();
 }
 
 void exitWifiScanMode() {
@@ -195,6 +219,10 @@ void drawNetworkListScreen() {
   tft.setTextColor(TFT_WHITE, UI_BG);
   tft.setCursor(10, 30);
   tft.printf("WiFi Networks (%d found)", networkCount);
+  if (isScanCacheBusy()) {
+    tft.setTextColor(UI_GREY, UI_BG);
+    tft.print("  refreshing...");
+  }
 
   if (networkCount == 0) {
     tft.setTextColor(TFT_YELLOW, UI_BG);
@@ -221,12 +249,12 @@ void drawNetworkListScreen() {
       }
 
       // Lock icon (left side, if secured)
-      if (scannedSecure[idx]) {
+      if (isSecure(idx)) {
         drawLockIcon(5, y + 3, true);
       }
 
       // SSID (after lock icon area)
-      String displaySSID = scannedSSIDs[idx];
+      String displaySSID = networks[idx].ssid;
       if (displaySSID.length() > 24) {
         displaySSID = displaySSID.substring(0, 21) + "...";
       }
@@ -235,10 +263,10 @@ void drawNetworkListScreen() {
 
       // RSSI value (right side)
       tft.setCursor(260, y + 6);
-      tft.printf("%d", scannedRSSI[idx]);
+      tft.printf("%d", networks[idx].rssi);
 
       // RSSI icon (far right, after dBm value)
-      drawRSSIIcon(300, y + 4, scannedRSSI[idx]);
+      drawRSSIIcon(300, y + 4, networks[idx].rssi);
     }
 
     // Scroll indicators
@@ -272,7 +300,7 @@ void drawNetworkDetailsScreen() {
   tft.setTextSize(2);
   tft.setTextColor(UI_CYAN, UI_BG);
   tft.setCursor(10, 32);
-  String displaySSID = scannedSSIDs[idx];
+  String displaySSID = networks[idx].ssid;
   if (displaySSID.length() > 18) {
     displaySSID = displaySSID.substring(0, 15) + "...";
   }
@@ -288,36 +316,38 @@ void drawNetworkDetailsScreen() {
   tft.setCursor(10, y);
   tft.print("BSSID: ");
   tft.setTextColor(UI_GREY, UI_BG);
-  tft.print(scannedBSSID[idx]);
+  const uint8_t *b = networks[idx].bssid;
+  tft.printf("%02X:%02X:%02X:%02X:%02X:%02X", b[0], b[1], b[2], b[3], b[4],
+             b[5]);
   y += lineH;
 
   tft.setTextColor(TFT_WHITE, UI_BG);
   tft.setCursor(10, y);
   tft.print("Signal: ");
   tft.setTextColor(UI_GREY, UI_BG);
-  tft.printf("%d dBm", scannedRSSI[idx]);
+  tft.printf("%d dBm", networks[idx].rssi);
 
   // Signal strength description
   String strength;
-  if (scannedRSSI[idx] >= -60)
+  if (networks[idx].rssi >= -60)
     strength = " (Excellent)";
-  else if (scannedRSSI[idx] >= -70)
+  else if (networks[idx].rssi >= -70)
     strength = " (Good)";
-  else if (scannedRSSI[idx] >= -80)
+  else if (networks[idx].rssi >= -80)
     strength = " (Fair)";
   else
     strength = " (Weak)";
   tft.print(strength);
 
   // RSSI icon next to signal text
-  drawRSSIIcon(250, y - 2, scannedRSSI[idx]);
+  drawRSSIIcon(250, y - 2, networks[idx].rssi);
   y += lineH;
 
   tft.setTextColor(TFT_WHITE, UI_BG);
   tft.setCursor(10, y);
   tft.print("Security: ");
   tft.setTextColor(UI_GREY, UI_BG);
-  tft.print(getSecurityString(scannedAuth[idx]));
+  tft.print(getSecurityString(networks[idx].auth));
   y += lineH + 8;
 
   // Action button - Connect only
@@ -358,7 +388,7 @@ void drawPasswordScreen() {
   tft.setCursor(10, 30);
   tft.print("Connect to: ");
   tft.setTextColor(TFT_WHITE, UI_BG);
-  String displaySSID = scannedSSIDs[idx];
+  String displaySSID = networks[idx].ssid;
   if (displaySSID.length() > 20) {
     displaySSID = displaySSID.substring(0, 17) + "...";
   }
@@ -461,17 +491,33 @@ void drawConnectingScreen() {
 
   tft.setTextSize(2);
   tft.setTextColor(UI_CYAN, UI_BG);
-  tft.setCursor(100, 100);
+  tft.setCursor(82, 100);
   tft.print("Connecting...");
+  drawSpinner(160, 70);
 
   tft.setTextSize(1);
-  tft.setTextColor(UI_GREY, UI_BG);
-  tft.setCursor(80, 140);
-  tft.print("Please wait");
+  tft.setTextColor(TFT_WHITE, UI_BG);
+  String displaySSID = connectSSID;
+  if (displaySSID.length() > 40) {
+    displaySSID = displaySSID.substring(0, 37) + "...";
+  }
+  tft.setCursor(160 - displaySSID.length() * 3, 120);
+  tft.print(displaySSID);
+  drawProgress(140, CONNECT_TIMEOUT_MS);
+
+  tft.fillRect(0, 220, 320, 20, UI_TAB_BG);
+  tft.setTextColor(UI_GREY, UI_TAB_BG);
+  tft.setCursor(5, 225);
+  tft.print("B/SEL:Cancel");
 }
 
 void drawWifiScanScreen() {
+  PROFILE_SCOPE(PROF_WIFI_SCAN);
+  invalidateTorrentList();
   switch (wifiScanState) {
+  case WIFI_SCAN_SCANNING:
+    drawScanningScreen();
+    break;
   case WIFI_SCAN_LIST:
     drawNetworkListScreen();
     break;
@@ -489,52 +535,108 @@ void drawWifiScanScreen() {
   }
 }
 
-// Try to connect to the selected network
-bool tryConnect(const String &ssidToConnect, const String &pwd) {
-  connectionStatus = "Connecting...";
-  statusTimeout = millis() + 30000;
+// Back to the configuration AP after a failed or cancelled connect
+static void restoreApMode() {
+  WiFi.disconnect(false);
+  WiFi.mode(WIFI_AP);
+  startSoftAp();
+}
 
+// Start connecting to the selected network. Progress is polled by
+// updateWifiScanGui().
+void tryConnect(const String &ssidToConnect, const String &pwd) {
+  connectSSID = ssidToConnect;
+  connectPassword = pwd;
+  connectReturnState =
+      pwd.length() > 0 ? WIFI_SCAN_PASSWORD : WIFI_SCAN_DETAILS;
+  connectionStatus = "";
+  opStartMs = millis();
   wifiScanState = WIFI_SCAN_CONNECTING;
-  drawWifiScanScreen();
 
   // Stop AP and try station mode
   WiFi.mode(WIFI_STA);
+  // DHCP: a static profile may not fit the network picked here
+  WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
   WiFi.begin(ssidToConnect.c_str(), pwd.c_str());
 
-  Serial.printf("Connecting to %s...\n", ssidToConnect.c_str());
-
-  // Wait for connection (max 15 seconds)
-  unsigned long start = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - start < 15000) {
-    delay(500);
-    Serial.print(".");
-  }
-  Serial.println();
+  LOG_I("wifi", "setup: connecting to %s", ssidToConnect.c_str());
+}
 
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.printf("Connected! IP: %s\n", WiFi.localIP().toString().c_str());
+static void failConnect(const char *message) {
+  restoreApMode();
+  connectionStatus = message;
+  statusTimeout = millis() + 5000;
+  wifiScanState = connectReturnState;
+  drawWifiScanScreen();
+}
 
-    // Save credentials
-    ssid = ssidToConnect;
-    password = pwd;
-    saveConfig();
+bool isWifiScanBusy() {
+  return wifiScanState == WIFI_SCAN_SCANNING ||
+         wifiScanState == WIFI_SCAN_CONNECTING ||
+         (wifiScanState == WIFI_SCAN_LIST && isScanCacheBusy());
+}
 
-    connectionStatus = "";
-    exitWifiScanMode();
-    return true;
-  } else {
-    Serial.println("Connection failed!");
+bool updateWifiScanGui() {
+  unsigned long elapsed = millis() - opStartMs;
 
-    // Go back to AP mode
-    WiFi.mode(WIFI_AP);
-    WiFi.softAP(apSSID.c_str(),
-                apPassword.length() > 0 ? apPassword.c_str() : NULL);
+  scanCacheUpdate();
 
-    connectionStatus = "Connection failed! Check password.";
-    statusTimeout = millis() + 5000;
-    wifiScanState = WIFI_SCAN_PASSWORD;
+  if (wifiScanState == WIFI_SCAN_SCANNING) {
+    if (!isScanCacheBusy()) {
+      loadNetworks();
+      wifiScanState = WIFI_SCAN_LIST;
+      drawWifiScanScreen();
+      return false;
+    }
+  } else if (wifiScanState == WIFI_SCAN_LIST) {
+    // Background refresh finished: show the new list
+    if (getScanCacheRevision() != shownRevision) {
+      loadNetworks();
+      drawWifiScanScreen();
+    }
     return false;
+  } else if (wifiScanState == WIFI_SCAN_CONNECTING) {
+    wl_status_t st = WiFi.status();
+    if (st == WL_CONNECTED) {
+      LOG_I("wifi", "setup: connected, IP %s",
+            WiFi.localIP().toString().c_str());
+
+      // Save credentials
+      lockConfig();
+      ssid = connectSSID;
+      password = connectPassword;
+      unlockConfig();
+      saveConfig();
+
+      connectionStatus = "";
+      exitWifiScanMode();
+      return true;
+    }
+    if (st == WL_NO_SSID_AVAIL && elapsed > 5000) {
+      LOG_W("wifi", "setup: network not found");
+      failConnect("Network not found.");
+      return false;
+    }
+    if (st == WL_CONNECT_FAILED || elapsed >= CONNECT_TIMEOUT_MS) {
+      LOG_W("wifi", "setup: connection failed");
+      failConnect("Connection failed! Check password.");
+      return false;
+    }
+  } else {
+    return false;
+  }
+
+  // Animate spinner and progress without clearing the screen
+  if (millis() - lastAnimMs >= ANIM_FRAME_MS) {
+    lastAnimMs = millis();
+    animFrame++;
+    drawSpinner(160, 70);
+    if (wifiScanState == WIFI_SCAN_SCANNING)
+      drawProgress(130, SCAN_TIMEOUT_MS);
+    else
+      drawProgress(140, CONNECT_TIMEOUT_MS);
   }
+  return false;
 }
 
 bool handleWifiScanInput(bool up, bool down, bool left, bool right, bool a,
@@ -572,9 +674,9 @@ bool handleWifiScanInput(bool up, bool down, bool left, bool right, bool a,
   case WIFI_SCAN_DETAILS: {
     if (a) {
       // Connect
-      if (!scannedSecure[selectedNetwork]) {
+      if (!isSecure(selectedNetwork)) {
         // Open network - connect directly
-        tryConnect(scannedSSIDs[selectedNetwork], "");
+        tryConnect(networks[selectedNetwork].ssid, "");
       } else {
         // Password required
         passwordBuffer = "";
@@ -644,7 +746,7 @@ bool handleWifiScanInput(bool up, bool down, bool left, bool right, bool a,
             connectionStatus = "Password too long (max 32 chars)";
             statusTimeout = millis() + 3000;
           } else {
-            tryConnect(scannedSSIDs[selectedNetwork], passwordBuffer);
+            tryConnect(networks[selectedNetwork].ssid, passwordBuffer);
           }
         }
       }
@@ -667,7 +769,7 @@ bool handleWifiScanInput(bool up, bool down, bool left, bool right, bool a,
         statusTimeout = millis() + 3000;
         update = true;
       } else {
-        tryConnect(scannedSSIDs[selectedNetwork], passwordBuffer);
+        tryConnect(networks[selectedNetwork].ssid, passwordBuffer);
         update = true;
       }
     } else if (select) {
@@ -677,8 +779,24 @@ bool handleWifiScanInput(bool up, bool down, bool left, bool right, bool a,
     }
     break;
 
+  case WIFI_SCAN_SCANNING:
+    if (b) {
+      // Cancel. The driver finishes the scan on its own; the next scan
+      // starts fresh.
+      exitWifiScanMode();
+      update = true;
+    }
+    break;
+
   case WIFI_SCAN_CONNECTING:
-    // No input during connection
+    if (b || select) {
+      LOG_I("wifi", "setup: connection cancelled");
+      restoreApMode();
+      connectionStatus = "Cancelled.";
+      statusTimeout = millis() + 3000;
+      wifiScanState = connectReturnState;
+      update = true;
+    }
     break;
 
   default: